@@ -21,6 +21,8 @@
 #include "config.h"
 
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 
 #include <ctype.h>
@@ -30,6 +32,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -37,6 +40,7 @@
 #include <unistd.h>
 
 #include "mandoc_aux.h"
+#include "mandoc_ohash.h"
 #include "mandoc.h"
 #include "roff.h"
 #include "mdoc.h"
@@ -70,7 +74,18 @@ enum	focus {
 	FOCUS_QUERY
 };
 
+#ifdef CACHE_DIR
+static	char		*cache_file(const char *);
+static	int		 cache_get(const char *, struct manpage **,
+				size_t *);
+static	void		 cache_put(const char *,
+				const struct manpage *, size_t);
+static	char		*cache_str(char **, const char *);
+#endif
+static	void		 catman_line(const char *, size_t);
+static	void		 catman_style(int *, int);
 static	void		 html_print(const char *);
+static	void		 html_printn(const char *, size_t);
 static	void		 html_putchar(char);
 static	int		 http_decode(char *);
 static	void		 http_encode(const char *);
@@ -167,6 +182,32 @@ html_putchar(char c)
 	}
 }
 
+/*
+ * Print len bytes, escaping HTML along the way.
+ * Spans without special characters are written in bulk.
+ */
+static void
+html_printn(const char *p, size_t len)
+{
+	size_t		 i, start;
+
+	for (i = start = 0; i < len; i++) {
+		switch (p[i]) {
+		case '"':
+		case '&':
+		case '>':
+		case '<':
+			fwrite(p + start, 1, i - start, stdout);
+			html_putchar(p[i]);
+			start = i + 1;
+			break;
+		default:
+			break;
+		}
+	}
+	fwrite(p + start, 1, len - start, stdout);
+}
+
 /*
  * Call through to html_putchar().
  * Accepts NULL strings.
@@ -757,143 +798,160 @@ pg_searchres(const struct req *req, struct manpage *r, size_t sz)
 	resp_end_html();
 }
 
+/*
+ * Switch the font of preformatted output from *style to nstyle,
+ * where 'b' means bold, 'i' means italic, and 0 means roman.
+ */
 static void
-resp_catman(const struct req *req, const char *file)
+catman_style(int *style, int nstyle)
 {
-	FILE		*f;
-	char		*p;
-	size_t		 sz;
-	ssize_t		 len;
-	int		 i;
-	int		 italic, bold;
-
-	if ((f = fopen(file, "r")) == NULL) {
-		puts("<p role=\"doc-notice\">\n"
-		     "  You specified an invalid manual file.\n"
-		     "</p>");
+	if (*style == nstyle)
 		return;
-	}
+	if (*style == 'b')
+		fputs("</b>", stdout);
+	else if (*style == 'i')
+		fputs("</i>", stdout);
+	if (nstyle == 'b')
+		fputs("<b>", stdout);
+	else if (nstyle == 'i')
+		fputs("<i>", stdout);
+	*style = nstyle;
+}
 
-	puts("<div class=\"catman\">\n"
-	     "<pre>");
+/*
+ * Convert one line of a preformatted manual page to HTML.
+ * Runs of plain characters are escaped and written in bulk;
+ * backspace sequences select bold and italic fonts,
+ * and font tags are only written when the font changes.
+ */
+static void
+catman_line(const char *p, size_t len)
+{
+	size_t		 i, j;
+	int		 style;
 
-	p = NULL;
-	sz = 0;
+	style = 0;
+	for (i = 0; i + 1 < len; i++) {
+		/*
+		 * This means that the catpage is out of state.
+		 * Ignore it and keep going (although the
+		 * catpage is bogus).
+		 */
 
-	while ((len = getline(&p, &sz, f)) != -1) {
-		bold = italic = 0;
-		for (i = 0; i < len - 1; i++) {
-			/*
-			 * This means that the catpage is out of state.
-			 * Ignore it and keep going (although the
-			 * catpage is bogus).
-			 */
+		if (p[i] == '\b' || p[i] == '\n')
+			continue;
 
-			if ('\b' == p[i] || '\n' == p[i])
-				continue;
+		/* Print a run of regular characters. */
 
-			/*
-			 * Print a regular character.
-			 * Close out any bold/italic scopes.
-			 * If we're in back-space mode, make sure we'll
-			 * have something to enter when we backspace.
-			 */
-
-			if ('\b' != p[i + 1]) {
-				if (italic)
-					printf("</i>");
-				if (bold)
-					printf("</b>");
-				italic = bold = 0;
-				html_putchar(p[i]);
-				continue;
-			} else if (i + 2 >= len)
-				continue;
+		if (p[i + 1] != '\b') {
+			catman_style(&style, 0);
+			for (j = i + 1; j + 1 < len; j++)
+				if (p[j] == '\b' || p[j] == '\n' ||
+				    p[j + 1] == '\b')
+					break;
+			html_printn(p + i, j - i);
+			i = j - 1;
+			continue;
+		}
 
-			/* Italic mode. */
-
-			if ('_' == p[i]) {
-				if (bold)
-					printf("</b>");
-				if ( ! italic)
-					printf("<i>");
-				bold = 0;
-				italic = 1;
-				i += 2;
-				html_putchar(p[i]);
-				continue;
-			}
+		/*
+		 * If we're in back-space mode, make sure we'll
+		 * have something to enter when we backspace.
+		 */
 
-			/*
-			 * Handle funny behaviour troff-isms.
-			 * These grok'd from the original man2html.c.
-			 */
-
-			if (('+' == p[i] && 'o' == p[i + 2]) ||
-					('o' == p[i] && '+' == p[i + 2]) ||
-					('|' == p[i] && '=' == p[i + 2]) ||
-					('=' == p[i] && '|' == p[i + 2]) ||
-					('*' == p[i] && '=' == p[i + 2]) ||
-					('=' == p[i] && '*' == p[i + 2]) ||
-					('*' == p[i] && '|' == p[i + 2]) ||
-					('|' == p[i] && '*' == p[i + 2]))  {
-				if (italic)
-					printf("</i>");
-				if (bold)
-					printf("</b>");
-				italic = bold = 0;
-				putchar('*');
-				i += 2;
-				continue;
-			} else if (('|' == p[i] && '-' == p[i + 2]) ||
-					('-' == p[i] && '|' == p[i + 1]) ||
-					('+' == p[i] && '-' == p[i + 1]) ||
-					('-' == p[i] && '+' == p[i + 1]) ||
-					('+' == p[i] && '|' == p[i + 1]) ||
-					('|' == p[i] && '+' == p[i + 1]))  {
-				if (italic)
-					printf("</i>");
-				if (bold)
-					printf("</b>");
-				italic = bold = 0;
-				putchar('+');
-				i += 2;
-				continue;
-			}
+		if (i + 2 >= len)
+			continue;
 
-			/* Bold mode. */
+		/* Italic mode. */
 
-			if (italic)
-				printf("</i>");
-			if ( ! bold)
-				printf("<b>");
-			bold = 1;
-			italic = 0;
+		if (p[i] == '_') {
+			catman_style(&style, 'i');
 			i += 2;
 			html_putchar(p[i]);
+			continue;
 		}
 
 		/*
-		 * Clean up the last character.
-		 * We can get to a newline; don't print that.
+		 * Handle funny behaviour troff-isms.
+		 * These grok'd from the original man2html.c.
 		 */
 
-		if (italic)
-			printf("</i>");
-		if (bold)
-			printf("</b>");
+		if ((p[i] == '+' && p[i + 2] == 'o') ||
+		    (p[i] == 'o' && p[i + 2] == '+') ||
+		    (p[i] == '|' && p[i + 2] == '=') ||
+		    (p[i] == '=' && p[i + 2] == '|') ||
+		    (p[i] == '*' && p[i + 2] == '=') ||
+		    (p[i] == '=' && p[i + 2] == '*') ||
+		    (p[i] == '*' && p[i + 2] == '|') ||
+		    (p[i] == '|' && p[i + 2] == '*')) {
+			catman_style(&style, 0);
+			putchar('*');
+			i += 2;
+			continue;
+		} else if (p[i] == '|' && p[i + 2] == '-') {
+			catman_style(&style, 0);
+			putchar('+');
+			i += 2;
+			continue;
+		}
+
+		/* Bold mode. */
 
-		if (i == len - 1 && p[i] != '\n')
-			html_putchar(p[i]);
+		catman_style(&style, 'b');
+		i += 2;
+		html_putchar(p[i]);
+	}
 
-		putchar('\n');
+	/*
+	 * Clean up the last character.
+	 * We can get to a newline; don't print that.
+	 */
+
+	catman_style(&style, 0);
+	if (i + 1 == len && p[i] != '\n')
+		html_putchar(p[i]);
+	putchar('\n');
+}
+
+static void
+resp_catman(const struct req *req, const char *file)
+{
+	struct stat	 sb;
+	const char	*cp, *end, *eol;
+	void		*map;
+	int		 fd;
+
+	map = NULL;
+	if ((fd = open(file, O_RDONLY)) == -1 ||
+	    fstat(fd, &sb) == -1 || ! S_ISREG(sb.st_mode) ||
+	    (sb.st_size > 0 && (map = mmap(NULL, sb.st_size,
+	     PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)) {
+		if (fd != -1)
+			close(fd);
+		puts("<p role=\"doc-notice\">\n"
+		     "  You specified an invalid manual file.\n"
+		     "</p>");
+		return;
 	}
-	free(p);
+	close(fd);
+
+	puts("<div class=\"catman\">\n"
+	     "<pre>");
+
+	cp = map;
+	end = cp + sb.st_size;
+	for (; cp < end; cp = eol) {
+		if ((eol = memchr(cp, '\n', end - cp)) == NULL)
+			eol = end;
+		else
+			eol++;
+		catman_line(cp, eol - cp);
+	}
+	if (map != NULL)
+		munmap(map, sb.st_size);
 
 	puts("</pre>\n"
 	     "</div>");
-
-	fclose(f);
 }
 
 static void
@@ -936,6 +994,7 @@ resp_format(const struct req *req, const char *file)
 
 	html_free(vp);
 	mparse_free(mp);
+	roffhash_freeall();
 	mchars_free();
 	free(conf.man);
 	free(conf.style);
@@ -1003,6 +1062,182 @@ pg_show(struct req *req, const char *fullpath)
 	resp_end_html();
 }
 
+#ifdef CACHE_DIR
+/*
+ * Search results are cached in files below CACHE_DIR.  Each file
+ * starts with the search key.  Its first line is the identity of
+ * the mandoc.db file, such that a database replaced by makewhatis(8)
+ * invalidates the entries, and the rest is the normalized query.
+ * All the other fields are stored as NUL-terminated strings.
+ */
+
+/*
+ * Return the name of the cache file for the key.  Only the query
+ * is hashed, such that stale entries get overwritten.
+ */
+static char *
+cache_file(const char *key)
+{
+	char		*file;
+	const char	*end;
+
+	end = NULL;
+	key = strchr(key, '\n') + 1;
+	mandoc_asprintf(&file, "%s/%08x", CACHE_DIR,
+	    ohash_interval(key, &end));
+	return file;
+}
+
+/*
+ * Return the string starting at *cp and advance *cp past it,
+ * or return NULL if the string is not terminated before end.
+ */
+static char *
+cache_str(char **cp, const char *end)
+{
+	char	*str, *ep;
+
+	if ((ep = memchr(*cp, '\0', end - *cp)) == NULL)
+		return NULL;
+	str = *cp;
+	*cp = ep + 1;
+	return str;
+}
+
+/*
+ * Look up the key in the cache.
+ * If found, return 1 and the results in *res and *ressz.
+ */
+static int
+cache_get(const char *key, struct manpage **res, size_t *ressz)
+{
+	struct stat	 sb;
+	struct manpage	*page;
+	char		*buf, *cp, *end, *file, *names, *output;
+	char		*str[4];
+	const char	*errstr;
+	size_t		 i, keysz, sz;
+	ssize_t		 rsz;
+	int		 fd, j;
+
+	*res = NULL;
+	*ressz = 0;
+	file = cache_file(key);
+	fd = open(file, O_RDONLY);
+	free(file);
+	if (fd == -1)
+		return 0;
+	keysz = strlen(key) + 1;
+	if (fstat(fd, &sb) == -1 || (size_t)sb.st_size < keysz ||
+	    sb.st_size > 16 * 1024 * 1024) {
+		close(fd);
+		return 0;
+	}
+	buf = mandoc_malloc(sb.st_size);
+	rsz = read(fd, buf, sb.st_size);
+	close(fd);
+	if (rsz != sb.st_size || memcmp(buf, key, keysz) != 0) {
+		free(buf);
+		return 0;
+	}
+	cp = buf + keysz;
+	end = buf + sb.st_size;
+
+	if ((str[0] = cache_str(&cp, end)) == NULL)
+		goto fail;
+	sz = strtonum(str[0], 0, 100000, &errstr);
+	if (errstr != NULL)
+		goto fail;
+	*res = mandoc_reallocarray(NULL, sz, sizeof(**res));
+	for (i = 0; i < sz; i++) {
+		if ((file = cache_str(&cp, end)) == NULL ||
+		    (names = cache_str(&cp, end)) == NULL ||
+		    (output = cache_str(&cp, end)) == NULL)
+			goto fail;
+		for (j = 0; j < 4; j++)
+			if ((str[j] = cache_str(&cp, end)) == NULL)
+				goto fail;
+		page = *res + i;
+		page->file = mandoc_strdup(file);
+		page->names = mandoc_strdup(names);
+		page->output = *output == '\0' ? NULL :
+		    mandoc_strdup(output + 1);
+		page->bits = strtoull(str[0], NULL, 10);
+		page->ipath = strtoull(str[1], NULL, 10);
+		*ressz = i + 1;
+		page->sec = strtonum(str[2], 0, 10, &errstr);
+		if (errstr != NULL)
+			goto fail;
+		page->form = strtonum(str[3], FORM_SRC, FORM_NONE, &errstr);
+		if (errstr != NULL)
+			goto fail;
+	}
+	free(buf);
+	return 1;
+
+fail:
+	free(buf);
+	mansearch_free(*res, *ressz);
+	*res = NULL;
+	*ressz = 0;
+	return 0;
+}
+
+/*
+ * Store the search results for the key in the cache.
+ * Failure is not fatal: the next request will search again.
+ */
+static void
+cache_put(const char *key, const struct manpage *res, size_t ressz)
+{
+	FILE		*fp;
+	char		*file, *tfile;
+	size_t		 i;
+	int		 fd;
+
+	mandoc_asprintf(&tfile, "%s/tmp.XXXXXXXXXX", CACHE_DIR);
+	if ((fd = mkstemp(tfile)) == -1) {
+		warn("mkstemp %s", tfile);
+		free(tfile);
+		return;
+	}
+	if ((fp = fdopen(fd, "w")) == NULL) {
+		warn("fdopen %s", tfile);
+		close(fd);
+		goto fail;
+	}
+	fprintf(fp, "%s%c%zu%c", key, '\0', ressz, '\0');
+	for (i = 0; i < ressz; i++) {
+		fprintf(fp, "%s%c%s%c", res[i].file, '\0',
+		    res[i].names, '\0');
+		if (res[i].output == NULL)
+			putc('\0', fp);
+		else
+			fprintf(fp, "+%s%c", res[i].output, '\0');
+		fprintf(fp, "%llu%c%zu%c%d%c%d%c",
+		    (unsigned long long)res[i].bits, '\0', res[i].ipath,
+		    '\0', res[i].sec, '\0', (int)res[i].form, '\0');
+	}
+	if (ferror(fp) || fclose(fp) == EOF) {
+		warnx("write %s", tfile);
+		goto fail;
+	}
+	file = cache_file(key);
+	if (rename(tfile, file) == -1) {
+		warn("rename %s", file);
+		free(file);
+		goto fail;
+	}
+	free(file);
+	free(tfile);
+	return;
+
+fail:
+	unlink(tfile);
+	free(tfile);
+}
+#endif
+
 static void
 pg_search(const struct req *req)
 {
@@ -1012,7 +1247,12 @@ pg_search(const struct req *req)
 	char			**argv;
 	char			 *query, *rp, *wp;
 	size_t			  ressz;
-	int			  argc;
+	int			  argc, irc;
+#ifdef CACHE_DIR
+	struct stat		  sb;
+	char			 *key;
+	int			  i;
+#endif
 
 	/*
 	 * Begin by chdir()ing into the root of the manpath.
@@ -1067,18 +1307,55 @@ pg_search(const struct req *req)
 		}
 	}
 
+#ifdef CACHE_DIR
+	/*
+	 * The cache key consists of the identity of the database
+	 * and of the normalized query.
+	 */
+
+	key = NULL;
+	if (stat(MANDOC_DB, &sb) != -1) {
+		mandoc_asprintf(&key, "%lld %lld %lld %lld\n"
+		    "man.cgi cache 1\n%s\n%s\n%s\n%d\n",
+		    (long long)sb.st_dev, (long long)sb.st_ino,
+		    (long long)sb.st_mtime, (long long)sb.st_size,
+		    req->q.manpath, req->q.arch == NULL ? "" : req->q.arch,
+		    req->q.sec == NULL ? "" : req->q.sec, req->q.equal);
+		for (i = 0; i < argc; i++) {
+			mandoc_asprintf(&rp, "%s %s", key, argv[i]);
+			free(key);
+			key = rp;
+		}
+	}
+#endif
+
 	res = NULL;
 	ressz = 0;
 	if (req->isquery && req->q.equal && argc == 1)
 		pg_redirect(req, argv[0]);
-	else if (mansearch(&search, &paths, argc, argv, &res, &ressz) == 0)
-		pg_noresult(req, 400, "Bad Request",
-		    "You entered an invalid query.");
-	else if (ressz == 0)
-		pg_noresult(req, 404, "Not Found", "No results found.");
-	else
-		pg_searchres(req, res, ressz);
+	else {
+#ifdef CACHE_DIR
+		if (key != NULL && cache_get(key, &res, &ressz))
+			irc = 1;
+		else if ((irc = mansearch(&search, &paths,
+		    argc, argv, &res, &ressz)) != 0 && key != NULL)
+			cache_put(key, res, ressz);
+#else
+		irc = mansearch(&search, &paths, argc, argv, &res, &ressz);
+#endif
+		if (irc == 0)
+			pg_noresult(req, 400, "Bad Request",
+			    "You entered an invalid query.");
+		else if (ressz == 0)
+			pg_noresult(req, 404, "Not Found",
+			    "No results found.");
+		else
+			pg_searchres(req, res, ressz);
+	}
 
+#ifdef CACHE_DIR
+	free(key);
+#endif
 	free(query);
 	mansearch_free(res, ressz);
 	free(paths.paths[0]);
@@ -1103,7 +1380,11 @@ main(void)
 	 * pledge() calls in multiple low-level resp_*() functions.
 	 */
 
+#ifdef CACHE_DIR
+	if (pledge("stdio rpath wpath cpath", NULL) == -1) {
+#else
 	if (pledge("stdio rpath", NULL) == -1) {
+#endif
 		warn("pledge");
 		pg_error_internal();
 		return EXIT_FAILURE;
@@ -19,6 +19,8 @@
  */
 #include "config.h"
 
+#include <sys/types.h>
+
 #include <assert.h>
 #if HAVE_ENDIAN
 #include <endian.h>
@@ -33,95 +35,160 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdint.h>
-#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
+#include "mandoc_aux.h"
 #include "dba_write.h"
 
-static FILE	*ofp;
+/*
+ * The complete database is assembled in memory and written to disk
+ * with a single write loop in dba_close().  Pointers that can only
+ * be determined later are patched in the buffer using dba_seek().
+ */
+
+static int	 ofd = -1;	/* Output file descriptor. */
+static char	*obuf;		/* Image of the output file. */
+static size_t	 osz;		/* Allocated size of obuf. */
+static size_t	 olen;		/* Length of the output file. */
+static size_t	 opos;		/* Current write position. */
+
+static char	*dba_reserve(size_t);
 
 
 int
 dba_open(const char *fname)
 {
-	ofp = fopen(fname, "w");
-	return ofp == NULL ? -1 : 0;
+	if ((ofd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0666)) == -1)
+		return -1;
+	osz = 1024 * 1024;
+	obuf = mandoc_malloc(osz);
+	olen = opos = 0;
+	return 0;
 }
 
 int
 dba_close(void)
 {
-	return fclose(ofp) == EOF ? -1 : 0;
+	const char	*cp;
+	size_t		 len;
+	ssize_t		 wsz;
+	int		 irc, save_errno;
+
+	irc = 0;
+	cp = obuf;
+	len = olen;
+	while (len > 0) {
+		if ((wsz = write(ofd, cp, len)) == -1) {
+			if (errno == EINTR)
+				continue;
+			irc = -1;
+			break;
+		}
+		if (wsz == 0) {
+			/* No progress: do not loop forever. */
+			errno = EIO;
+			irc = -1;
+			break;
+		}
+		cp += wsz;
+		len -= wsz;
+	}
+	save_errno = errno;
+	free(obuf);
+	obuf = NULL;
+	osz = olen = opos = 0;
+	if (close(ofd) == -1 && irc == 0) {
+		save_errno = errno;
+		irc = -1;
+	}
+	ofd = -1;
+	errno = save_errno;
+	return irc;
 }
 
-int32_t
-dba_tell(void)
+/*
+ * Make room for len bytes at the current position,
+ * advance the position, and return a pointer to the space.
+ */
+static char *
+dba_reserve(size_t len)
 {
-	long		 pos;
+	char	*cp;
 
-	if ((pos = ftell(ofp)) == -1)
-		err(1, "ftell");
-	if (pos >= INT32_MAX) {
+	if (opos + len >= INT32_MAX) {
 		errno = EOVERFLOW;
-		err(1, "ftell = %ld", pos);
+		err(1, "dba_reserve(%zu)", opos + len);
 	}
-	return pos;
+	if (opos + len > osz) {
+		while (opos + len > osz)
+			osz *= 2;
+		obuf = mandoc_realloc(obuf, osz);
+	}
+	cp = obuf + opos;
+	opos += len;
+	if (olen < opos)
+		olen = opos;
+	return cp;
+}
+
+int32_t
+dba_tell(void)
+{
+	return opos;
 }
 
 void
 dba_seek(int32_t pos)
 {
-	if (fseek(ofp, pos, SEEK_SET) == -1)
-		err(1, "fseek(%d)", pos);
+	assert(pos >= 0);
+	assert((size_t)pos <= olen);
+	opos = pos;
 }
 
 int32_t
 dba_align(void)
 {
-	int32_t		 pos;
+	size_t	 pad;
 
-	pos = dba_tell();
-	while (pos & 3) {
-		dba_char_write('\0');
-		pos++;
-	}
-	return pos;
+	if ((pad = opos & 3) != 0)
+		memset(dba_reserve(4 - pad), '\0', 4 - pad);
+	return opos;
 }
 
 int32_t
 dba_skip(int32_t nmemb, int32_t sz)
 {
-	const int32_t	 out[5] = {0, 0, 0, 0, 0};
-	int32_t		 i, pos;
+	int32_t		 pos;
 
 	assert(sz >= 0);
 	assert(nmemb > 0);
 	assert(nmemb <= 5);
-	pos = dba_tell();
-	for (i = 0; i < sz; i++)
-		if (nmemb - fwrite(&out, sizeof(out[0]), nmemb, ofp))
-			err(1, "fwrite");
+	pos = opos;
+	memset(dba_reserve((size_t)nmemb * sz * sizeof(int32_t)), '\0',
+	    (size_t)nmemb * sz * sizeof(int32_t));
 	return pos;
 }
 
 void
 dba_char_write(int c)
 {
-	if (putc(c, ofp) == EOF)
-		err(1, "fputc");
+	*dba_reserve(1) = c;
 }
 
 void
 dba_str_write(const char *str)
 {
-	if (fputs(str, ofp) == EOF)
-		err(1, "fputs");
-	dba_char_write('\0');
+	size_t	 len;
+
+	len = strlen(str) + 1;
+	memcpy(dba_reserve(len), str, len);
 }
 
 void
 dba_int_write(int32_t i)
 {
 	i = htobe32(i);
-	if (fwrite(&i, sizeof(i), 1, ofp) != 1)
-		err(1, "fwrite");
+	memcpy(dba_reserve(sizeof(i)), &i, sizeof(i));
 }
@@ -130,6 +130,17 @@ dbm_close(void)
 	dbm_unmap();
 }
 
+/*
+ * With a non-zero argument, keep databases mapped after dbm_close()
+ * and reuse them in later dbm_open() calls while the files remain
+ * unchanged.  With zero, unmap all of them.
+ */
+void
+dbm_keep(int keep)
+{
+	dbm_map_keep(keep);
+}
+
 
 /*** functions for handling pages *************************************/
 
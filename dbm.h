@@ -52,6 +52,7 @@ struct dbm_macro {
 
 int		 dbm_open(const char *);
 void		 dbm_close(void);
+void		 dbm_keep(int);
 
 int32_t		 dbm_page_count(void);
 struct dbm_page	*dbm_page_get(int32_t);
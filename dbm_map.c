@@ -42,14 +42,28 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "mandoc_aux.h"
 #include "mansearch.h"
 #include "dbm_map.h"
 #include "dbm.h"
 
+/* A database remaining mapped for reuse, see dbm_map_keep(). */
+struct	dbm_kept {
+	struct dbm_kept	*next;
+	struct stat	 st;
+	char		*base;
+	int		 fd;
+	int32_t		 max_offset;
+};
+
 static struct stat	 st;
 static char		*dbm_base;
 static int		 ifd;
 static int32_t		 max_offset;
+static struct dbm_kept	*kept;	/* List of mapped databases. */
+static int		 keep;	/* Do not unmap in dbm_unmap(). */
+
+static	void		 dbm_map_prune(int);
 
 /*
  * Open a disk-based database for read-only access.
@@ -59,9 +73,34 @@ static int32_t		 max_offset;
 int
 dbm_map(const char *fname)
 {
+	struct stat	 sb;
+	struct dbm_kept	*kp;
 	int		 save_errno;
 	const int32_t	*magic;
 
+	/*
+	 * When keeping databases mapped, reuse the existing mapping
+	 * unless the file was replaced or modified in the meantime.
+	 */
+
+	if (keep) {
+		if (stat(fname, &sb) == -1)
+			return -1;
+		for (kp = kept; kp != NULL; kp = kp->next) {
+			if (kp->st.st_dev != sb.st_dev ||
+			    kp->st.st_ino != sb.st_ino ||
+			    kp->st.st_size != sb.st_size ||
+			    kp->st.st_mtime != sb.st_mtime)
+				continue;
+			st = kp->st;
+			dbm_base = kp->base;
+			ifd = kp->fd;
+			max_offset = kp->max_offset;
+			return 0;
+		}
+		dbm_map_prune(0);
+	}
+
 	if ((ifd = open(fname, O_RDONLY)) == -1)
 		return -1;
 	if (fstat(ifd, &st) == -1)
@@ -115,6 +154,15 @@ dbm_map(const char *fname)
 		errno = EFTYPE;
 		goto fail;
 	}
+	if (keep) {
+		kp = mandoc_malloc(sizeof(*kp));
+		kp->st = st;
+		kp->base = dbm_base;
+		kp->fd = ifd;
+		kp->max_offset = max_offset;
+		kp->next = kept;
+		kept = kp;
+	}
 	return 0;
 
 fail:
@@ -127,13 +175,54 @@ fail:
 void
 dbm_unmap(void)
 {
-	if (munmap(dbm_base, st.st_size) == -1)
-		warn("dbm_unmap: munmap");
-	if (close(ifd) == -1)
-		warn("dbm_unmap: close");
+	if (keep == 0) {
+		if (munmap(dbm_base, st.st_size) == -1)
+			warn("dbm_unmap: munmap");
+		if (close(ifd) == -1)
+			warn("dbm_unmap: close");
+	}
 	dbm_base = (char *)-1;
 }
 
+/*
+ * Start or stop keeping databases mapped after dbm_unmap().
+ * Stopping unmaps all databases that are still mapped.
+ */
+void
+dbm_map_keep(int newkeep)
+{
+	if ((keep = newkeep) == 0)
+		dbm_map_prune(1);
+}
+
+/*
+ * Unmap kept databases that were unlinked, for example because
+ * makewhatis(8) renamed a new version over them, or that changed
+ * in place.  With a non-zero argument, unmap all of them.
+ */
+static void
+dbm_map_prune(int all)
+{
+	struct stat	  sb;
+	struct dbm_kept	**kpp, *kp;
+
+	kpp = &kept;
+	while ((kp = *kpp) != NULL) {
+		if (all == 0 && fstat(kp->fd, &sb) == 0 &&
+		    sb.st_nlink > 0 && sb.st_size == kp->st.st_size &&
+		    sb.st_mtime == kp->st.st_mtime) {
+			kpp = &kp->next;
+			continue;
+		}
+		if (munmap(kp->base, kp->st.st_size) == -1)
+			warn("dbm_unmap: munmap");
+		if (close(kp->fd) == -1)
+			warn("dbm_unmap: close");
+		*kpp = kp->next;
+		free(kp);
+	}
+}
+
 /*
  * Take a raw integer as it was read from the database.
  * Interpret it as an offset into the database file
@@ -23,6 +23,7 @@ struct dbm_match;
 
 int		 dbm_map(const char *);
 void		 dbm_unmap(void);
+void		 dbm_map_keep(int);
 void		*dbm_get(int32_t);
 int32_t		*dbm_getint(int32_t);
 int32_t		 dbm_addr(const void *);
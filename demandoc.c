@@ -104,6 +104,7 @@ main(int argc, char *argv[])
 	}
 
 	mparse_free(mp);
+	roffhash_freeall();
 	mchars_free();
 #if DEBUG_MEMORY
 	mandoc_dbg_finish();
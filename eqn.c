@@ -23,12 +23,15 @@
 #include <assert.h>
 #include <ctype.h>
 #include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 #include "mandoc_aux.h"
+#include "mandoc_ohash.h"
 #include "mandoc.h"
 #include "roff.h"
 #include "eqn.h"
@@ -287,19 +290,30 @@ enum	parse_mode {
 };
 
 struct	eqn_def {
-	char		 *key;
-	size_t		  keysz;
 	char		 *val;
 	size_t		  valsz;
+	char		  key[];
+};
+
+/*
+ * An equation parsed before, to be shared by later equations
+ * with the same source code as long as no definition changes.
+ */
+struct	eqn_memo {
+	struct eqn_box	 *root;    /* Syntax tree, holding one reference. */
+	int		  gen;     /* Value of eqn_node.gen when parsed. */
+	char		  data[];  /* Source code of the equation. */
 };
 
 static	struct eqn_box	*eqn_box_alloc(struct eqn_node *, struct eqn_box *);
 static	struct eqn_box	*eqn_box_makebinary(struct eqn_node *,
 				struct eqn_box *);
 static	void		 eqn_def(struct eqn_node *);
-static	struct eqn_def	*eqn_def_find(struct eqn_node *);
+static	struct eqn_def	*eqn_def_find(struct eqn_node *, unsigned int *);
+static	void		 eqn_def_free(struct eqn_node *, unsigned int);
 static	void		 eqn_delim(struct eqn_node *);
 static	enum eqn_tok	 eqn_next(struct eqn_node *, enum parse_mode);
+static	void		 eqn_parse_tree(struct eqn_node *);
 static	void		 eqn_undef(struct eqn_node *);
 
 
@@ -309,6 +323,10 @@ eqn_alloc(void)
 	struct eqn_node *ep;
 
 	ep = mandoc_calloc(1, sizeof(*ep));
+	ep->defs = mandoc_malloc(sizeof(*ep->defs));
+	mandoc_ohash_init(ep->defs, 4, offsetof(struct eqn_def, key));
+	ep->memo = mandoc_malloc(sizeof(*ep->memo));
+	mandoc_ohash_init(ep->memo, 4, offsetof(struct eqn_memo, data));
 	ep->gsize = EQN_DEFSIZE;
 	return ep;
 }
@@ -338,19 +356,30 @@ eqn_read(struct eqn_node *ep, const char *p)
 }
 
 /*
- * Find the key "key" of the give size within our eqn-defined values.
+ * Find the current token within our eqn-defined values.
+ * If slot is not NULL, store the hash table slot of the token.
  */
 static struct eqn_def *
-eqn_def_find(struct eqn_node *ep)
+eqn_def_find(struct eqn_node *ep, unsigned int *slot)
 {
-	int		 i;
+	const char	*end;
+	unsigned int	 sl;
 
-	for (i = 0; i < (int)ep->defsz; i++)
-		if (ep->defs[i].keysz && STRNEQ(ep->defs[i].key,
-		    ep->defs[i].keysz, ep->start, ep->toksz))
-			return &ep->defs[i];
+	end = ep->start + ep->toksz;
+	sl = ohash_qlookupi(ep->defs, ep->start, &end);
+	if (slot != NULL)
+		*slot = sl;
+	return ohash_find(ep->defs, sl);
+}
 
-	return NULL;
+static void
+eqn_def_free(struct eqn_node *ep, unsigned int slot)
+{
+	struct eqn_def	*def;
+
+	def = ohash_remove(ep->defs, slot);
+	free(def->val);
+	free(def);
 }
 
 /*
@@ -431,7 +460,7 @@ eqn_next(struct eqn_node *ep, enum parse_mode mode)
 			break;
 		if (mode == MODE_NOSUB)
 			return EQN_TOK__MAX;
-		if ((def = eqn_def_find(ep)) == NULL)
+		if ((def = eqn_def_find(ep, NULL)) == NULL)
 			break;
 		if (++ep->subcnt > EQN_NEST_MAX) {
 			mandoc_msg(MANDOCERR_ROFFLOOP,
@@ -487,6 +516,10 @@ eqn_box_free(struct eqn_box *bp)
 {
 	if (bp == NULL)
 		return;
+	if (bp->refs > 0) {
+		bp->refs--;
+		return;
+	}
 
 	if (bp->first)
 		eqn_box_free(bp->first);
@@ -586,6 +619,7 @@ eqn_delim(struct eqn_node *ep)
 		ep->cdelim = *ep->end++;
 		ep->delim = 1;
 	}
+	ep->gen++;
 }
 
 /*
@@ -594,63 +628,49 @@ eqn_delim(struct eqn_node *ep)
 static void
 eqn_undef(struct eqn_node *ep)
 {
-	struct eqn_def	*def;
+	unsigned int	 slot;
 
 	if (eqn_next(ep, MODE_NOSUB) == EQN_TOK_EOF) {
 		mandoc_msg(MANDOCERR_REQ_EMPTY,
 		    ep->node->line, ep->node->pos, "undef");
 		return;
 	}
-	if ((def = eqn_def_find(ep)) == NULL)
+	if (eqn_def_find(ep, &slot) == NULL)
 		return;
-	free(def->key);
-	free(def->val);
-	def->key = def->val = NULL;
-	def->keysz = def->valsz = 0;
+	eqn_def_free(ep, slot);
+	ep->gen++;
 }
 
 static void
 eqn_def(struct eqn_node *ep)
 {
 	struct eqn_def	*def;
-	int		 i;
+	unsigned int	 slot;
 
 	if (eqn_next(ep, MODE_NOSUB) == EQN_TOK_EOF) {
 		mandoc_msg(MANDOCERR_REQ_EMPTY,
 		    ep->node->line, ep->node->pos, "define");
 		return;
 	}
+	ep->gen++;
 
 	/*
 	 * Search for a key that already exists.
 	 * Create a new key if none is found.
 	 */
-	if ((def = eqn_def_find(ep)) == NULL) {
-		/* Find holes in string array. */
-		for (i = 0; i < (int)ep->defsz; i++)
-			if (0 == ep->defs[i].keysz)
-				break;
-
-		if (i == (int)ep->defsz) {
-			ep->defsz++;
-			ep->defs = mandoc_reallocarray(ep->defs,
-			    ep->defsz, sizeof(struct eqn_def));
-			ep->defs[i].key = ep->defs[i].val = NULL;
-		}
-
-		def = ep->defs + i;
-		free(def->key);
-		def->key = mandoc_strndup(ep->start, ep->toksz);
-		def->keysz = ep->toksz;
+	if ((def = eqn_def_find(ep, &slot)) == NULL) {
+		def = mandoc_malloc(sizeof(*def) + ep->toksz + 1);
+		memcpy(def->key, ep->start, ep->toksz);
+		def->key[ep->toksz] = '\0';
+		def->val = NULL;
+		def->valsz = 0;
+		ohash_insert(ep->defs, slot, def);
 	}
 
 	if (eqn_next(ep, MODE_QUOTED) == EQN_TOK_EOF) {
 		mandoc_msg(MANDOCERR_REQ_EMPTY,
 		    ep->node->line, ep->node->pos, "define %s", def->key);
-		free(def->key);
-		free(def->val);
-		def->key = def->val = NULL;
-		def->keysz = def->valsz = 0;
+		eqn_def_free(ep, slot);
 		return;
 	}
 	free(def->val);
@@ -658,8 +678,67 @@ eqn_def(struct eqn_node *ep)
 	def->valsz = ep->toksz;
 }
 
+/*
+ * Parse an equation, or reuse the syntax tree of an identical one
+ * parsed earlier, unless definitions or sizes changed in between.
+ * Equations changing definitions themselves or causing messages
+ * are not reused, such that their effects happen again.
+ */
 void
 eqn_parse(struct eqn_node *ep)
+{
+	struct eqn_memo	*memo;
+	unsigned long	 nmsg;
+	unsigned int	 slot;
+	int		 gen;
+
+	/*
+	 * Empty equation.
+	 * Do not add it to the high-level syntax tree.
+	 */
+
+	if (ep->data == NULL)
+		return;
+
+	slot = ohash_qlookup(ep->memo, ep->data);
+	memo = ohash_find(ep->memo, slot);
+	if (memo != NULL && memo->gen == ep->gen) {
+		eqn_box_free(ep->node->eqn);
+		ep->node->eqn = memo->root;
+		memo->root->refs++;
+		return;
+	}
+
+	if (memo == NULL) {
+		memo = mandoc_malloc(sizeof(*memo) + ep->sz);
+		memcpy(memo->data, ep->data, ep->sz);
+		memo->root = NULL;
+	}
+	gen = ep->gen;
+	nmsg = mandoc_msg_getcount();
+	eqn_parse_tree(ep);
+
+	/* An existing, outdated entry always has a tree. */
+
+	if (ep->gen != gen || mandoc_msg_getcount() != nmsg) {
+		if (memo->root != NULL) {
+			ohash_remove(ep->memo, slot);
+			eqn_box_free(memo->root);
+		}
+		free(memo);
+		return;
+	}
+	if (memo->root == NULL)
+		ohash_insert(ep->memo, slot, memo);
+	else
+		eqn_box_free(memo->root);
+	memo->root = ep->node->eqn;
+	memo->root->refs++;
+	memo->gen = gen;
+}
+
+static void
+eqn_parse_tree(struct eqn_node *ep)
 {
 	struct eqn_box	*cur, *nbox, *parent, *split;
 	const char	*cp, *cpn;
@@ -671,14 +750,6 @@ eqn_parse(struct eqn_node *ep)
 	parent = ep->node->eqn;
 	assert(parent != NULL);
 
-	/*
-	 * Empty equation.
-	 * Do not add it to the high-level syntax tree.
-	 */
-
-	if (ep->data == NULL)
-		return;
-
 	ep->start = ep->end = ep->data;
 	ep->sublen = 0;
 	ep->subcnt = 0;
@@ -815,6 +886,7 @@ next_tok:
 		}
 		if (EQN_TOK_GSIZE == tok) {
 			ep->gsize = size;
+			ep->gen++;
 			break;
 		}
 		while (parent->args == parent->expectargs)
@@ -1120,17 +1192,31 @@ next_tok:
 void
 eqn_free(struct eqn_node *p)
 {
-	int		 i;
+	struct eqn_def	*def;
+	struct eqn_memo	*memo;
+	unsigned int	 slot;
 
 	if (p == NULL)
 		return;
 
-	for (i = 0; i < (int)p->defsz; i++) {
-		free(p->defs[i].key);
-		free(p->defs[i].val);
+	def = ohash_first(p->defs, &slot);
+	while (def != NULL) {
+		free(def->val);
+		free(def);
+		def = ohash_next(p->defs, &slot);
 	}
+	ohash_delete(p->defs);
+	free(p->defs);
+
+	memo = ohash_first(p->memo, &slot);
+	while (memo != NULL) {
+		eqn_box_free(memo->root);
+		free(memo);
+		memo = ohash_next(p->memo, &slot);
+	}
+	ohash_delete(p->memo);
+	free(p->memo);
 
 	free(p->data);
-	free(p->defs);
 	free(p);
 }
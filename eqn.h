@@ -64,6 +64,7 @@ struct	eqn_box {
 	char		 *bottom;  /* Symbol below. */
 	size_t		  expectargs; /* Maximal number of arguments. */
 	size_t		  args;    /* Actual number of arguments. */
+	int		  refs;    /* Additional owners of this tree. */
 	int		  size;    /* Font size. */
 #define	EQN_DEFSIZE	  INT_MIN
 	enum eqn_boxt	  type;    /* Type of node. */
@@ -21,20 +21,21 @@
 
 struct roff_node;
 struct eqn_box;
-struct eqn_def;
+struct ohash;
 
 struct	eqn_node {
 	struct roff_node *node;    /* Syntax tree of this equation. */
-	struct eqn_def	 *defs;    /* Array of definitions. */
+	struct ohash	 *defs;    /* Definitions, by name. */
+	struct ohash	 *memo;    /* Parsed equations, by source code. */
 	char		 *data;    /* Source code of this equation. */
 	char		 *start;   /* First byte of the current token. */
 	char		 *end;	   /* First byte of the next token. */
-	size_t		  defsz;   /* Number of definitions. */
 	size_t		  sz;      /* Length of the source code. */
 	size_t		  toksz;   /* Length of the current token. */
 	int		  sublen;  /* End of rightmost substitution, so far. */
 	int		  subcnt;  /* Number of recursive substitutions. */
 	int		  gsize;   /* Default point size. */
+	int		  gen;     /* Changes of definitions and sizes. */
 	int		  delim;   /* In-line delimiters enabled. */
 	char		  odelim;  /* In-line opening delimiter. */
 	char		  cdelim;  /* In-line closing delimiter. */
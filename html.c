@@ -143,6 +143,7 @@ html_alloc(const struct manoutput *outopts)
 
 	h = mandoc_calloc(1, sizeof(struct html));
 
+	h->outfp = outopts->outfp == NULL ? stdout : outopts->outfp;
 	h->tag = NULL;
 	h->metac = h->metal = ESCAPE_FONTROMAN;
 	h->style = outopts->style;
@@ -183,8 +184,20 @@ html_reset_internal(struct html *h)
 void
 html_reset(void *p)
 {
-	html_reset_internal(p);
+	struct html	*h;
+
+	h = (struct html *)p;
+	html_reset_internal(h);
 	mandoc_ohash_init(&id_unique, 4, offsetof(struct id_entry, id));
+
+	/* Do not let the state of one document leak into the next. */
+
+	h->flags = 0;
+	h->indent = 0;
+	h->noindent = 0;
+	h->tblt = NULL;
+	h->metaf = NULL;
+	h->metac = h->metal = ESCAPE_FONTROMAN;
 }
 
 void
@@ -194,6 +207,61 @@ html_free(void *p)
 	free(p);
 }
 
+/*
+ * Look up manual page links with the function site before
+ * falling back to the -O man template, if any.
+ */
+void
+html_site(void *p, const char *(*site)(const char *, const char *))
+{
+	((struct html *)p)->site = site;
+}
+
+/*
+ * Write a complete document containing a list of links,
+ * for example an index of the manual pages of one section.
+ */
+void
+html_index(void *p, const char *title, char **labels, char **hrefs,
+    size_t sz)
+{
+	struct html	*h;
+	struct tag	*t, *tli;
+	size_t		 i;
+
+	h = (struct html *)p;
+	print_gen_decls(h);
+	print_otag(h, TAG_HTML, "");
+	t = print_otag(h, TAG_HEAD, "");
+	print_gen_head(h);
+	print_otag(h, TAG_TITLE, "");
+	print_text(h, title);
+	print_tagq(h, t);
+	print_otag(h, TAG_BODY, "");
+	t = print_otag(h, TAG_H2, "");
+	print_text(h, title);
+	print_tagq(h, t);
+	print_otag(h, TAG_UL, "");
+	for (i = 0; i < sz; i++) {
+		tli = print_otag(h, TAG_LI, "");
+		print_otag(h, TAG_A, "h", hrefs[i]);
+		print_text(h, labels[i]);
+		print_tagq(h, tli);
+	}
+	print_tagq(h, NULL);
+}
+
+/*
+ * Decide whether a link to the manual page name(sec) can be written.
+ */
+int
+html_manlink(struct html *h, const char *name, const char *sec)
+{
+	if (h->site != NULL && (*h->site)(name, sec) != NULL)
+		return 1;
+	return h->base_man1 != NULL;
+}
+
 void
 print_gen_head(struct html *h)
 {
@@ -602,6 +670,11 @@ print_href(struct html *h, const char *name, const char *sec, int man)
 	char		*filename;
 
 	if (man) {
+		if (h->site != NULL &&
+		    (pp = (*h->site)(name, sec)) != NULL) {
+			print_encode(h, pp, NULL, 1);
+			return;
+		}
 		pp = h->base_man1;
 		if (h->base_man2 != NULL) {
 			mandoc_asprintf(&filename, "%s.%s", name, sec);
@@ -1014,7 +1087,7 @@ static void
 print_byte(struct html *h, char c)
 {
 	if ((h->flags & HTML_BUFFER) == 0) {
-		putchar(c);
+		putc(c, h->outfp);
 		h->col++;
 		return;
 	}
@@ -1024,13 +1097,13 @@ print_byte(struct html *h, char c)
 		return;
 	}
 
-	putchar('\n');
+	putc('\n', h->outfp);
 	h->col = 0;
 	print_indent(h);
-	putchar(' ');
-	putchar(' ');
-	fwrite(h->buf, h->bufcol, 1, stdout);
-	putchar(c);
+	putc(' ', h->outfp);
+	putc(' ', h->outfp);
+	fwrite(h->buf, h->bufcol, 1, h->outfp);
+	putc(c, h->outfp);
 	h->col = (h->indent + 1) * 2 + h->bufcol + 1;
 	h->bufcol = 0;
 	h->flags &= ~HTML_BUFFER;
@@ -1047,11 +1120,11 @@ print_endline(struct html *h)
 		return;
 
 	if (h->bufcol) {
-		putchar(' ');
-		fwrite(h->buf, h->bufcol, 1, stdout);
+		putc(' ', h->outfp);
+		fwrite(h->buf, h->bufcol, 1, h->outfp);
 		h->bufcol = 0;
 	}
-	putchar('\n');
+	putc('\n', h->outfp);
 	h->col = 0;
 	h->flags |= HTML_NOSPACE;
 	h->flags &= ~HTML_BUFFER;
@@ -1073,8 +1146,8 @@ print_endword(struct html *h)
 		h->col++;
 		h->flags |= HTML_BUFFER;
 	} else if (h->bufcol) {
-		putchar(' ');
-		fwrite(h->buf, h->bufcol, 1, stdout);
+		putc(' ', h->outfp);
+		fwrite(h->buf, h->bufcol, 1, h->outfp);
 		h->col += h->bufcol + 1;
 	}
 	h->bufcol = 0;
@@ -1096,7 +1169,7 @@ print_indent(struct html *h)
 
 	h->col = h->indent * 2;
 	for (i = 0; i < h->col; i++)
-		putchar(' ');
+		putc(' ', h->outfp);
 }
 
 /*
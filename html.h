@@ -100,11 +100,13 @@ struct	html {
 	size_t		  col; /* current output byte position */
 	size_t		  bufcol; /* current buf byte position */
 	char		  buf[80]; /* output buffer */
+	FILE		 *outfp; /* output stream */
 	struct tag	 *tag; /* last open tag */
 	struct rofftbl	  tbl; /* current table */
 	struct tag	 *tblt; /* current open table scope */
 	char		 *base_man1; /* bases for manpage href */
 	char		 *base_man2;
+	const char	*(*site)(const char *, const char *); /* -O site */
 	char		 *base_includes; /* base for include href */
 	char		 *style; /* style-sheet URI */
 	struct tag	 *metaf; /* current open font scope */
@@ -141,4 +143,5 @@ void		  print_endline(struct html *);
 void		  html_close_paragraph(struct html *);
 enum roff_tok	  html_fillmode(struct html *, enum roff_tok);
 char		 *html_make_id(const struct roff_node *, int);
+int		  html_manlink(struct html *, const char *, const char *);
 int		  html_setfont(struct html *, enum mandoc_esc);
@@ -28,17 +28,18 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <dirent.h>
 #if HAVE_ERR
 #include <err.h>
 #endif
 #include <errno.h>
 #include <fcntl.h>
-#include <glob.h>
 #include <limits.h>
 #if HAVE_SANDBOX_INIT
 #include <sandbox.h>
 #endif
 #include <signal.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -48,6 +49,8 @@
 #include <unistd.h>
 
 #include "mandoc_aux.h"
+#include "mandoc_cache.h"
+#include "mandoc_ohash.h"
 #include "mandoc.h"
 #include "mandoc_xr.h"
 #include "roff.h"
@@ -84,38 +87,125 @@ enum	outt {
 struct	outstate {
 	struct tag_files *tag_files;	/* Tagging state variables. */
 	void		 *outdata;	/* data for output */
+	char		 *cacheopts;	/* Parser options for -O cache. */
 	int		  use_pager;
+	int		  early;	/* The parent already runs the pager. */
+	int		  stream;	/* Format while still parsing. */
 	int		  wstop;	/* stop after a file with a warning */
 	int		  had_output;	/* Some output was generated. */
 	enum outt	  outtype;	/* which output to use */
 };
 
+/*
+ * Directory listing used by fs_lookup() instead of stat(2) and glob(3),
+ * such that each directory is read at most once per process.
+ */
+struct	fs_dir {
+	char		**ents;		/* Sorted entry names. */
+	size_t		  entsz;	/* Number of entries. */
+	char		  path[];	/* Directory name; the hash key. */
+};
+
+/*
+ * Header of the output of one file sent by a -j worker process,
+ * followed by the standard error and standard output data.
+ */
+struct	jobrec {
+	size_t		  errsz;	/* Bytes of standard error output. */
+	size_t		  outsz;	/* Bytes of standard output. */
+	enum mandoclevel  rc;		/* Exit status of the worker so far. */
+	int		  had_output;	/* The file was formatted. */
+	int		  tag_found;	/* The -O tag target was found. */
+};
+
+/*
+ * A manual page of the -O site, found by its file name without
+ * directory and without .gz, which is how .Xr refers to it.
+ */
+struct	site_page {
+	const char	 *path;		/* Output file below the site. */
+	char		  name[];	/* Hash key, for example ls.1. */
+};
+
 
 int			  mandocdb(int, char *[]);
 
+static	char		 *cache_lookup(int, const struct outstate *,
+				const struct manoutput *,
+				struct roff_meta **, char **);
+static	void		  cache_store(const char *, const char *,
+				const struct roff_meta *, const char *);
 static	void		  check_xr(struct manpaths *);
+static	char		 *lint_dep(const char *);
+static	int		  lint_hash(int, uint64_t *);
+static	void		  lint_include(void *, const char *);
+static	int		  lint_lookup(int, const char *,
+				const struct outstate *,
+				const struct manoutput *, char **, char **);
+static	void		  lint_store(const char *, const char *,
+				FILE *, enum mandoclevel);
 static	void		  fs_append(char **, size_t, int,
 				size_t, const char *, enum form,
 				struct manpage **, size_t *);
+static	int		  fs_dir_cmp(const void *, const void *);
+static	void		  fs_dir_free(void);
+static	struct fs_dir	 *fs_dir_get(const char *);
+static	size_t		  fs_dir_match(const char *, const char *,
+				const char *, char ***);
+static	char		 *fs_dir_stat(const char *, const char *);
 static	int		  fs_lookup(const struct manpaths *, size_t,
 				const char *, const char *, const char *,
 				struct manpage **, size_t *);
 static	int		  fs_search(const struct mansearch *,
 				const struct manpaths *, const char *,
 				struct manpage **, size_t *);
-static	void		  glob_esc(char **, const char *, const char *);
+static	int		  jobs_copy(int, int, size_t);
+static	int		  jobs_run(struct mparse *, struct manpage *, size_t,
+				int, struct outstate *, struct manconf *, int);
+static	void		  jobs_worker(struct mparse *, struct manpage *,
+				size_t, int, struct outstate *,
+				struct manconf *, int, int, int)
+				__attribute__((__noreturn__));
 static	void		  outdata_alloc(struct outstate *, struct manoutput *);
+static	const char	 *pager_cmd(void);
+static	void		  pager_early(struct outstate *, struct manconf *);
 static	void		  parse(struct mparse *, int, const char *,
 				struct outstate *, struct manconf *);
 static	void		  passthrough(int, int);
 static	void		  process_onefile(struct mparse *, struct manpage *,
 				int, struct outstate *, struct manconf *);
 static	void		  run_pager(struct outstate *, char *);
+static	void		  site_add(size_t, char *,
+				struct manpage **, size_t *);
+static	int		  site_close(const char *);
+static	int		  site_cmp(const void *, const void *);
+static	void		  site_free(void);
+static	const char	 *site_href(const char *, const char *);
+static	void		  site_index(struct outstate *, struct manconf *,
+				struct manpage *, size_t);
+static	int		  site_open(const char *, const char *);
+static	size_t		  site_plan(const struct manconf *, const char *,
+				struct manpage *, size_t);
+static	void		  site_prune(const char *, char *,
+				const struct manpage *, size_t);
+static	void		  site_scan(const struct manpaths *, size_t,
+				const char *, const char *, int,
+				struct manpage **, size_t *);
 static	pid_t		  spawn_pager(struct outstate *, char *);
+static	void		  stream_node(void *, const struct roff_meta *,
+				struct roff_node *);
 static	void		  usage(enum argmode) __attribute__((__noreturn__));
 static	int		  woptions(char *, enum mandoc_os *, int *);
 
 static	const int sec_prios[] = {1, 4, 5, 8, 6, 3, 7, 2, 9};
+static	struct ohash	 *fs_dirs;
+static	char		**lint_incs;	/* Files included with .so. */
+static	size_t		  lint_incsz;
+static	struct ohash	 *site_pages;	/* Pages of -O site by name. */
+static	char		 *site_state;	/* Contents of the state file. */
+static	const char	 *site_cur;	/* Output file being written. */
+static	char		 *site_tmp;	/* Its temporary name. */
+static	int		  site_stdout = -1; /* Saved standard output. */
 static	char		  help_arg[] = "help";
 static	char		 *help_argv[] = {help_arg, NULL};
 
@@ -132,19 +222,25 @@ main(int argc, char *argv[])
 	struct mparse	*mp;		/* Opaque parser object. */
 	const char	*conf_file;	/* -C: alternate config file. */
 	const char	*os_s;		/* -I: Operating system for display. */
+	const char	*sockpath;	/* -D: Serve searches on socket. */
 	const char	*progname, *sec, *ep;
+	const char	*errstr;
 	char		*defpaths;	/* -M: override manpaths. */
 	char		*auxpaths;	/* -m: additional manpaths. */
 	char		*oarg;		/* -O: output option string. */
 	char		*tagarg;	/* -O tag: default value. */
+	char		*sitefp;	/* -O site: output options. */
+	char		*cp;
 	unsigned char	*uc;
 	size_t		 ressz;		/* Number of elements in res[]. */
+	size_t		 procsz;	/* Elements of res[] to format. */
 	size_t		 resnsz;	/* Number of elements in resn[]. */
 	size_t		 i, ib, ssz;
 	int		 options;	/* Parser options. */
 	int		 show_usage;	/* Invalid argument: give up. */
 	int		 prio, best_prio;
 	int		 startdir;
+	int		 jobs;		/* -j: number of worker processes. */
 	int		 c;
 	enum mandoc_os	 os_e;		/* Check base system conventions. */
 	enum outmode	 outmode;	/* According to command line. */
@@ -170,7 +266,8 @@ main(int argc, char *argv[])
 		return mandocdb(argc, argv);
 
 #if HAVE_PLEDGE
-	if (pledge("stdio rpath wpath cpath tmppath tty proc exec", NULL) == -1) {
+	if (pledge("stdio rpath wpath cpath tmppath tty proc exec unix",
+	    NULL) == -1) {
 		mandoc_msg(MANDOCERR_PLEDGE, 0, 0, "%s", strerror(errno));
 		return mandoc_msg_getrc();
 	}
@@ -183,7 +280,7 @@ main(int argc, char *argv[])
 	/* Search options. */
 
 	memset(&conf, 0, sizeof(conf));
-	conf_file = NULL;
+	conf_file = sockpath = NULL;
 	defpaths = auxpaths = NULL;
 
 	memset(&search, 0, sizeof(struct mansearch));
@@ -216,9 +313,10 @@ main(int argc, char *argv[])
 
 	show_usage = 0;
 	outmode = OUTMODE_DEF;
+	jobs = 0;
 
 	while ((c = getopt(argc, argv,
-	    "aC:cfhI:iK:klM:m:O:S:s:T:VW:w")) != -1) {
+	    "aC:cD:fhI:ij:K:klM:m:O:S:s:T:VW:w")) != -1) {
 		if (c == 'i' && search.argmode == ARG_EXPR) {
 			optind--;
 			break;
@@ -233,6 +331,9 @@ main(int argc, char *argv[])
 		case 'c':
 			outst.use_pager = 0;
 			break;
+		case 'D':
+			sockpath = optarg;
+			break;
 		case 'f':
 			search.argmode = ARG_WORD;
 			break;
@@ -254,6 +355,14 @@ main(int argc, char *argv[])
 			}
 			os_s = optarg + 3;
 			break;
+		case 'j':
+			jobs = strtonum(optarg, 1, 256, &errstr);
+			if (errstr != NULL) {
+				mandoc_msg(MANDOCERR_BADARG_BAD, 0, 0,
+				    "-j %s: %s", optarg, errstr);
+				return mandoc_msg_getrc();
+			}
+			break;
 		case 'K':
 			options &= ~(MPARSE_UTF8 | MPARSE_LATIN1);
 			if (strcmp(optarg, "utf-8") == 0)
@@ -330,8 +439,33 @@ main(int argc, char *argv[])
 		}
 	}
 
-	if (show_usage)
+	/* Searching with -j is not supported. */
+
+	if (show_usage || (jobs > 0 &&
+	    (search.argmode == ARG_EXPR || search.argmode == ARG_WORD)))
 		usage(search.argmode);
+	if (jobs == 0)
+		jobs = 1;
+
+	/*
+	 * In server mode, the clients send their own manpaths,
+	 * so neither other arguments nor configuration are needed.
+	 */
+
+	if (sockpath != NULL) {
+		if ((search.argmode != ARG_EXPR &&
+		     search.argmode != ARG_WORD) || optind < argc)
+			usage(search.argmode);
+#if HAVE_PLEDGE
+		if (pledge("stdio rpath cpath unix", NULL) == -1) {
+			mandoc_msg(MANDOCERR_PLEDGE, 0, 0,
+			    "%s", strerror(errno));
+			return mandoc_msg_getrc();
+		}
+#endif
+		mansearch_serve(sockpath);
+		return (int)MANDOCLEVEL_SYSERR;
+	}
 
 	/* Postprocess options. */
 
@@ -373,6 +507,28 @@ main(int argc, char *argv[])
 		}
 	}
 
+	/*
+	 * The -O site directory is used after changing directories,
+	 * so it has to be an absolute path.
+	 */
+
+	if (conf.output.site != NULL) {
+		if (outst.outtype != OUTT_HTML ||
+		    search.argmode != ARG_FILE) {
+			mandoc_msg(MANDOCERR_BADVAL_BAD, 0, 0,
+			    "-O site=%s: requires mandoc -T html",
+			    conf.output.site);
+			return mandoc_msg_getrc();
+		}
+		if ((cp = realpath(conf.output.site, NULL)) == NULL) {
+			mandoc_msg(MANDOCERR_BADVAL_BAD, 0, 0, "-O site=%s: %s",
+			    conf.output.site, strerror(errno));
+			return mandoc_msg_getrc();
+		}
+		free(conf.output.site);
+		conf.output.site = cp;
+	}
+
 	if (outst.outtype != OUTT_TREE || conf.output.noval == 0)
 		options |= MPARSE_VALIDATE;
 
@@ -393,8 +549,32 @@ main(int argc, char *argv[])
 			conf.output.indent = 3;
 	}
 
+	/*
+	 * Formatting files in parallel requires that the output of
+	 * each file is independent of the files before it, which is
+	 * not the case for PostScript and PDF documents, nor for the
+	 * line numbers in the tag file used by the pager.
+	 */
+
+	if (outst.use_pager || outst.outtype == OUTT_PS ||
+	    outst.outtype == OUTT_PDF)
+		jobs = 1;
+
+	/* Connect to a search server while pledge(2) still allows it. */
+
+	if (search.argmode != ARG_FILE &&
+	    (cp = getenv("MANSOCKET")) != NULL && *cp != '\0')
+		(void)mansearch_connect(cp);
+
 #if HAVE_PLEDGE
-	if (outst.use_pager == 0)
+	if (jobs > 1)
+		c = pledge(conf.output.cache == NULL &&
+		    conf.output.site == NULL ? "stdio rpath tmppath proc" :
+		    "stdio rpath wpath cpath tmppath proc", NULL);
+	else if (conf.output.cache != NULL || conf.output.site != NULL)
+		c = pledge(outst.use_pager == 0 ? "stdio rpath wpath cpath" :
+		    "stdio rpath wpath cpath tmppath tty proc exec", NULL);
+	else if (outst.use_pager == 0)
 		c = pledge("stdio rpath", NULL);
 	else if (conf.output.outfilename != NULL ||
 	    conf.output.tagfilename != NULL)
@@ -455,11 +635,30 @@ main(int argc, char *argv[])
 		conf.output.tag = tagarg == NULL ? *argv : tagarg + 1;
 	}
 
+	/*
+	 * With -O site, the arguments are manual trees,
+	 * overriding the manpath like -M does.
+	 */
+
+	sitefp = NULL;
+	if (conf.output.site != NULL && argc > 0) {
+		for (i = 0; i < (size_t)argc; i++) {
+			cp = sitefp;
+			if (cp == NULL)
+				sitefp = mandoc_strdup(argv[i]);
+			else
+				mandoc_asprintf(&sitefp, "%s:%s", cp, argv[i]);
+			free(cp);
+		}
+		defpaths = sitefp;
+	}
+
 	/* Read the configuration file. */
 
-	if (search.argmode != ARG_FILE ||
+	if (search.argmode != ARG_FILE || conf.output.site != NULL ||
 	    mandoc_msg_getmin() == MANDOCERR_STYLE)
 		manconf_parse(&conf, conf_file, defpaths, auxpaths);
+	free(sitefp);
 
 	/* man(1): Resolve each name individually. */
 
@@ -579,6 +778,15 @@ main(int argc, char *argv[])
 			goto out;
 		}
 
+	/* mandoc(1) -O site: Take all manual pages in the trees. */
+
+	} else if (conf.output.site != NULL) {
+		res = NULL;
+		ressz = 0;
+		for (i = 0; i < conf.manpath.sz; i++)
+			site_scan(&conf.manpath, i, conf.manpath.paths[i],
+			    NULL, 0, &res, &ressz);
+
 	/* mandoc(1): Take command line arguments as file names. */
 
 	} else {
@@ -616,6 +824,44 @@ main(int argc, char *argv[])
 
 	mchars_alloc();
 	mp = mparse_alloc(options, os_e, os_s);
+	mparse_include_cache(mp, MPARSE_INCLSZ);
+	if (conf.output.cache != NULL) {
+		mandoc_asprintf(&outst.cacheopts, "%d %d %s",
+		    options, (int)os_e, os_s == NULL ? "" : os_s);
+		if (outst.outtype == OUTT_LINT)
+			mparse_include(mp, lint_include, NULL);
+	}
+
+	/*
+	 * With -O site, only format the pages that changed.
+	 */
+
+	procsz = ressz;
+	if (conf.output.site != NULL) {
+		mandoc_asprintf(&sitefp, "%d %d %s %s %s %s %d %d",
+		    options, (int)os_e, os_s == NULL ? "" : os_s,
+		    conf.output.style == NULL ? "" : conf.output.style,
+		    conf.output.man == NULL ? "" : conf.output.man,
+		    conf.output.includes == NULL ? "" :
+		    conf.output.includes,
+		    conf.output.fragment, conf.output.toc);
+		procsz = site_plan(&conf, sitefp, res, ressz);
+		free(sitefp);
+	}
+
+	/*
+	 * Formatting sections as soon as they are parsed
+	 * is only supported for plain terminal output, and
+	 * not when the whole page is needed before output.
+	 */
+
+	if (conf.output.stream && outst.wstop == 0 &&
+	    conf.output.cache == NULL && conf.output.synopsisonly == 0 &&
+	    (outst.outtype == OUTT_ASCII || outst.outtype == OUTT_UTF8 ||
+	     outst.outtype == OUTT_LOCALE)) {
+		outst.stream = 1;
+		mparse_stream(mp, stream_node, &outst);
+	}
 
 	/*
 	 * Remember the original working directory, if possible.
@@ -625,15 +871,21 @@ main(int argc, char *argv[])
 	 * readable: Maybe it won't be needed after all.
 	 */
 	startdir = open(".", O_RDONLY | O_DIRECTORY);
-	for (i = 0; i < ressz; i++) {
-		process_onefile(mp, res + i, startdir, &outst, &conf);
-		if (outst.wstop && mandoc_msg_getrc() != MANDOCLEVEL_OK)
-			break;
+	if (jobs < 2 || procsz < 2 ||
+	    jobs_run(mp, res, procsz, startdir, &outst, &conf, jobs) == -1) {
+		for (i = 0; i < procsz; i++) {
+			process_onefile(mp, res + i, startdir, &outst, &conf);
+			if (outst.wstop &&
+			    mandoc_msg_getrc() != MANDOCLEVEL_OK)
+				break;
+		}
 	}
 	if (startdir != -1) {
 		(void)fchdir(startdir);
 		close(startdir);
 	}
+	if (conf.output.site != NULL)
+		site_index(&outst, &conf, res, ressz);
 	if (conf.output.tag != NULL && conf.output.tag_found == 0) {
 		mandoc_msg(MANDOCERR_TAG, 0, 0, "%s", conf.output.tag);
 		conf.output.tag = NULL;
@@ -658,19 +910,23 @@ main(int argc, char *argv[])
 	}
 	mandoc_xr_free();
 	mparse_free(mp);
+	roffhash_freeall();
 	mchars_free();
+	free(outst.cacheopts);
 
 out:
 	mansearch_free(res, ressz);
-	if (search.argmode != ARG_FILE)
-		manconf_free(&conf);
+	fs_dir_free();
+	site_free();
+	manconf_free(&conf);
 
 	if (outst.tag_files != NULL) {
-		if (term_tag_close() != -1 &&
+		if (term_tag_close() != -1 && outst.early == 0 &&
 		    conf.output.outfilename == NULL &&
 		    conf.output.tagfilename == NULL)
 			run_pager(&outst, conf.output.tag);
-		term_tag_unlink();
+		if (outst.early == 0)
+			term_tag_unlink();
 	} else if (outst.had_output && outst.outtype != OUTT_LINT)
 		mandoc_msg_summary();
 
@@ -685,41 +941,32 @@ usage(enum argmode argmode)
 {
 	switch (argmode) {
 	case ARG_FILE:
-		fputs("usage: mandoc [-ac] [-I os=name] "
-		    "[-K encoding] [-mdoc | -man] [-O options]\n"
-		    "\t      [-T output] [-W level] [file ...]\n", stderr);
+		fputs("usage: mandoc [-ac] [-I os=name] [-j jobs] "
+		    "[-K encoding] [-mdoc | -man]\n"
+		    "\t      [-O options] [-T output] [-W level] [file ...]\n",
+		    stderr);
 		break;
 	case ARG_NAME:
-		fputs("usage: man [-acfhklw] [-C file] [-M path] "
-		    "[-m path] [-S subsection]\n"
-		    "\t   [[-s] section] name ...\n", stderr);
+		fputs("usage: man [-acfhklw] [-C file] [-j jobs] [-M path] "
+		    "[-m path]\n"
+		    "\t   [-S subsection] [[-s] section] name ...\n", stderr);
 		break;
 	case ARG_WORD:
 		fputs("usage: whatis [-afk] [-C file] "
 		    "[-M path] [-m path] [-O outkey] [-S arch]\n"
-		    "\t      [-s section] name ...\n", stderr);
+		    "\t      [-s section] name ...\n"
+		    "       whatis -D socket\n", stderr);
 		break;
 	case ARG_EXPR:
 		fputs("usage: apropos [-afk] [-C file] "
 		    "[-M path] [-m path] [-O outkey] [-S arch]\n"
-		    "\t       [-s section] expression ...\n", stderr);
+		    "\t       [-s section] expression ...\n"
+		    "       apropos -D socket\n", stderr);
 		break;
 	}
 	exit((int)MANDOCLEVEL_BADARG);
 }
 
-static void
-glob_esc(char **dst, const char *src, const char *suffix)
-{
-	while (*src != '\0') {
-		if (strchr("*?[", *src) != NULL)
-			*(*dst)++ = '\\';
-		*(*dst)++ = *src++;
-	}
-	while (*suffix != '\0')
-		*(*dst)++ = *suffix++;
-}
-
 static void
 fs_append(char **file, size_t filesz, int copy, size_t ipath,
     const char *sec, enum form form, struct manpage **res, size_t *ressz)
@@ -744,107 +991,267 @@ fs_append(char **file, size_t filesz, int copy, size_t ipath,
 	}
 }
 
+static int
+fs_dir_cmp(const void *a, const void *b)
+{
+	return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+/*
+ * Return the listing of the directory dirname, reading it
+ * from the file system if this is the first request for it.
+ * A directory that cannot be read yields an empty listing.
+ */
+static struct fs_dir *
+fs_dir_get(const char *dirname)
+{
+	struct fs_dir	*dir;
+	DIR		*dirp;
+	struct dirent	*dp;
+	const char	*end;
+	size_t		 entsz, len;
+	unsigned int	 slot;
+
+	if (fs_dirs == NULL) {
+		fs_dirs = mandoc_malloc(sizeof(*fs_dirs));
+		mandoc_ohash_init(fs_dirs, 4, offsetof(struct fs_dir, path));
+	}
+	end = NULL;
+	slot = ohash_qlookupi(fs_dirs, dirname, &end);
+	if ((dir = ohash_find(fs_dirs, slot)) != NULL)
+		return dir;
+
+	len = end - dirname + 1;
+	dir = mandoc_malloc(sizeof(*dir) + len);
+	memcpy(dir->path, dirname, len);
+	dir->ents = NULL;
+	dir->entsz = entsz = 0;
+	if ((dirp = opendir(dirname)) == NULL) {
+		if (errno != ENOENT && errno != ENOTDIR)
+			mandoc_msg(MANDOCERR_OPENDIR, 0, 0,
+			    "%s: %s", dirname, strerror(errno));
+	} else {
+		while ((dp = readdir(dirp)) != NULL) {
+			if (dir->entsz == entsz) {
+				entsz = entsz == 0 ? 64 : entsz * 2;
+				dir->ents = mandoc_reallocarray(dir->ents,
+				    entsz, sizeof(*dir->ents));
+			}
+			dir->ents[dir->entsz++] = mandoc_strdup(dp->d_name);
+		}
+		closedir(dirp);
+		qsort(dir->ents, dir->entsz, sizeof(*dir->ents), fs_dir_cmp);
+	}
+	ohash_insert(fs_dirs, slot, dir);
+	return dir;
+}
+
+static void
+fs_dir_free(void)
+{
+	struct fs_dir	*dir;
+	size_t		 i;
+	unsigned int	 slot;
+
+	if (fs_dirs == NULL)
+		return;
+	for (dir = ohash_first(fs_dirs, &slot); dir != NULL;
+	     dir = ohash_next(fs_dirs, &slot)) {
+		for (i = 0; i < dir->entsz; i++)
+			free(dir->ents[i]);
+		free(dir->ents);
+		free(dir);
+	}
+	ohash_delete(fs_dirs);
+	free(fs_dirs);
+	fs_dirs = NULL;
+}
+
+/*
+ * Find the entries in the directory dirname that start with the
+ * string pre followed by one of the characters in next, or by
+ * anything at all if next is NULL.  If pre contains slashes,
+ * look in the respective subdirectory instead.  Return the number
+ * of matches and store the full path names in *files, sorted in
+ * the same way as glob(3) would sort them.
+ */
+static size_t
+fs_dir_match(const char *dirname, const char *pre, const char *next,
+    char ***files)
+{
+	struct fs_dir	*dir;
+	char		*path, *subdir, *cp;
+	size_t		 filesz, lo, hi, mid, presz;
+
+	*files = NULL;
+	if ((cp = strrchr(pre, '/')) != NULL) {
+		subdir = mandoc_strndup(pre, cp - pre);
+		path = fs_dir_stat(dirname, subdir);
+		free(subdir);
+		if (path == NULL)
+			return 0;
+		dir = fs_dir_get(path);
+		free(path);
+		pre = cp + 1;
+	} else
+		dir = fs_dir_get(dirname);
+
+	/* Find the first entry not sorting before the prefix. */
+
+	presz = strlen(pre);
+	lo = 0;
+	hi = dir->entsz;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (strncmp(dir->ents[mid], pre, presz) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	filesz = 0;
+	while (lo < dir->entsz && strncmp(dir->ents[lo], pre, presz) == 0) {
+		if (next == NULL || (dir->ents[lo][presz] != '\0' &&
+		    strchr(next, dir->ents[lo][presz]) != NULL)) {
+			*files = mandoc_reallocarray(*files,
+			    filesz + 1, sizeof(**files));
+			mandoc_asprintf(*files + filesz++, "%s/%s",
+			    dir->path, dir->ents[lo]);
+		}
+		lo++;
+	}
+	return filesz;
+}
+
+/*
+ * Check whether the directory dirname contains the relative path
+ * fname, using the cached directory listings.  For names that
+ * contain slashes, each component is looked up in turn.  Confirm
+ * the final match with stat(2) such that dangling symbolic links
+ * are not reported.  Return the full path name or NULL.
+ */
+static char *
+fs_dir_stat(const char *dirname, const char *fname)
+{
+	struct stat	 sb;
+	struct fs_dir	*dir;
+	char		*comp, *path, *cp;
+	const char	*ent;
+
+	path = mandoc_strdup(dirname);
+	comp = mandoc_strdup(fname);
+	for (ent = cp = comp; ent != NULL; ent = cp) {
+		if ((cp = strchr(cp, '/')) != NULL)
+			*cp++ = '\0';
+		if (*ent == '\0')
+			continue;
+		dir = fs_dir_get(path);
+		if (dir->entsz == 0 || bsearch(&ent, dir->ents, dir->entsz,
+		    sizeof(*dir->ents), fs_dir_cmp) == NULL) {
+			free(comp);
+			free(path);
+			return NULL;
+		}
+		free(path);
+		mandoc_asprintf(&path, "%s/%s", dir->path, ent);
+	}
+	free(comp);
+	if (stat(path, &sb) == -1) {
+		free(path);
+		return NULL;
+	}
+	return path;
+}
+
 static int
 fs_lookup(const struct manpaths *paths, size_t ipath,
 	const char *sec, const char *arch, const char *name,
 	struct manpage **res, size_t *ressz)
 {
 	struct stat	 sb;
-	glob_t		 globinfo;
-	char		*file, *cp, secnum[2];
-	int		 globres;
+	char		**files;
+	char		*dirname, *fname, *file, *pre, secnum[2];
+	size_t		 filesz;
+	int		 irc;
 	enum form	 form;
 
-	const char *const slman = "/man";
-	const char *const slash = "/";
-	const char *const sglob = ".[01-9]*";
-	const char *const dot   = ".";
-	const char *const aster = "*";
-
-	memset(&globinfo, 0, sizeof(globinfo));
+	files = NULL;
+	filesz = 0;
 	form = FORM_SRC;
 
-	mandoc_asprintf(&file, "%s/man%s/%s.%s",
-	    paths->paths[ipath], sec, name, sec);
-	if (stat(file, &sb) != -1)
+	mandoc_asprintf(&dirname, "%s/man%s", paths->paths[ipath], sec);
+	mandoc_asprintf(&fname, "%s.%s", name, sec);
+	file = fs_dir_stat(dirname, fname);
+	free(fname);
+	if (file != NULL)
 		goto found;
-	free(file);
 
-	mandoc_asprintf(&file, "%s/cat%s/%s.0",
-	    paths->paths[ipath], sec, name);
-	if (stat(file, &sb) != -1) {
+	free(dirname);
+	mandoc_asprintf(&dirname, "%s/cat%s", paths->paths[ipath], sec);
+	mandoc_asprintf(&fname, "%s.0", name);
+	file = fs_dir_stat(dirname, fname);
+	free(fname);
+	if (file != NULL) {
 		form = FORM_CAT;
 		goto found;
 	}
-	free(file);
 
+	free(dirname);
+	mandoc_asprintf(&dirname, "%s/man%s", paths->paths[ipath], sec);
 	if (arch != NULL) {
-		mandoc_asprintf(&file, "%s/man%s/%s/%s.%s",
-		    paths->paths[ipath], sec, arch, name, sec);
-		if (stat(file, &sb) != -1)
+		mandoc_asprintf(&fname, "%s/%s.%s", arch, name, sec);
+		file = fs_dir_stat(dirname, fname);
+		free(fname);
+		if (file != NULL)
 			goto found;
-		free(file);
 	}
 
-	cp = file = mandoc_malloc(strlen(paths->paths[ipath]) * 2 +
-	    strlen(slman) + strlen(sec) * 2 + strlen(slash) +
-	    strlen(name) * 2 + strlen(sglob) + 1);
-	glob_esc(&cp, paths->paths[ipath], slman);
-	glob_esc(&cp, sec, slash);
-	glob_esc(&cp, name, sglob);
-	*cp = '\0';
-	globres = glob(file, 0, NULL, &globinfo);
-	if (globres != 0 && globres != GLOB_NOMATCH)
-		mandoc_msg(MANDOCERR_GLOB, 0, 0,
-		    "%s: %s", file, strerror(errno));
-	free(file);
-	file = NULL;
-	if (globres == 0)
+	/*
+	 * Emulate glob(3) for man<sec>/<name>.[01-9]*
+	 * and man<secnum>/<name>.<sec>* using the listings.
+	 */
+
+	mandoc_asprintf(&pre, "%s.", name);
+	filesz = fs_dir_match(dirname, pre, "0123456789", &files);
+	free(pre);
+	if (filesz > 0)
 		goto found;
-	globfree(&globinfo);
 
 	if (sec[1] != '\0' && *ressz == 0) {
 		secnum[0] = sec[0];
 		secnum[1] = '\0';
-		cp = file = mandoc_malloc(strlen(paths->paths[ipath]) * 2 +
-		    strlen(slman) + strlen(secnum) * 2 + strlen(slash) +
-		    strlen(name) * 2 + strlen(dot) +
-		    strlen(sec) * 2 + strlen(aster) + 1);
-		glob_esc(&cp, paths->paths[ipath], slman);
-		glob_esc(&cp, secnum, slash);
-		glob_esc(&cp, name, dot);
-		glob_esc(&cp, sec, aster);
-		*cp = '\0';
-		globres = glob(file, 0, NULL, &globinfo);
-		if (globres != 0 && globres != GLOB_NOMATCH)
-			mandoc_msg(MANDOCERR_GLOB, 0, 0,
-			    "%s: %s", file, strerror(errno));
-		free(file);
-		file = NULL;
-		if (globres == 0)
+		free(dirname);
+		mandoc_asprintf(&dirname, "%s/man%s",
+		    paths->paths[ipath], secnum);
+		mandoc_asprintf(&pre, "%s.%s", name, sec);
+		filesz = fs_dir_match(dirname, pre, NULL, &files);
+		free(pre);
+		if (filesz > 0)
 			goto found;
-		globfree(&globinfo);
 	}
+	free(dirname);
 
 	if (res != NULL || ipath + 1 != paths->sz)
 		return -1;
 
 	mandoc_asprintf(&file, "%s.%s", name, sec);
-	globres = stat(file, &sb);
+	irc = stat(file, &sb);
 	free(file);
-	return globres;
+	return irc;
 
 found:
+	free(dirname);
 	warnx("outdated mandoc.db lacks %s(%s) entry, run %s %s",
 	    name, sec, BINM_MAKEWHATIS, paths->paths[ipath]);
-	if (res == NULL)
+	if (res == NULL) {
 		free(file);
-	else if (file == NULL)
-		fs_append(globinfo.gl_pathv, globinfo.gl_pathc, 1,
-		    ipath, sec, form, res, ressz);
+		while (filesz > 0)
+			free(files[--filesz]);
+	} else if (file == NULL)
+		fs_append(files, filesz, 0, ipath, sec, form, res, ressz);
 	else
 		fs_append(&file, 1, 0, ipath, sec, form, res, ressz);
-	globfree(&globinfo);
+	free(files);
 	return 0;
 }
 
@@ -878,6 +1285,173 @@ fs_search(const struct mansearch *cfg, const struct manpaths *paths,
 	return -1;
 }
 
+/*
+ * Format the files on the given number of worker processes,
+ * each taking every jobs-th file, such that the parent process
+ * can read their output in the original order, one pipe at a time.
+ * Return -1 if the workers could not be started.
+ */
+static int
+jobs_run(struct mparse *mp, struct manpage *res, size_t ressz,
+    int startdir, struct outstate *outst, struct manconf *conf, int jobs)
+{
+	struct jobrec	 rec;
+	pid_t		*pids;
+	int		*fds;
+	size_t		 i;
+	ssize_t		 nr;
+	int		 fd[2], ij, jj, failed, stopped;
+
+	if ((size_t)jobs > ressz)
+		jobs = ressz;
+	pids = mandoc_reallocarray(NULL, jobs, sizeof(*pids));
+	fds = mandoc_reallocarray(NULL, jobs, sizeof(*fds));
+	fflush(stdout);
+	fflush(stderr);
+	for (ij = 0; ij < jobs; ij++) {
+		if (pipe(fd) == -1)
+			break;
+		if ((pids[ij] = fork()) == -1) {
+			mandoc_msg(MANDOCERR_FORK, 0, 0,
+			    "%s", strerror(errno));
+			close(fd[0]);
+			close(fd[1]);
+			break;
+		}
+		if (pids[ij] == 0) {
+			close(fd[0]);
+			for (jj = 0; jj < ij; jj++)
+				close(fds[jj]);
+			jobs_worker(mp, res, ressz, startdir,
+			    outst, conf, ij, jobs, fd[1]);
+		}
+		close(fd[1]);
+		fds[ij] = fd[0];
+	}
+
+	/* If not all workers could be started, give up on all. */
+
+	failed = stopped = ij < jobs;
+	if (stopped)
+		jobs = ij;
+
+	for (i = 0; stopped == 0 && i < ressz; i++) {
+		ij = i % jobs;
+		while ((nr = read(fds[ij], &rec, sizeof(rec))) == -1 &&
+		    errno == EINTR)
+			continue;
+		if (nr != sizeof(rec) ||
+		    jobs_copy(fds[ij], STDERR_FILENO, rec.errsz) == -1) {
+			mandoc_msg(MANDOCERR_READ, 0, 0, "%s: %s",
+			    res[i].file, nr == -1 ? strerror(errno) :
+			    "worker process died");
+			stopped = 1;
+			break;
+		}
+		if (rec.had_output && outst->had_output &&
+		    outst->outtype <= OUTT_UTF8) {
+			if (outst->outdata == NULL)
+				outdata_alloc(outst, &conf->output);
+			terminal_sepline(outst->outdata);
+			fflush(stdout);
+		}
+		if (jobs_copy(fds[ij], STDOUT_FILENO, rec.outsz) == -1) {
+			mandoc_msg(MANDOCERR_READ, 0, 0, "%s: %s",
+			    res[i].file, "worker process died");
+			stopped = 1;
+			break;
+		}
+		if (rec.had_output)
+			outst->had_output = 1;
+		if (rec.tag_found)
+			conf->output.tag_found = 1;
+		mandoc_msg_setrc(rec.rc);
+		if (outst->wstop && mandoc_msg_getrc() != MANDOCLEVEL_OK)
+			stopped = 1;
+	}
+	for (ij = 0; ij < jobs; ij++) {
+		close(fds[ij]);
+		if (stopped)
+			kill(pids[ij], SIGTERM);
+		while (waitpid(pids[ij], NULL, 0) == -1 && errno == EINTR)
+			continue;
+	}
+	free(pids);
+	free(fds);
+	return failed ? -1 : 0;
+}
+
+/*
+ * In a worker process, format every jobs-th file starting at ij.
+ * Collect standard output and standard error output of each file
+ * in temporary files and send them to the parent process on ofd.
+ */
+static void
+jobs_worker(struct mparse *mp, struct manpage *res, size_t ressz,
+    int startdir, struct outstate *outst, struct manconf *conf,
+    int ij, int jobs, int ofd)
+{
+	struct jobrec	 rec;
+	FILE		*tmp[2];
+	size_t		 i;
+
+	if ((tmp[0] = tmpfile()) == NULL || (tmp[1] = tmpfile()) == NULL ||
+	    dup2(fileno(tmp[0]), STDOUT_FILENO) == -1 ||
+	    dup2(fileno(tmp[1]), STDERR_FILENO) == -1)
+		_exit((int)MANDOCLEVEL_SYSERR);
+
+	for (i = ij; i < ressz; i += jobs) {
+		outst->had_output = 0;
+		conf->output.tag_found = 0;
+		process_onefile(mp, res + i, startdir, outst, conf);
+		fflush(stdout);
+
+		memset(&rec, 0, sizeof(rec));
+		rec.errsz = lseek(STDERR_FILENO, 0, SEEK_CUR);
+		rec.outsz = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+		rec.rc = mandoc_msg_getrc();
+		rec.had_output = outst->had_output;
+		rec.tag_found = conf->output.tag_found;
+		if (write(ofd, &rec, sizeof(rec)) != sizeof(rec) ||
+		    lseek(STDERR_FILENO, 0, SEEK_SET) == -1 ||
+		    jobs_copy(STDERR_FILENO, ofd, rec.errsz) == -1 ||
+		    lseek(STDOUT_FILENO, 0, SEEK_SET) == -1 ||
+		    jobs_copy(STDOUT_FILENO, ofd, rec.outsz) == -1 ||
+		    ftruncate(STDERR_FILENO, 0) == -1 ||
+		    ftruncate(STDOUT_FILENO, 0) == -1 ||
+		    lseek(STDERR_FILENO, 0, SEEK_SET) == -1 ||
+		    lseek(STDOUT_FILENO, 0, SEEK_SET) == -1)
+			_exit((int)MANDOCLEVEL_SYSERR);
+	}
+	_exit((int)mandoc_msg_getrc());
+}
+
+/*
+ * Copy exactly sz bytes from ifd to ofd.
+ */
+static int
+jobs_copy(int ifd, int ofd, size_t sz)
+{
+	char		 buf[BUFSIZ];
+	ssize_t		 nr, nw, off;
+
+	while (sz > 0) {
+		nr = read(ifd, buf, sz < sizeof(buf) ? sz : sizeof(buf));
+		if (nr == -1 && errno == EINTR)
+			continue;
+		if (nr <= 0)
+			return -1;
+		sz -= nr;
+		for (off = 0; off < nr; off += nw)
+			if ((nw = write(ofd, buf + off, nr - off)) == -1) {
+				if (errno != EINTR)
+					return -1;
+				nw = 0;
+			}
+	}
+	return 0;
+}
+
 static void
 process_onefile(struct mparse *mp, struct manpage *resp, int startdir,
     struct outstate *outst, struct manconf *conf)
@@ -914,12 +1488,17 @@ process_onefile(struct mparse *mp, struct manpage *resp, int startdir,
 #if HAVE_PLEDGE
 		if ((conf->output.outfilename != NULL ||
 		     conf->output.tagfilename != NULL) &&
-		    pledge("stdio rpath cpath", NULL) == -1) {
+		    pledge(conf->output.cache == NULL ? "stdio rpath cpath" :
+		     "stdio rpath wpath cpath", NULL) == -1) {
 			mandoc_msg(MANDOCERR_PLEDGE, 0, 0,
 			    "%s", strerror(errno));
 			exit(mandoc_msg_getrc());
 		}
 #endif
+		if (outst->tag_files != NULL &&
+		    conf->output.outfilename == NULL &&
+		    conf->output.tagfilename == NULL)
+			pager_early(outst, conf);
 	}
 	if (outst->had_output && outst->outtype <= OUTT_UTF8) {
 		if (outst->outdata == NULL)
@@ -927,7 +1506,13 @@ process_onefile(struct mparse *mp, struct manpage *resp, int startdir,
 		terminal_sepline(outst->outdata);
 	}
 
-	if (resp->form == FORM_SRC)
+	if (conf->output.site != NULL) {
+		if (site_open(conf->output.site, resp->output) == 0) {
+			parse(mp, fd, resp->file, outst, conf);
+			site_close(conf->output.site);
+		} else
+			close(fd);
+	} else if (resp->form == FORM_SRC)
 		parse(mp, fd, resp->file, outst, conf);
 	else {
 		passthrough(fd, conf->output.synopsisonly);
@@ -953,18 +1538,71 @@ parse(struct mparse *mp, int fd, const char *file,
 {
 	static struct manpaths	 basepaths;
 	static int		 previous;
-	struct roff_meta	*meta;
+	struct roff_meta	*meta, *cached;
+	FILE			*lintfp;
+	char			*cachefn, *fingerprint, *lintfn, *tfn;
+	enum mandoclevel	 lintrc;
+	int			 tfd;
 
 	assert(fd >= 0);
 	if (file == NULL)
 		file = "<stdin>";
 
-	if (previous)
-		mparse_reset(mp);
-	else
-		previous = 1;
+	cached = NULL;
+	cachefn = fingerprint = NULL;
+	if (outst->cacheopts != NULL)
+		cachefn = cache_lookup(fd, outst, &conf->output,
+		    &cached, &fingerprint);
+
+	mandoc_xr_reset();
+
+	/*
+	 * With -T lint, replay the messages from the cache, or
+	 * collect them in a temporary file to store them later.
+	 */
+
+	lintfp = NULL;
+	lintfn = NULL;
+	lintrc = MANDOCLEVEL_OK;
+	if (outst->cacheopts != NULL && outst->outtype == OUTT_LINT &&
+	    outst->wstop == 0 && conf->output.tag == NULL) {
+		switch (lint_lookup(fd, file, outst, &conf->output,
+		    &lintfn, &fingerprint)) {
+		case 1:
+			if (fd != STDIN_FILENO)
+				close(fd);
+			goto xr;
+		case 0:
+			mandoc_asprintf(&tfn, "%s/tmp.XXXXXXXXXX",
+			    conf->output.cache);
+			if ((tfd = mkstemp(tfn)) != -1) {
+				unlink(tfn);
+				if ((lintfp = fdopen(tfd, "w+")) == NULL)
+					close(tfd);
+			}
+			free(tfn);
+			if (lintfp != NULL) {
+				mandoc_msg_setoutfile(lintfp);
+				lintrc = mandoc_msg_resetrc();
+			}
+			break;
+		default:
+			break;
+		}
+	}
 
-	mparse_readfd(mp, fd, file);
+	if (cached == NULL) {
+		if (previous)
+			mparse_reset(mp);
+		else
+			previous = 1;
+		if (outst->stream) {
+			if (outst->outdata == NULL)
+				outdata_alloc(outst, &conf->output);
+			outst->had_output = 1;
+		}
+		mparse_readfd(mp, fd, file);
+	}
 	if (fd != STDIN_FILENO)
 		close(fd);
 
@@ -981,8 +1619,22 @@ parse(struct mparse *mp, int fd, const char *file,
 	else if (outst->outtype == OUTT_HTML)
 		html_reset(outst->outdata);
 
-	mandoc_xr_reset();
-	meta = mparse_result(mp);
+	if (cached != NULL)
+		meta = cached;
+	else {
+		meta = mparse_result(mp);
+		if (cachefn != NULL)
+			cache_store(conf->output.cache, cachefn,
+			    meta, fingerprint);
+	}
+	if (lintfp != NULL) {
+		mandoc_msg_setoutfile(stdout);
+		lint_store(lintfn, fingerprint, lintfp, lintrc);
+		fclose(lintfp);
+	}
+	free(cachefn);
+	free(lintfn);
+	free(fingerprint);
 
 	/* Execute the out device, if it exists. */
 
@@ -1003,7 +1655,11 @@ parse(struct mparse *mp, int fd, const char *file,
 		case OUTT_UTF8:
 		case OUTT_LOCALE:
 		case OUTT_PS:
-			terminal_mdoc(outst->outdata, meta);
+			if (outst->stream)
+				terminal_mdoc_stream(outst->outdata,
+				    meta, NULL);
+			else
+				terminal_mdoc(outst->outdata, meta);
 			break;
 		case OUTT_MARKDOWN:
 			markdown_mdoc(outst->outdata, meta);
@@ -1028,7 +1684,11 @@ parse(struct mparse *mp, int fd, const char *file,
 		case OUTT_UTF8:
 		case OUTT_LOCALE:
 		case OUTT_PS:
-			terminal_man(outst->outdata, meta);
+			if (outst->stream)
+				terminal_man_stream(outst->outdata,
+				    meta, NULL);
+			else
+				terminal_man(outst->outdata, meta);
 			break;
 		case OUTT_MARKDOWN:
 			mandoc_msg(MANDOCERR_MAN_TMARKDOWN, 0, 0, NULL);
@@ -1037,6 +1697,8 @@ parse(struct mparse *mp, int fd, const char *file,
 			break;
 		}
 	}
+	mandoc_cache_free(cached);
+xr:
 	if (conf->output.tag != NULL && conf->output.tag_found == 0 &&
 	    tag_exists(conf->output.tag))
 		conf->output.tag_found = 1;
@@ -1049,6 +1711,345 @@ parse(struct mparse *mp, int fd, const char *file,
 		check_xr(&conf->manpath);
 }
 
+/*
+ * If the syntax tree of the file open on fd may be cached,
+ * return the name of the cache file and its fingerprint.
+ * If the cache file is valid, also return the tree it contains.
+ */
+static char *
+cache_lookup(int fd, const struct outstate *outst,
+    const struct manoutput *outconf, struct roff_meta **meta,
+    char **fingerprint)
+{
+	struct stat	 st;
+	char		*cachefn;
+	int		 cfd;
+
+	/*
+	 * Diagnostics and the tag table are only
+	 * generated while actually parsing.
+	 */
+
+	if (outst->wstop || outst->outtype == OUTT_LINT ||
+	    outst->outtype == OUTT_MAN || outconf->tag != NULL ||
+	    mandoc_msg_getmin() < MANDOCERR_BADARG)
+		return NULL;
+
+	if (fstat(fd, &st) == -1 || S_ISREG(st.st_mode) == 0)
+		return NULL;
+
+	mandoc_asprintf(&cachefn, "%s/%llx.%llx", outconf->cache,
+	    (unsigned long long)st.st_dev, (unsigned long long)st.st_ino);
+	mandoc_asprintf(fingerprint, "%lld %lld %s",
+	    (long long)st.st_size, (long long)st.st_mtime,
+	    outst->cacheopts);
+
+	if ((cfd = open(cachefn, O_RDONLY)) != -1) {
+		*meta = mandoc_cache_read(cfd, *fingerprint);
+		close(cfd);
+	}
+	return cachefn;
+}
+
+/*
+ * Failing to write a cache file is not an error:
+ * the page will simply be parsed again next time.
+ */
+static void
+cache_store(const char *dir, const char *cachefn,
+    const struct roff_meta *meta, const char *fingerprint)
+{
+	char	*tfn;
+	int	 cfd;
+
+	mandoc_asprintf(&tfn, "%s/tmp.XXXXXXXXXX", dir);
+	if ((cfd = mkstemp(tfn)) != -1) {
+		if (mandoc_cache_write(cfd, meta, fingerprint) == -1 ||
+		    close(cfd) == -1 || rename(tfn, cachefn) == -1)
+			unlink(tfn);
+	}
+	free(tfn);
+}
+
+/*
+ * Compute a 64-bit FNV-1a hash of everything that can be read from fd.
+ */
+static int
+lint_hash(int fd, uint64_t *hash)
+{
+	unsigned char	 buf[65536];
+	ssize_t		 i, nr;
+
+	*hash = 0xcbf29ce484222325ULL;
+	while ((nr = read(fd, buf, sizeof(buf))) != 0) {
+		if (nr == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		for (i = 0; i < nr; i++) {
+			*hash ^= buf[i];
+			*hash *= 0x100000001b3ULL;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Describe the state of a file included with .so, trying the name
+ * with a .gz suffix as well, just like mparse_open() does.
+ */
+static char *
+lint_dep(const char *name)
+{
+	char		*cp;
+	uint64_t	 hash;
+	int		 fd;
+
+	if ((fd = open(name, O_RDONLY)) == -1) {
+		mandoc_asprintf(&cp, "%s.gz", name);
+		fd = open(cp, O_RDONLY);
+		free(cp);
+	}
+	if (fd == -1)
+		return mandoc_strdup("-");
+	if (lint_hash(fd, &hash) == -1)
+		cp = NULL;
+	else
+		mandoc_asprintf(&cp, "%016llx", (unsigned long long)hash);
+	close(fd);
+	return cp;
+}
+
+/*
+ * Remember the files included with .so while collecting messages.
+ */
+static void
+lint_include(void *arg, const char *name)
+{
+	lint_incs = mandoc_reallocarray(lint_incs,
+	    lint_incsz + 1, sizeof(*lint_incs));
+	lint_incs[lint_incsz++] = mandoc_strdup(name);
+}
+
+/*
+ * Look for the messages about the regular file open on fd
+ * in the -O cache directory.  The file is found by a hash of the
+ * input and of the options, and only used if all files included
+ * with .so are unchanged as well.  Return 1 if the messages were
+ * found and replayed, 0 if they need to be stored in the file
+ * returned in lintfn, or -1 if they cannot be cached.
+ */
+static int
+lint_lookup(int fd, const char *file, const struct outstate *outst,
+    const struct manoutput *outconf, char **lintfn, char **fingerprint)
+{
+	struct stat	 st;
+	struct mandoc_xr *xr;
+	const char	*errstr;
+	char		*buf, *cp, *ep, *dep, *sec;
+	size_t		 i, len, sz;
+	ssize_t		 nr;
+	uint64_t	 hash;
+	int		 cfd, line, pos, count, rc, ok, n;
+
+	for (i = 0; i < lint_incsz; i++)
+		free(lint_incs[i]);
+	lint_incsz = 0;
+
+	if (fstat(fd, &st) == -1 || S_ISREG(st.st_mode) == 0 ||
+	    lint_hash(fd, &hash) == -1 || lseek(fd, 0, SEEK_SET) == -1)
+		return -1;
+
+	mandoc_asprintf(fingerprint, "lint 1 %d %d %s %s %s",
+	    (int)MANDOCERR_MAX, (int)mandoc_msg_getmin(),
+	    outst->cacheopts, getprogname(), file);
+	for (cp = *fingerprint; *cp != '\0'; cp++) {
+		hash ^= (unsigned char)*cp;
+		hash *= 0x100000001b3ULL;
+	}
+	mandoc_asprintf(lintfn, "%s/%016llx.lint", outconf->cache,
+	    (unsigned long long)hash);
+
+	/* Read the whole cache file, if there is one. */
+
+	if ((cfd = open(*lintfn, O_RDONLY)) == -1)
+		return 0;
+	buf = NULL;
+	sz = len = 0;
+	for (;;) {
+		if (len + 1 >= sz) {
+			sz = sz == 0 ? 4096 : sz * 2;
+			buf = mandoc_realloc(buf, sz);
+		}
+		if ((nr = read(cfd, buf + len, sz - len - 1)) <= 0)
+			break;
+		len += nr;
+	}
+	close(cfd);
+	buf[len] = '\0';
+
+	/* Check the fingerprint and all included files. */
+
+	ok = nr == 0 && (ep = strchr(buf, '\n')) != NULL &&
+	    (size_t)(ep - buf) == strlen(*fingerprint) &&
+	    strncmp(buf, *fingerprint, ep - buf) == 0 &&
+	    strncmp(ep + 1, "rc ", 3) == 0 &&
+	    (cp = strchr(ep + 1, '\n')) != NULL;
+	if (ok) {
+		*cp++ = '\0';
+		rc = strtonum(ep + 4, MANDOCLEVEL_OK, MANDOCLEVEL_MAX - 1,
+		    &errstr);
+		ok = errstr == NULL;
+	}
+	while (ok && strncmp(cp, "so ", 3) == 0) {
+		if ((ep = strchr(cp, '\n')) == NULL ||
+		    (sec = memchr(cp + 3, ' ', ep - cp - 3)) == NULL) {
+			ok = 0;
+			break;
+		}
+		*ep = '\0';
+		dep = lint_dep(sec + 1);
+		ok = dep != NULL && (size_t)(sec - cp - 3) == strlen(dep) &&
+		    strncmp(cp + 3, dep, sec - cp - 3) == 0;
+		free(dep);
+		cp = ep + 1;
+	}
+	if (ok == 0) {
+		free(buf);
+		return 0;
+	}
+
+	/*
+	 * Rebuild the list of cross references, such that they
+	 * can be checked against the manuals installed now.
+	 */
+
+	xr = NULL;
+	while (strncmp(cp, "xr ", 3) == 0) {
+		if (sscanf(cp, "xr %d %d %d %zu %n",
+		    &line, &pos, &count, &i, &n) != 4 ||
+		    line < -1 || pos < -1 || count < 1 ||
+		    (ep = strchr(cp, '\n')) == NULL || cp + n > ep)
+			break;
+		*ep = '\0';
+		sec = cp + n;
+		if (strlen(sec) < i + 1)
+			break;
+		sec[i] = '\0';
+		mandoc_xr_add(sec, sec + i + 1, line, pos);
+		for (xr = xr == NULL ? mandoc_xr_get() : xr;
+		     xr->next != NULL; xr = xr->next)
+			continue;
+		xr->count = count;
+		cp = ep + 1;
+	}
+
+	/* Replay the messages. */
+
+	if (strncmp(cp, "msg ", 4) == 0 &&
+	    (ep = strchr(cp, '\n')) != NULL) {
+		*ep = '\0';
+		sz = strtonum(cp + 4, 0, LLONG_MAX, &errstr);
+		ok = errstr == NULL && (size_t)(buf + len - ep - 1) == sz;
+	} else
+		ok = 0;
+	if (ok) {
+		fwrite(ep + 1, 1, sz, stdout);
+		mandoc_msg_setrc((enum mandoclevel)rc);
+		free(buf);
+		free(*lintfn);
+		free(*fingerprint);
+		*lintfn = *fingerprint = NULL;
+		return 1;
+	}
+
+	/* Corrupt file: start over. */
+
+	free(buf);
+	mandoc_xr_reset();
+	return 0;
+}
+
+/*
+ * Copy the messages collected in fp to standard output and store
+ * them in the cache together with their level, the files included
+ * with .so, and the cross references found.  As for the syntax
+ * tree cache, failing to write the file is not an error.
+ */
+static void
+lint_store(const char *lintfn, const char *fingerprint, FILE *fp,
+    enum mandoclevel saverc)
+{
+	struct mandoc_xr *xr;
+	FILE		*cfp;
+	char		**deps, *buf, *tfn;
+	size_t		 i, sz;
+	long		 off;
+	enum mandoclevel rc;
+	int		 cfd, ok;
+
+	rc = mandoc_msg_resetrc();
+	mandoc_msg_setrc(saverc);
+	mandoc_msg_setrc(rc);
+
+	if ((off = ftell(fp)) == -1 || fseek(fp, 0, SEEK_SET) == -1)
+		return;
+	sz = off;
+	buf = mandoc_malloc(sz + 1);
+	if (fread(buf, 1, sz, fp) != sz) {
+		free(buf);
+		return;
+	}
+	fwrite(buf, 1, sz, stdout);
+
+	/*
+	 * An entry lacking any of the included files
+	 * could not detect changes to it, so do not store it.
+	 */
+
+	deps = mandoc_reallocarray(NULL, lint_incsz + 1, sizeof(*deps));
+	for (i = 0; i < lint_incsz; i++)
+		if ((deps[i] = lint_dep(lint_incs[i])) == NULL)
+			break;
+	cfp = NULL;
+	tfn = NULL;
+	if (i == lint_incsz) {
+		mandoc_asprintf(&tfn, "%s.XXXXXXXXXX", lintfn);
+		if ((cfd = mkstemp(tfn)) != -1 &&
+		    (cfp = fdopen(cfd, "w")) == NULL) {
+			close(cfd);
+			unlink(tfn);
+		}
+	}
+	if (cfp == NULL) {
+		while (i-- > 0)
+			free(deps[i]);
+		free(deps);
+		free(tfn);
+		free(buf);
+		return;
+	}
+
+	fprintf(cfp, "%s\nrc %d\n", fingerprint, (int)rc);
+	for (i = 0; i < lint_incsz; i++) {
+		fprintf(cfp, "so %s %s\n", deps[i], lint_incs[i]);
+		free(deps[i]);
+	}
+	free(deps);
+	for (xr = mandoc_xr_get(); xr != NULL; xr = xr->next)
+		fprintf(cfp, "xr %d %d %d %zu %s %s\n", xr->line, xr->pos,
+		    xr->count, strlen(xr->sec), xr->sec, xr->name);
+	fprintf(cfp, "msg %zu\n", sz);
+	fwrite(buf, 1, sz, cfp);
+	free(buf);
+
+	ok = ferror(cfp) == 0;
+	if (fclose(cfp) == EOF || ok == 0 || rename(tfn, lintfn) == -1)
+		unlink(tfn);
+	free(tfn);
+}
+
 static void
 check_xr(struct manpaths *paths)
 {
@@ -1078,12 +2079,525 @@ check_xr(struct manpaths *paths)
 	}
 }
 
+/*
+ * Add the manual pages in the directory dir of the manual tree
+ * paths->paths[ipath] to the -O site, descending into the manN
+ * section directories and into their architecture subdirectories.
+ * The name of dir relative to the tree is rel, or NULL for the tree.
+ * Pages in a directory are added before those in its subdirectories,
+ * such that links prefer machine-independent pages.
+ */
+static void
+site_scan(const struct manpaths *paths, size_t ipath, const char *dir,
+    const char *rel, int depth, struct manpage **res, size_t *ressz)
+{
+	struct stat	 sb;
+	struct fs_dir	*listing;
+	size_t		*subdirs;
+	char		*path, *file;
+	size_t		 i, isub, subsz;
+
+	listing = fs_dir_get(dir);
+	subdirs = NULL;
+	subsz = 0;
+	for (i = 0; i < listing->entsz; i++) {
+		if (listing->ents[i][0] == '.' || (depth == 0 &&
+		    strncmp(listing->ents[i], "man", 3) != 0))
+			continue;
+		mandoc_asprintf(&path, "%s/%s", dir, listing->ents[i]);
+		if (stat(path, &sb) == 0) {
+			if (depth > 0 && S_ISREG(sb.st_mode)) {
+				mandoc_asprintf(&file, "%s/%s",
+				    rel, listing->ents[i]);
+				site_add(ipath, file, res, ressz);
+			} else if (depth < 2 && S_ISDIR(sb.st_mode)) {
+				subdirs = mandoc_reallocarray(subdirs,
+				    subsz + 1, sizeof(*subdirs));
+				subdirs[subsz++] = i;
+			}
+		}
+		free(path);
+	}
+	for (isub = 0; isub < subsz; isub++) {
+		i = subdirs[isub];
+		mandoc_asprintf(&path, "%s/%s", dir, listing->ents[i]);
+		if (rel == NULL)
+			file = mandoc_strdup(listing->ents[i]);
+		else
+			mandoc_asprintf(&file, "%s/%s", rel, listing->ents[i]);
+		site_scan(paths, ipath, path, file, depth + 1, res, ressz);
+		free(file);
+		free(path);
+	}
+	free(subdirs);
+}
+
+/*
+ * Add the manual page file to the list of pages to format
+ * and remember where to find its output for links from other pages.
+ * The same file in a later manual tree is ignored.
+ */
+static void
+site_add(size_t ipath, char *file, struct manpage **res, size_t *ressz)
+{
+	struct site_page	*page;
+	const char		*base, *end, *sec, *cp;
+	char			*output;
+	unsigned int		 slot;
+
+	base = strrchr(file, '/') + 1;
+	end = strchr(base, '\0');
+	if (end - base > 3 && strcmp(end - 3, ".gz") == 0)
+		end -= 3;
+
+	/* The section is the last suffix of the file name. */
+
+	sec = NULL;
+	for (cp = base + 1; cp < end; cp++)
+		if (*cp == '.')
+			sec = cp + 1;
+	if (sec == NULL || sec == end) {
+		free(file);
+		return;
+	}
+
+	if (site_pages == NULL) {
+		site_pages = mandoc_malloc(sizeof(*site_pages));
+		mandoc_ohash_init(site_pages, 6,
+		    offsetof(struct site_page, name));
+	}
+	slot = ohash_qlookupi(site_pages, base, &end);
+	mandoc_asprintf(&output, "%.*s.html", (int)(end - file), file);
+	if ((page = ohash_find(site_pages, slot)) != NULL &&
+	    strcmp(page->path, output) == 0) {
+		free(output);
+		free(file);
+		return;
+	}
+	fs_append(&file, 1, 0, ipath, sec, FORM_SRC, res, ressz);
+	(*res)[*ressz - 1].output = output;
+	if (page == NULL) {
+		page = mandoc_malloc(sizeof(*page) + (end - base) + 1);
+		page->path = output;
+		memcpy(page->name, base, end - base);
+		page->name[end - base] = '\0';
+		ohash_insert(site_pages, slot, page);
+	}
+}
+
+/*
+ * Decide which pages of the -O site need to be formatted and move
+ * them to the beginning of res, returning their number.
+ * A page is formatted if its source is newer than its output.
+ * If the set of pages or the output options changed since the
+ * last run, as recorded in the state file, all pages are formatted
+ * because links may have changed, and the output of pages that
+ * were removed is deleted.
+ */
+static size_t
+site_plan(const struct manconf *conf, const char *options,
+    struct manpage *res, size_t ressz)
+{
+	struct stat	 sbin, sbout;
+	struct manpage	 swap;
+	char		*cp, *fn, *old;
+	size_t		 i, len, oldsz, sz, procsz;
+	ssize_t		 nr;
+	int		 fd, full, stale;
+
+	sz = strlen(options) + 1;
+	for (i = 0; i < ressz; i++)
+		sz += strlen(res[i].output) + 1;
+	cp = site_state = mandoc_malloc(sz + 1);
+	len = strlen(options);
+	memcpy(cp, options, len);
+	cp += len;
+	*cp++ = '\n';
+	for (i = 0; i < ressz; i++) {
+		len = strlen(res[i].output);
+		memcpy(cp, res[i].output, len);
+		cp += len;
+		*cp++ = '\n';
+	}
+	*cp = '\0';
+
+	full = 1;
+	old = NULL;
+	mandoc_asprintf(&fn, "%s/.mandoc_site", conf->output.site);
+	if ((fd = open(fn, O_RDONLY)) != -1) {
+		if (fstat(fd, &sbin) != -1 && sbin.st_size > 0 &&
+		    sbin.st_size < SSIZE_MAX) {
+			oldsz = sbin.st_size;
+			old = mandoc_malloc(oldsz + 1);
+			if ((nr = read(fd, old, oldsz)) == -1 ||
+			    (size_t)nr != oldsz) {
+				free(old);
+				old = NULL;
+			} else {
+				old[oldsz] = '\0';
+				if (oldsz == sz &&
+				    memcmp(old, site_state, sz) == 0)
+					full = 0;
+			}
+		}
+		close(fd);
+	}
+	free(fn);
+	if (old != NULL) {
+		if (full)
+			site_prune(conf->output.site, old, res, ressz);
+		free(old);
+	}
+
+	procsz = 0;
+	for (i = 0; i < ressz; i++) {
+		stale = full;
+		if (stale == 0) {
+			mandoc_asprintf(&fn, "%s/%s",
+			    conf->manpath.paths[res[i].ipath], res[i].file);
+			mandoc_asprintf(&cp, "%s/%s",
+			    conf->output.site, res[i].output);
+			stale = stat(fn, &sbin) == -1 ||
+			    stat(cp, &sbout) == -1 ||
+			    sbout.st_mtime <= sbin.st_mtime;
+			free(fn);
+			free(cp);
+		}
+		if (stale == 0)
+			continue;
+		if (i > procsz) {
+			swap = res[procsz];
+			res[procsz] = res[i];
+			res[i] = swap;
+		}
+		procsz++;
+	}
+	return procsz;
+}
+
+/*
+ * Delete the output of the pages listed in the old state file
+ * that are no longer part of the -O site, together with
+ * directories left empty and indexes of sections left empty.
+ */
+static void
+site_prune(const char *site, char *old,
+    const struct manpage *res, size_t ressz)
+{
+	struct ohash	 gone;
+	char		*line, *next, *fn, *rel, *cp;
+	size_t		 i, secsz;
+	unsigned int	 slot;
+
+	/* Skip the options on the first line. */
+
+	if ((line = strchr(old, '\n')) == NULL)
+		return;
+
+	mandoc_ohash_init(&gone, 6, 0);
+	for (line++; (next = strchr(line, '\n')) != NULL; line = next) {
+		*next++ = '\0';
+		if (*line == '\0' || *line == '/' ||
+		    strstr(line, "..") != NULL)
+			continue;
+		slot = ohash_qlookup(&gone, line);
+		if (ohash_find(&gone, slot) == NULL)
+			ohash_insert(&gone, slot, line);
+	}
+	for (i = 0; i < ressz; i++) {
+		slot = ohash_qlookup(&gone, res[i].output);
+		if (ohash_find(&gone, slot) != NULL)
+			ohash_remove(&gone, slot);
+	}
+
+	for (line = ohash_first(&gone, &slot); line != NULL;
+	     line = ohash_next(&gone, &slot)) {
+		mandoc_asprintf(&fn, "%s/%s", site, line);
+		rel = fn + strlen(site) + 1;
+		if (unlink(fn) == -1) {
+			free(fn);
+			continue;
+		}
+		while ((cp = strrchr(rel, '/')) != NULL) {
+			*cp = '\0';
+			if (strchr(rel, '/') == NULL) {
+				secsz = cp - rel;
+				for (i = 0; i < ressz; i++)
+					if (strncmp(res[i].output, rel,
+					    secsz) == 0 &&
+					    res[i].output[secsz] == '/')
+						break;
+				if (i == ressz) {
+					mandoc_asprintf(&cp,
+					    "%s/index.html", fn);
+					unlink(cp);
+					free(cp);
+				}
+			}
+			if (rmdir(fn) == -1)
+				break;
+		}
+		free(fn);
+	}
+	ohash_delete(&gone);
+}
+
+/*
+ * Redirect standard output to a temporary file that will replace
+ * the file path below the directory site when closed.
+ */
+static int
+site_open(const char *site, const char *path)
+{
+	char	*cp;
+	int	 fd;
+
+	/* Create missing directories. */
+
+	mandoc_asprintf(&site_tmp, "%s/%s.%d", site, path, (int)getpid());
+	cp = site_tmp + strlen(site) + 1;
+	while ((cp = strchr(cp, '/')) != NULL) {
+		*cp = '\0';
+		if (mkdir(site_tmp, 0755) == -1 && errno != EEXIST) {
+			mandoc_msg(MANDOCERR_OPEN, 0, 0, "%s: %s",
+			    site_tmp, strerror(errno));
+			free(site_tmp);
+			return -1;
+		}
+		*cp++ = '/';
+	}
+
+	if ((fd = open(site_tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+		mandoc_msg(MANDOCERR_OPEN, 0, 0, "%s: %s",
+		    site_tmp, strerror(errno));
+		free(site_tmp);
+		return -1;
+	}
+	fflush(stdout);
+	if ((site_stdout = dup(STDOUT_FILENO)) == -1 ||
+	    dup2(fd, STDOUT_FILENO) == -1) {
+		mandoc_msg(MANDOCERR_DUP, 0, 0, "%s", strerror(errno));
+		if (site_stdout != -1)
+			close(site_stdout);
+		close(fd);
+		unlink(site_tmp);
+		free(site_tmp);
+		return -1;
+	}
+	close(fd);
+	site_cur = path;
+	return 0;
+}
+
+/*
+ * Restore standard output and move the file written into place,
+ * unless writing it failed or nothing was written.
+ */
+static int
+site_close(const char *site)
+{
+	char	*fn;
+	int	 irc;
+
+	irc = 0;
+	if (fflush(stdout) != 0 || ferror(stdout)) {
+		mandoc_msg(MANDOCERR_WRITE, 0, 0, "%s: %s",
+		    site_tmp, strerror(errno));
+		irc = -1;
+	} else if (lseek(STDOUT_FILENO, 0, SEEK_CUR) == 0)
+		irc = -1;
+	dup2(site_stdout, STDOUT_FILENO);
+	close(site_stdout);
+	site_stdout = -1;
+	clearerr(stdout);
+
+	mandoc_asprintf(&fn, "%s/%s", site, site_cur);
+	if (irc == 0 && rename(site_tmp, fn) == -1) {
+		mandoc_msg(MANDOCERR_WRITE, 0, 0, "%s: %s",
+		    fn, strerror(errno));
+		irc = -1;
+	}
+	if (irc == -1)
+		unlink(site_tmp);
+	free(fn);
+	free(site_tmp);
+	site_tmp = NULL;
+	site_cur = NULL;
+	return irc;
+}
+
+/*
+ * Return the relative URI from the page being written
+ * to the page name(sec), or NULL if the site lacks that page.
+ */
+static const char *
+site_href(const char *name, const char *sec)
+{
+	static char		*href;
+	struct site_page	*page;
+	const char		*cp;
+	char			*key, *ep;
+
+	mandoc_asprintf(&key, "%s.%s", name, sec == NULL ? "1" : sec);
+	page = ohash_find(site_pages, ohash_qlookup(site_pages, key));
+	free(key);
+	if (page == NULL || site_cur == NULL)
+		return NULL;
+
+	free(href);
+	href = ep = mandoc_malloc(strlen(site_cur) * 3 +
+	    strlen(page->path) + 1);
+	for (cp = site_cur; (cp = strchr(cp, '/')) != NULL; cp++) {
+		memcpy(ep, "../", 3);
+		ep += 3;
+	}
+	strcpy(ep, page->path);
+	return href;
+}
+
+/*
+ * Sort the pages of the -O site by section directory,
+ * by file name, and by architecture.
+ */
+static int
+site_cmp(const void *a, const void *b)
+{
+	const char	*pa, *pb;
+	size_t		 sza, szb;
+	int		 irc;
+
+	pa = (*(const struct manpage *const *)a)->output;
+	pb = (*(const struct manpage *const *)b)->output;
+	sza = strcspn(pa, "/");
+	szb = strcspn(pb, "/");
+	if ((irc = strncmp(pa, pb, sza < szb ? sza : szb)) != 0)
+		return irc;
+	if (sza != szb)
+		return sza < szb ? -1 : 1;
+	if ((irc = strcmp(strrchr(pa, '/'), strrchr(pb, '/'))) != 0)
+		return irc;
+	return strcmp(pa, pb);
+}
+
+/*
+ * Write an index for each section of the -O site,
+ * an index of the sections, and the state file.
+ */
+static void
+site_index(struct outstate *outst, struct manconf *conf,
+    struct manpage *res, size_t ressz)
+{
+	struct manpage	**pages;
+	char		**labels, **hrefs, **secs;
+	const char	 *base, *arch, *ep, *sec;
+	char		 *title;
+	size_t		  i, j, k, nsec, secsz, namesz;
+
+	if (outst->outdata == NULL)
+		outdata_alloc(outst, &conf->output);
+
+	pages = mandoc_reallocarray(NULL, ressz, sizeof(*pages));
+	for (i = 0; i < ressz; i++)
+		pages[i] = res + i;
+	qsort(pages, ressz, sizeof(*pages), site_cmp);
+	labels = mandoc_reallocarray(NULL, ressz + 1, sizeof(*labels));
+	hrefs = mandoc_reallocarray(NULL, ressz + 1, sizeof(*hrefs));
+	secs = mandoc_reallocarray(NULL, ressz + 1, sizeof(*secs));
+
+	/* One index for each section directory, like man1/index.html. */
+
+	nsec = 0;
+	for (i = 0; i < ressz; i = j) {
+		secsz = strcspn(pages[i]->output, "/");
+		for (j = i; j < ressz; j++) {
+			if (strncmp(pages[j]->output, pages[i]->output,
+			    secsz + 1) != 0)
+				break;
+			arch = pages[j]->output + secsz + 1;
+			base = strrchr(arch, '/');
+			base = base == NULL ? arch : base + 1;
+			ep = strrchr(base, '.');	/* ".html" */
+			for (sec = ep; sec[-1] != '.'; sec--)
+				continue;
+			namesz = sec - base - 1;
+			if (arch == base)
+				mandoc_asprintf(labels + j - i, "%.*s(%.*s)",
+				    (int)namesz, base, (int)(ep - sec), sec);
+			else
+				mandoc_asprintf(labels + j - i,
+				    "%.*s(%.*s) (%.*s)", (int)namesz, base,
+				    (int)(ep - sec), sec,
+				    (int)(base - arch - 1), arch);
+			hrefs[j - i] = (char *)arch;
+		}
+		mandoc_asprintf(&title, "Section %.*s",
+		    (int)secsz - 3, pages[i]->output + 3);
+		mandoc_asprintf(secs + nsec, "%.*s/index.html",
+		    (int)secsz, pages[i]->output);
+		if (site_open(conf->output.site, secs[nsec]) == 0) {
+			html_reset(outst->outdata);
+			html_index(outst->outdata, title,
+			    labels, hrefs, j - i);
+			site_close(conf->output.site);
+		}
+		nsec++;
+		free(title);
+		for (k = 0; k < j - i; k++)
+			free(labels[k]);
+	}
+
+	/* The index of the sections. */
+
+	for (k = 0; k < nsec; k++)
+		mandoc_asprintf(labels + k, "Section %.*s",
+		    (int)strcspn(secs[k], "/") - 3, secs[k] + 3);
+	if (site_open(conf->output.site, "index.html") == 0) {
+		html_reset(outst->outdata);
+		html_index(outst->outdata, "Manual pages",
+		    labels, secs, nsec);
+		site_close(conf->output.site);
+	}
+	for (k = 0; k < nsec; k++) {
+		free(labels[k]);
+		free(secs[k]);
+	}
+	free(pages);
+	free(labels);
+	free(hrefs);
+	free(secs);
+
+	if (site_open(conf->output.site, ".mandoc_site") == 0) {
+		fputs(site_state, stdout);
+		site_close(conf->output.site);
+	}
+}
+
+static void
+site_free(void)
+{
+	struct site_page	*page;
+	unsigned int		 slot;
+
+	if (site_pages != NULL) {
+		for (page = ohash_first(site_pages, &slot); page != NULL;
+		     page = ohash_next(site_pages, &slot))
+			free(page);
+		ohash_delete(site_pages);
+		free(site_pages);
+		site_pages = NULL;
+	}
+	free(site_state);
+	site_state = NULL;
+}
+
 static void
 outdata_alloc(struct outstate *outst, struct manoutput *outconf)
 {
 	switch (outst->outtype) {
 	case OUTT_HTML:
 		outst->outdata = html_alloc(outconf);
+		if (outconf->site != NULL)
+			html_site(outst->outdata, site_href);
 		break;
 	case OUTT_UTF8:
 		outst->outdata = utf8_alloc(outconf);
@@ -1100,6 +2614,12 @@ outdata_alloc(struct outstate *outst, struct manoutput *outconf)
 	case OUTT_PS:
 		outst->outdata = ps_alloc(outconf);
 		break;
+	case OUTT_TREE:
+	case OUTT_MAN:
+	case OUTT_MARKDOWN:
+		/* These keep no state, they only need the stream. */
+		outst->outdata = outconf->outfp;
+		break;
 	default:
 		break;
 	}
@@ -1226,6 +2746,114 @@ woptions(char *arg, enum mandoc_os *os_e, int *wstop)
 	return 0;
 }
 
+/*
+ * Formatting a long manual page can take a noticeable time,
+ * so if the pager can cope with an output file that is still
+ * growing, do not wait for the formatter to finish.
+ * Fork: the child process formats and returns from this function,
+ * the parent process waits until the child wrote the first screen,
+ * runs the pager, waits for the child to finish, and exits.
+ * Messages of the child are collected in a temporary file
+ * and shown after the pager exits, such that they do not
+ * garble the screen while the pager is running.
+ */
+static void
+pager_early(struct outstate *outst, struct manconf *conf)
+{
+	struct winsize	 ws;
+	FILE		*msgfp;
+	const char	*pager;
+	char		*tag;
+	size_t		 len;
+	ssize_t		 nr;
+	pid_t		 child_pid;
+	int		 fds[2], status;
+	char		 buf[2], msgbuf[BUFSIZ];
+
+	if (outst->outtype != OUTT_ASCII &&
+	    outst->outtype != OUTT_UTF8 &&
+	    outst->outtype != OUTT_LOCALE)
+		return;
+
+	/* Only less(1) is known to display data appended later. */
+
+	pager = pager_cmd();
+	len = strcspn(pager, " ");
+	if (len < 4 || strncmp(pager + len - 4, "less", 4) != 0)
+		return;
+
+	if (ioctl(outst->tag_files->ofd, TIOCGWINSZ, &ws) == -1 ||
+	    ws.ws_row == 0)
+		ws.ws_row = 24;
+	if ((msgfp = tmpfile()) == NULL)
+		return;
+	if (pipe(fds) == -1) {
+		fclose(msgfp);
+		return;
+	}
+	fflush(stdout);
+	fflush(stderr);
+
+	switch (child_pid = fork()) {
+	case -1:
+		mandoc_msg(MANDOCERR_FORK, 0, 0, "%s", strerror(errno));
+		close(fds[0]);
+		close(fds[1]);
+		fclose(msgfp);
+		return;
+	case 0:
+		close(fds[0]);
+		setvbuf(msgfp, NULL, _IOLBF, 0);
+		mandoc_msg_setoutfile(msgfp);
+		term_tag_early(fds[1], conf->output.tag, ws.ws_row);
+		outst->early = 1;
+		return;
+	default:
+		break;
+	}
+
+	/* Wait until the child is ready or gone. */
+
+	close(fds[1]);
+	tag = conf->output.tag;
+	if (term_tag_close() != -1) {
+		while ((nr = read(fds[0], buf, sizeof(buf))) == -1 &&
+		    errno == EINTR)
+			continue;
+		if (nr == sizeof(buf)) {
+			if (buf[0] == 'n')
+				tag = NULL;
+			mandoc_msg_setrc((enum mandoclevel)buf[1]);
+		}
+		run_pager(outst, tag);
+	}
+	close(fds[0]);
+
+	/*
+	 * Once the user closed the pager, the rest of the
+	 * output is no longer needed.  Use the exit status
+	 * of the child if it completed before that.
+	 */
+
+	kill(child_pid, SIGKILL);
+	while (waitpid(child_pid, &status, 0) == -1)
+		if (errno != EINTR) {
+			status = 0;
+			break;
+		}
+	if (WIFEXITED(status))
+		mandoc_msg_setrc(WEXITSTATUS(status));
+	term_tag_unlink();
+
+	/* Now that the pager is gone, show the messages. */
+
+	rewind(msgfp);
+	while ((len = fread(msgbuf, 1, sizeof(msgbuf), msgfp)) > 0)
+		fwrite(msgbuf, 1, len, stderr);
+	fclose(msgfp);
+	exit(mandoc_msg_getrc());
+}
+
 /*
  * Wait until moved to the foreground,
  * then fork the pager and wait for the user to close it.
@@ -1284,6 +2912,19 @@ run_pager(struct outstate *outst, char *tag_target)
 	}
 }
 
+static const char *
+pager_cmd(void)
+{
+	const char	*pager;
+
+	pager = getenv("MANPAGER");
+	if (pager == NULL || *pager == '\0')
+		pager = getenv("PAGER");
+	if (pager == NULL || *pager == '\0')
+		pager = BINM_PAGER;
+	return pager;
+}
+
 static pid_t
 spawn_pager(struct outstate *outst, char *tag_target)
 {
@@ -1302,11 +2943,7 @@ spawn_pager(struct outstate *outst, char *tag_target)
 	assert(outst->tag_files->ofd == -1);
 	assert(outst->tag_files->tfs == NULL);
 
-	pager = getenv("MANPAGER");
-	if (pager == NULL || *pager == '\0')
-		pager = getenv("PAGER");
-	if (pager == NULL || *pager == '\0')
-		pager = BINM_PAGER;
+	pager = pager_cmd();
 
 	/*
 	 * Parse the pager command into words.
@@ -1384,3 +3021,19 @@ spawn_pager(struct outstate *outst, char *tag_target)
 	mandoc_msg(MANDOCERR_EXEC, 0, 0, "%s: %s", argv[0], strerror(errno));
 	_exit(mandoc_msg_getrc());
 }
+
+/*
+ * Called by the parser for each top level node as soon as it
+ * is complete and validated.
+ */
+static void
+stream_node(void *arg, const struct roff_meta *meta, struct roff_node *n)
+{
+	struct outstate	*outst;
+
+	outst = arg;
+	if (meta->macroset == MACROSET_MDOC)
+		terminal_mdoc_stream(outst->outdata, meta, n);
+	else
+		terminal_man_stream(outst->outdata, meta, n);
+}
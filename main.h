@@ -17,6 +17,7 @@
  */
 
 struct	roff_meta;
+struct	roff_node;
 struct	manoutput;
 
 /*
@@ -24,6 +25,9 @@ struct	manoutput;
  * and -Tascii.  Note that ascii_alloc() is named as such in
  * anticipation of latin1_alloc() and so on, all of which map into the
  * terminal output routines with different character settings.
+ * All of them write to the stream given in the manoutput structure,
+ * or to stdout if it is NULL; the tree, man, and markdown printers
+ * take that stream as their first argument instead.
  */
 
 void		 *html_alloc(const struct manoutput *);
@@ -31,6 +35,9 @@ void		  html_mdoc(void *, const struct roff_meta *);
 void		  html_man(void *, const struct roff_meta *);
 void		  html_reset(void *);
 void		  html_free(void *);
+void		  html_index(void *, const char *, char **, char **, size_t);
+void		  html_site(void *,
+			const char *(*)(const char *, const char *));
 
 void		  tree_mdoc(void *, const struct roff_meta *);
 void		  tree_man(void *, const struct roff_meta *);
@@ -47,7 +54,11 @@ void		 *ps_alloc(const struct manoutput *);
 void		  pspdf_free(void *);
 
 void		  terminal_mdoc(void *, const struct roff_meta *);
+void		  terminal_mdoc_stream(void *, const struct roff_meta *,
+			struct roff_node *);
 void		  terminal_man(void *, const struct roff_meta *);
+void		  terminal_man_stream(void *, const struct roff_meta *,
+			struct roff_node *);
 void		  terminal_sepline(void *);
 
 void		  markdown_mdoc(void *, const struct roff_meta *);
@@ -540,7 +540,8 @@ man_MR_pre(MAN_ARGS)
 		}
 	}
 
-	if (name != NULL && section != NULL && h->base_man1 != NULL)
+	if (name != NULL && section != NULL &&
+	    html_manlink(h, name, section))
 		t = print_otag(h, TAG_A, "chM?", "Xr",
 		    name, section, "aria-label", label);
 	else
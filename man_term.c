@@ -60,6 +60,7 @@ struct	man_term_act {
 #define	MAN_NOTEXT	 (1 << 0) /* Never has text children. */
 };
 
+static	void		  man_term_setup(struct termp *, struct mtermp *);
 static	void		  print_man_nodelist(DECL_ARGS);
 static	void		  print_man_node(DECL_ARGS);
 static	void		  print_man_head(struct termp *,
@@ -154,45 +155,77 @@ terminal_man(void *arg, const struct roff_meta *man)
 	struct termp		*p;
 	struct roff_node	*n, *nc, *nn;
 
+	n = man->first->child;
 	p = (struct termp *)arg;
-	p->tcol->rmargin = p->maxrmargin = p->defrmargin;
-	term_tab_set(p, NULL);
-	term_tab_set(p, "T");
-	term_tab_set(p, ".5i");
+	if (p->synopsisonly == 0) {
+		for (; n != NULL; n = n->next)
+			terminal_man_stream(arg, man, n);
+		terminal_man_stream(arg, man, NULL);
+		return;
+	}
 
-	memset(&mt, 0, sizeof(mt));
-	mt.lmargin[mt.lmargincur] = term_len(p, 7);
-	mt.offset = term_len(p, p->defindent);
-	mt.pardist = 1;
+	man_term_setup(p, &mt);
+	for (nn = NULL; n != NULL; n = n->next) {
+		if (n->tok != MAN_SH)
+			continue;
+		nc = n->child->child;
+		if (nc->type != ROFFT_TEXT)
+			continue;
+		if (strcmp(nc->string, "SYNOPSIS") == 0)
+			break;
+		if (nn == NULL && strcmp(nc->string, "NAME") == 0)
+			nn = n;
+	}
+	if (n == NULL)
+		n = nn;
+	p->flags |= TERMP_NOSPACE;
+	if (n != NULL && (n = n->child->next->child) != NULL)
+		print_man_nodelist(p, &mt, n, man);
+	term_newln(p);
+}
 
-	n = man->first->child;
-	if (p->synopsisonly) {
-		for (nn = NULL; n != NULL; n = n->next) {
-			if (n->tok != MAN_SH)
-				continue;
-			nc = n->child->child;
-			if (nc->type != ROFFT_TEXT)
-				continue;
-			if (strcmp(nc->string, "SYNOPSIS") == 0)
-				break;
-			if (nn == NULL && strcmp(nc->string, "NAME") == 0)
-				nn = n;
-		}
-		if (n == NULL)
-			n = nn;
-		p->flags |= TERMP_NOSPACE;
-		if (n != NULL && (n = n->child->next->child) != NULL)
-			print_man_nodelist(p, &mt, n, man);
-		term_newln(p);
-	} else {
+/*
+ * Format one top level node of the document, printing the page
+ * header before the first one, or finish the document if n is NULL.
+ * This allows formatting to start before parsing is complete.
+ */
+void
+terminal_man_stream(void *arg, const struct roff_meta *man,
+    struct roff_node *n)
+{
+	struct termp		*p;
+
+	p = (struct termp *)arg;
+	if (p->docstate == 0) {
+		if (p->mt == NULL)
+			p->mt = mandoc_malloc(sizeof(*p->mt));
+		man_term_setup(p, p->mt);
 		term_begin(p, print_man_head, print_man_foot, man);
 		p->flags |= TERMP_NOSPACE;
-		if (n != NULL)
-			print_man_nodelist(p, &mt, n, man);
+		p->docstate = 1;
+	}
+	if (n != NULL)
+		print_man_node(p, p->mt, n, man);
+	else {
 		term_end(p);
+		p->docstate = 0;
 	}
 }
 
+static void
+man_term_setup(struct termp *p, struct mtermp *mt)
+{
+	p->tcol->rmargin = p->maxrmargin = p->defrmargin;
+	term_tab_set(p, NULL);
+	term_tab_set(p, "T");
+	term_tab_set(p, ".5i");
+
+	memset(mt, 0, sizeof(*mt));
+	mt->lmargin[mt->lmargincur] = term_len(p, 7);
+	mt->offset = term_len(p, p->defindent);
+	mt->pardist = 1;
+}
+
 /*
  * Printing leading vertical space before a block.
  * This is used for the paragraph macros.
@@ -121,7 +121,8 @@ man_validate(struct roff_man *man)
 	n = man->last;
 	man->last = man->last->child;
 	while (man->last != NULL) {
-		man_validate(man);
+		if ((man->last->flags & NODE_CHECKED) == 0)
+			man_validate(man);
 		if (man->last == n)
 			man->last = man->last->child;
 		else
@@ -29,18 +29,23 @@ struct	manpaths {
 /* Data from -O options and man.conf(5) output directives. */
 
 struct	manoutput {
+	FILE	 *outfp;  /* Where formatters write, NULL for stdout. */
+	char	 *cache;
 	char	 *includes;
 	char	 *man;
 	char	 *outfilename;
 	char	 *paper;
+	char	 *site;
 	char	 *style;
 	char	 *tag;
 	char	 *tagfilename;
 	size_t	  indent;
 	size_t	  width;
+	int	  compress;
 	int	  fragment;
 	int	  mdoc;
 	int	  noval;
+	int	  stream;
 	int	  synopsisonly;
 	int	  tag_found;
 	int	  toc;
@@ -279,11 +279,11 @@ enum	mandocerr {
 	MANDOCERR_FORK,
 	MANDOCERR_FSTAT,
 	MANDOCERR_GETLINE,
-	MANDOCERR_GLOB,
 	MANDOCERR_GZCLOSE,
 	MANDOCERR_GZDOPEN,
 	MANDOCERR_MKSTEMP,
 	MANDOCERR_OPEN,
+	MANDOCERR_OPENDIR,
 	MANDOCERR_PLEDGE,
 	MANDOCERR_READ,
 	MANDOCERR_WAIT,
@@ -329,6 +329,8 @@ enum mandocerr	  mandoc_msg_getmin(void);
 void		  mandoc_msg_setmin(enum mandocerr);
 enum mandoclevel  mandoc_msg_getrc(void);
 void		  mandoc_msg_setrc(enum mandoclevel);
+enum mandoclevel  mandoc_msg_resetrc(void);
+unsigned long	  mandoc_msg_getcount(void);
 void		  mandoc_msg(enum mandocerr, int, int, const char *, ...)
 			__attribute__((__format__ (__printf__, 4, 5)));
 void		  mandoc_msg_summary(void);
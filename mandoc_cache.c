@@ -0,0 +1,1054 @@
+/* $Id$ */
+/*
+ * Copyright (c) 2026 The mandoc developers
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Writing validated syntax trees to cache files and reading them back.
+ * The interface is defined in "mandoc_cache.h".
+ *
+ * The file format is private to the mandoc version writing it:
+ * integers are stored in native byte order, strings as their length
+ * followed by their bytes, and pointers as indices into the arrays
+ * of nodes, layout rows, layout cells, and data rows.
+ * Nodes are stored in preorder, such that the parent index
+ * suffices to rebuild the tree.
+ */
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mandoc_aux.h"
+#include "mandoc.h"
+#include "roff.h"
+#include "mdoc.h"
+#include "tbl.h"
+#include "eqn.h"
+#include "roff_int.h"
+#include "mandoc_cache.h"
+
+#define	CACHE_MAGIC	0x6d636331	/* "mcc1" */
+#define	CACHE_VERSION	1
+#define	CACHE_EQNDEPTH	256		/* Maximum eqn(7) box nesting. */
+
+/*
+ * Map from the address of a node, a normalized argument structure,
+ * a layout row, a layout cell, or a data row to its index.
+ * All these objects are allocated separately,
+ * so one map can hold all of them at the same time.
+ */
+struct	cache_ptr {
+	const void	 *p;
+	int32_t		  i;
+};
+
+struct	cache_out {
+	char		 *buf;      /* File contents being assembled. */
+	size_t		  len;      /* Bytes used in buf. */
+	size_t		  sz;       /* Bytes allocated for buf. */
+	const struct roff_node **nodes; /* All nodes in preorder. */
+	const struct tbl_span **tbls;   /* First data row of each table. */
+	struct cache_ptr *ptrs;     /* Sorted address map. */
+	int32_t		  nodesz;
+	int32_t		  nodemax;
+	int32_t		  tblsz;
+	int32_t		  ptrsz;
+	int32_t		  ptrmax;
+	int32_t		  rowsz;
+	int32_t		  cellsz;
+	int32_t		  spansz;
+	int		  fail;     /* The tree cannot be stored. */
+};
+
+struct	cache_in {
+	const char	 *cp;       /* Next byte to read. */
+	const char	 *end;      /* End of the file contents. */
+	int32_t		  rowmax;   /* Total number of layout rows. */
+	int32_t		  cellmax;  /* Total number of layout cells. */
+	int32_t		  spanmax;  /* Total number of data rows. */
+	int		  bad;      /* The file is truncated or corrupt. */
+};
+
+/*
+ * Pointers stored as indices, kept until all nodes exist.
+ */
+struct	cache_link {
+	int32_t		  parent;
+	int32_t		  head;
+	int32_t		  body;
+	int32_t		  tail;
+	int32_t		  norm;     /* Owner of shared normalized data. */
+	int32_t		  es;       /* For En blocks: the Es node. */
+};
+
+/*
+ * The meta data must be the first member such that the pointer
+ * handed out by mandoc_cache_read() can be passed back to
+ * mandoc_cache_free().  The counts only include objects already
+ * allocated, such that a partially read tree can be freed.
+ */
+struct	cache_meta {
+	struct roff_meta  meta;
+	struct roff_node **nodes;   /* All nodes in preorder. */
+	struct tbl_opts	 *opts;     /* Options of all tables. */
+	struct tbl_row	**rows;     /* All layout rows. */
+	struct tbl_cell	**cells;    /* All layout cells. */
+	struct tbl_span	**spans;    /* All data rows. */
+	int32_t		  nodesz;
+	int32_t		  rowsz;
+	int32_t		  cellsz;
+	int32_t		  spansz;
+};
+
+static	void		  cache_add(struct cache_out *, const void *, int32_t);
+static	int		  cache_cmp(const void *, const void *);
+static	int32_t		  cache_find(struct cache_out *, const void *);
+static	void		  cache_put(struct cache_out *, const void *, size_t);
+static	void		  cache_put_eqn(struct cache_out *,
+				const struct eqn_box *, int);
+static	void		  cache_put_int(struct cache_out *, int32_t);
+static	void		  cache_put_node(struct cache_out *,
+				const struct roff_node *);
+static	void		  cache_put_norm(struct cache_out *,
+				const struct roff_node *);
+static	void		  cache_put_ref(struct cache_out *, const void *);
+static	void		  cache_put_str(struct cache_out *, const char *);
+static	void		  cache_put_tbl(struct cache_out *,
+				const struct tbl_span *);
+static	int32_t		  cache_get_count(struct cache_in *);
+static	struct eqn_box	 *cache_get_eqn(struct cache_in *,
+				struct eqn_box *, int);
+static	int32_t		  cache_get_int(struct cache_in *);
+static	struct roff_node *cache_get_node(struct cache_in *,
+				struct cache_meta *, struct cache_link *);
+static	void		  cache_get_norm(struct cache_in *,
+				struct roff_node *, struct cache_link *);
+static	int32_t		  cache_get_range(struct cache_in *,
+				int32_t, int32_t);
+static	char		 *cache_get_str(struct cache_in *);
+static	void		  cache_get_tbl(struct cache_in *,
+				struct cache_meta *, int32_t);
+
+
+/*
+ * Functions for writing cache files.
+ */
+
+static void
+cache_put(struct cache_out *co, const void *p, size_t sz)
+{
+	if (co->len + sz > co->sz) {
+		if (co->sz == 0)
+			co->sz = 8192;
+		while (co->len + sz > co->sz)
+			co->sz *= 2;
+		co->buf = mandoc_realloc(co->buf, co->sz);
+	}
+	memcpy(co->buf + co->len, p, sz);
+	co->len += sz;
+}
+
+static void
+cache_put_int(struct cache_out *co, int32_t i)
+{
+	cache_put(co, &i, sizeof(i));
+}
+
+static void
+cache_put_str(struct cache_out *co, const char *cp)
+{
+	size_t	 sz;
+
+	if (cp == NULL) {
+		cache_put_int(co, -1);
+		return;
+	}
+	if ((sz = strlen(cp)) > INT32_MAX) {
+		co->fail = 1;
+		return;
+	}
+	cache_put_int(co, sz);
+	cache_put(co, cp, sz);
+}
+
+static void
+cache_add(struct cache_out *co, const void *p, int32_t i)
+{
+	if (co->ptrsz == co->ptrmax) {
+		co->ptrmax = co->ptrmax == 0 ? 512 : co->ptrmax * 2;
+		co->ptrs = mandoc_reallocarray(co->ptrs,
+		    co->ptrmax, sizeof(*co->ptrs));
+	}
+	co->ptrs[co->ptrsz].p = p;
+	co->ptrs[co->ptrsz].i = i;
+	co->ptrsz++;
+}
+
+static int
+cache_cmp(const void *a, const void *b)
+{
+	uintptr_t	 pa, pb;
+
+	pa = (uintptr_t)((const struct cache_ptr *)a)->p;
+	pb = (uintptr_t)((const struct cache_ptr *)b)->p;
+	return pa < pb ? -1 : pa > pb;
+}
+
+/*
+ * Return the index of an object in the tree, or -1 for NULL.
+ * Pointing outside the tree makes the tree impossible to store.
+ */
+static int32_t
+cache_find(struct cache_out *co, const void *p)
+{
+	struct cache_ptr	 key, *ent;
+
+	if (p == NULL)
+		return -1;
+	key.p = p;
+	ent = bsearch(&key, co->ptrs, co->ptrsz, sizeof(*co->ptrs),
+	    cache_cmp);
+	if (ent == NULL) {
+		co->fail = 1;
+		return -1;
+	}
+	return ent->i;
+}
+
+static void
+cache_put_ref(struct cache_out *co, const void *p)
+{
+	cache_put_int(co, cache_find(co, p));
+}
+
+static void
+cache_put_tbl(struct cache_out *co, const struct tbl_span *sp)
+{
+	const struct tbl_row	*rp;
+	const struct tbl_cell	*cp;
+	const struct tbl_span	*tsp;
+	const struct tbl_dat	*dp;
+	int32_t			 cnt;
+
+	cache_put_int(co, sp->opts->opts);
+	cache_put_int(co, sp->opts->cols);
+	cache_put_int(co, sp->opts->lvert);
+	cache_put_int(co, sp->opts->rvert);
+	cache_put_int(co, sp->opts->tab);
+	cache_put_int(co, sp->opts->decimal);
+
+	cnt = 0;
+	for (rp = sp->layout; rp != NULL; rp = rp->next)
+		cnt++;
+	cache_put_int(co, cnt);
+	for (rp = sp->layout; rp != NULL; rp = rp->next) {
+		cache_put_int(co, rp->vert);
+		cnt = 0;
+		for (cp = rp->first; cp != NULL; cp = cp->next)
+			cnt++;
+		cache_put_int(co, cnt);
+		for (cp = rp->first; cp != NULL; cp = cp->next) {
+			cache_put_str(co, cp->wstr);
+			cache_put_int(co, cp->width);
+			cache_put_int(co, cp->spacing);
+			cache_put_int(co, cp->vert);
+			cache_put_int(co, cp->col);
+			cache_put_int(co, cp->flags);
+			cache_put_int(co, cp->font);
+			cache_put_int(co, cp->pos);
+		}
+	}
+
+	cnt = 0;
+	for (tsp = sp; tsp != NULL; tsp = tsp->next)
+		cnt++;
+	cache_put_int(co, cnt);
+	for (tsp = sp; tsp != NULL; tsp = tsp->next) {
+		cache_put_int(co, tsp->line);
+		cache_put_int(co, tsp->pos);
+		cache_put_ref(co, tsp->layout);
+		cnt = 0;
+		for (dp = tsp->first; dp != NULL; dp = dp->next)
+			cnt++;
+		cache_put_int(co, cnt);
+		for (dp = tsp->first; dp != NULL; dp = dp->next) {
+			cache_put_ref(co, dp->layout);
+			cache_put_str(co, dp->string);
+			cache_put_int(co, dp->hspans);
+			cache_put_int(co, dp->vspans);
+			cache_put_int(co, dp->block);
+			cache_put_int(co, dp->pos);
+		}
+	}
+}
+
+static void
+cache_put_eqn(struct cache_out *co, const struct eqn_box *first, int depth)
+{
+	const struct eqn_box	*bp;
+	int32_t			 cnt;
+
+	if (depth > CACHE_EQNDEPTH) {
+		co->fail = 1;
+		return;
+	}
+	cnt = 0;
+	for (bp = first; bp != NULL; bp = bp->next)
+		cnt++;
+	cache_put_int(co, cnt);
+	for (bp = first; bp != NULL; bp = bp->next) {
+		cache_put_str(co, bp->text);
+		cache_put_str(co, bp->left);
+		cache_put_str(co, bp->right);
+		cache_put_str(co, bp->top);
+		cache_put_str(co, bp->bottom);
+		cache_put_int(co, (uint32_t)bp->expectargs);
+		cache_put_int(co, (uint32_t)bp->args);
+		cache_put_int(co, bp->size);
+		cache_put_int(co, bp->type);
+		cache_put_int(co, bp->font);
+		cache_put_int(co, bp->pos);
+		cache_put_eqn(co, bp->first, depth + 1);
+	}
+}
+
+/*
+ * Blocks and elements own their normalized arguments,
+ * heads, bodies, tails, and end-of-body markers share them.
+ */
+static void
+cache_put_norm(struct cache_out *co, const struct roff_node *n)
+{
+	const union mdoc_data	*norm;
+	size_t			 i;
+
+	if ((norm = n->norm) == NULL) {
+		cache_put_int(co, 0);
+		return;
+	}
+	if (n->type != ROFFT_BLOCK && n->type != ROFFT_ELEM) {
+		cache_put_int(co, 1);
+		cache_put_ref(co, norm);
+		return;
+	}
+	cache_put_int(co, 2);
+	switch (n->tok) {
+	case MDOC_An:
+		cache_put_int(co, norm->An.auth);
+		break;
+	case MDOC_Bd:
+		cache_put_str(co, norm->Bd.offs);
+		cache_put_int(co, norm->Bd.type);
+		cache_put_int(co, norm->Bd.comp);
+		break;
+	case MDOC_Bf:
+		cache_put_int(co, norm->Bf.font);
+		break;
+	case MDOC_Bl:
+		cache_put_str(co, norm->Bl.width);
+		cache_put_str(co, norm->Bl.offs);
+		cache_put_int(co, norm->Bl.type);
+		cache_put_int(co, norm->Bl.comp);
+		if (norm->Bl.cols == NULL || norm->Bl.ncols > INT32_MAX)
+			cache_put_int(co, 0);
+		else {
+			cache_put_int(co, norm->Bl.ncols);
+			for (i = 0; i < norm->Bl.ncols; i++)
+				cache_put_str(co, norm->Bl.cols[i]);
+		}
+		cache_put_int(co, norm->Bl.count);
+		break;
+	case MDOC_En:
+		cache_put_ref(co, norm->Es);
+		break;
+	case MDOC_Rs:
+		cache_put_int(co, norm->Rs.quote_T);
+		break;
+	default:
+		break;
+	}
+}
+
+static void
+cache_put_node(struct cache_out *co, const struct roff_node *n)
+{
+	const struct mdoc_argv	*argv;
+	size_t			 i, j;
+
+	cache_put_ref(co, n->parent);
+	cache_put_int(co, n->type);
+	cache_put_int(co, n->tok);
+	cache_put_int(co, n->flags);
+	cache_put_int(co, n->line);
+	cache_put_int(co, n->pos);
+	cache_put_int(co, n->prev_font);
+	cache_put_int(co, n->aux);
+	cache_put_int(co, n->sec);
+	cache_put_int(co, n->end);
+	cache_put_ref(co, n->head);
+	cache_put_ref(co, n->body);
+	cache_put_ref(co, n->tail);
+	cache_put_str(co, n->string);
+	cache_put_str(co, n->tag);
+
+	if (n->args == NULL || n->args->argc > INT32_MAX)
+		cache_put_int(co, 0);
+	else {
+		cache_put_int(co, n->args->argc);
+		for (i = 0; i < n->args->argc; i++) {
+			argv = n->args->argv + i;
+			cache_put_int(co, argv->arg);
+			cache_put_int(co, argv->line);
+			cache_put_int(co, argv->pos);
+			cache_put_int(co, argv->sz);
+			for (j = 0; j < argv->sz; j++)
+				cache_put_str(co, argv->value[j]);
+		}
+	}
+
+	cache_put_norm(co, n);
+	cache_put_ref(co, n->span);
+	cache_put_eqn(co, n->eqn, 0);
+}
+
+int
+mandoc_cache_write(int fd, const struct roff_meta *meta,
+    const char *fingerprint)
+{
+	struct cache_out	 co;
+	const struct roff_node	*n;
+	const struct tbl_row	*rp;
+	const struct tbl_cell	*cp;
+	const struct tbl_span	*sp;
+	const char		*p;
+	ssize_t			 wsz;
+	int32_t			 i;
+	int			 rc;
+
+	memset(&co, 0, sizeof(co));
+
+	/* Number all nodes in preorder. */
+
+	n = meta->first;
+	while (n != NULL) {
+		if (co.nodesz == co.nodemax) {
+			co.nodemax = co.nodemax == 0 ? 512 : co.nodemax * 2;
+			co.nodes = mandoc_reallocarray(co.nodes,
+			    co.nodemax, sizeof(*co.nodes));
+		}
+		co.nodes[co.nodesz] = n;
+		cache_add(&co, n, co.nodesz++);
+		if (n->child != NULL) {
+			n = n->child;
+			continue;
+		}
+		while (n != NULL && n->next == NULL)
+			n = n->parent;
+		if (n != NULL)
+			n = n->next;
+	}
+
+	/* Number normalized arguments, tables, and their parts. */
+
+	for (i = 0; i < co.nodesz; i++) {
+		n = co.nodes[i];
+		if (n->norm != NULL &&
+		    (n->type == ROFFT_BLOCK || n->type == ROFFT_ELEM))
+			cache_add(&co, n->norm, i);
+		if (n->span == NULL || n->span->prev != NULL)
+			continue;
+		co.tbls = mandoc_reallocarray(co.tbls,
+		    co.tblsz + 1, sizeof(*co.tbls));
+		co.tbls[co.tblsz++] = n->span;
+		for (rp = n->span->layout; rp != NULL; rp = rp->next) {
+			cache_add(&co, rp, co.rowsz++);
+			for (cp = rp->first; cp != NULL; cp = cp->next)
+				cache_add(&co, cp, co.cellsz++);
+		}
+		for (sp = n->span; sp != NULL; sp = sp->next)
+			cache_add(&co, sp, co.spansz++);
+	}
+	qsort(co.ptrs, co.ptrsz, sizeof(*co.ptrs), cache_cmp);
+
+	cache_put_int(&co, CACHE_MAGIC);
+	cache_put_int(&co, CACHE_VERSION);
+	cache_put_int(&co, TOKEN_NONE);
+	cache_put_int(&co, MDOC_ARG_MAX);
+	cache_put_str(&co, fingerprint);
+
+	cache_put_str(&co, meta->msec);
+	cache_put_str(&co, meta->vol);
+	cache_put_str(&co, meta->os);
+	cache_put_str(&co, meta->arch);
+	cache_put_str(&co, meta->title);
+	cache_put_str(&co, meta->name);
+	cache_put_str(&co, meta->date);
+	cache_put_str(&co, meta->sodest);
+	cache_put_int(&co, meta->hasbody);
+	cache_put_int(&co, meta->rcsids);
+	cache_put_int(&co, meta->os_e);
+	cache_put_int(&co, meta->macroset);
+
+	cache_put_int(&co, co.tblsz);
+	cache_put_int(&co, co.rowsz);
+	cache_put_int(&co, co.cellsz);
+	cache_put_int(&co, co.spansz);
+	for (i = 0; i < co.tblsz; i++)
+		cache_put_tbl(&co, co.tbls[i]);
+
+	cache_put_int(&co, co.nodesz);
+	for (i = 0; i < co.nodesz; i++)
+		cache_put_node(&co, co.nodes[i]);
+
+	rc = -1;
+	if (co.fail == 0) {
+		p = co.buf;
+		while (co.len > 0) {
+			if ((wsz = write(fd, p, co.len)) == -1) {
+				if (errno == EINTR)
+					continue;
+				break;
+			}
+			p += wsz;
+			co.len -= wsz;
+		}
+		if (co.len == 0)
+			rc = 0;
+	}
+	free(co.buf);
+	free(co.nodes);
+	free(co.tbls);
+	free(co.ptrs);
+	return rc;
+}
+
+
+/*
+ * Functions for reading cache files.
+ * All of them check the input and set ci->bad rather
+ * than failing, such that the caller only needs to check
+ * after the end of larger units.
+ */
+
+static int32_t
+cache_get_int(struct cache_in *ci)
+{
+	int32_t	 i;
+
+	if (ci->bad || ci->end - ci->cp < (ptrdiff_t)sizeof(i)) {
+		ci->bad = 1;
+		return 0;
+	}
+	memcpy(&i, ci->cp, sizeof(i));
+	ci->cp += sizeof(i);
+	return i;
+}
+
+static int32_t
+cache_get_range(struct cache_in *ci, int32_t min, int32_t max)
+{
+	int32_t	 i;
+
+	i = cache_get_int(ci);
+	if (ci->bad == 0 && (i < min || i > max))
+		ci->bad = 1;
+	return ci->bad ? min : i;
+}
+
+/*
+ * Every counted item takes at least one integer,
+ * so a count exceeding the remaining size is corrupt.
+ */
+static int32_t
+cache_get_count(struct cache_in *ci)
+{
+	return cache_get_range(ci, 0,
+	    ci->bad ? 0 : (ci->end - ci->cp) / sizeof(int32_t));
+}
+
+static char *
+cache_get_str(struct cache_in *ci)
+{
+	char	*cp;
+	int32_t	 sz;
+
+	if ((sz = cache_get_range(ci, -1, INT32_MAX)) == -1 || ci->bad)
+		return NULL;
+	if (ci->end - ci->cp < sz) {
+		ci->bad = 1;
+		return NULL;
+	}
+	cp = mandoc_strndup(ci->cp, sz);
+	ci->cp += sz;
+	return cp;
+}
+
+
+static void
+cache_get_tbl(struct cache_in *ci, struct cache_meta *cm, int32_t itbl)
+{
+	struct tbl_opts	*opts;
+	struct tbl_row	*rp;
+	struct tbl_cell	*cp;
+	struct tbl_span	*sp;
+	struct tbl_dat	*dp;
+	int32_t		 i, j, k, sz;
+
+	opts = cm->opts + itbl;
+	opts->opts = cache_get_int(ci);
+	opts->cols = cache_get_int(ci);
+	opts->lvert = cache_get_int(ci);
+	opts->rvert = cache_get_int(ci);
+	opts->tab = cache_get_int(ci);
+	opts->decimal = cache_get_int(ci);
+
+	sz = cache_get_range(ci, 0, ci->rowmax - cm->rowsz);
+	for (i = 0; i < sz && ci->bad == 0; i++) {
+		rp = mandoc_calloc(1, sizeof(*rp));
+		if (i > 0)
+			cm->rows[cm->rowsz - 1]->next = rp;
+		cm->rows[cm->rowsz++] = rp;
+		rp->vert = cache_get_int(ci);
+		j = cache_get_range(ci, 0, ci->cellmax - cm->cellsz);
+		while (j-- > 0 && ci->bad == 0) {
+			cp = mandoc_calloc(1, sizeof(*cp));
+			if (rp->last == NULL)
+				rp->first = cp;
+			else
+				rp->last->next = cp;
+			rp->last = cp;
+			cm->cells[cm->cellsz++] = cp;
+			cp->wstr = cache_get_str(ci);
+			cp->width = cache_get_range(ci, 0, INT32_MAX);
+			cp->spacing = cache_get_range(ci, 0, INT32_MAX);
+			cp->vert = cache_get_int(ci);
+			cp->col = cache_get_int(ci);
+			cp->flags = cache_get_int(ci);
+			cp->font = cache_get_range(ci,
+			    ESCAPE_EXPAND, ESCAPE_OVERSTRIKE);
+			cp->pos = cache_get_range(ci, 0, TBL_CELL_MAX - 1);
+		}
+	}
+
+	sz = cache_get_range(ci, 0, ci->spanmax - cm->spansz);
+	for (i = 0; i < sz && ci->bad == 0; i++) {
+		sp = mandoc_calloc(1, sizeof(*sp));
+		if (i > 0) {
+			sp->prev = cm->spans[cm->spansz - 1];
+			sp->prev->next = sp;
+		}
+		cm->spans[cm->spansz++] = sp;
+		sp->opts = opts;
+		sp->line = cache_get_int(ci);
+		sp->pos = cache_get_range(ci, 0, TBL_SPAN_DHORIZ);
+		j = cache_get_range(ci, -1, cm->rowsz - 1);
+		sp->layout = j == -1 ? NULL : cm->rows[j];
+		j = cache_get_count(ci);
+		while (j-- > 0 && ci->bad == 0) {
+			dp = mandoc_calloc(1, sizeof(*dp));
+			if (sp->last == NULL)
+				sp->first = dp;
+			else
+				sp->last->next = dp;
+			sp->last = dp;
+			k = cache_get_range(ci, -1, cm->cellsz - 1);
+			dp->layout = k == -1 ? NULL : cm->cells[k];
+			dp->string = cache_get_str(ci);
+			dp->hspans = cache_get_int(ci);
+			dp->vspans = cache_get_int(ci);
+			dp->block = cache_get_int(ci);
+			dp->pos = cache_get_range(ci, 0, TBL_DATA_NDHORIZ);
+		}
+	}
+}
+
+static struct eqn_box *
+cache_get_eqn(struct cache_in *ci, struct eqn_box *parent, int depth)
+{
+	struct eqn_box	*bp, *first, *last;
+	int32_t		 sz;
+
+	if (depth > CACHE_EQNDEPTH) {
+		ci->bad = 1;
+		return NULL;
+	}
+	first = last = NULL;
+	sz = cache_get_count(ci);
+	while (sz-- > 0 && ci->bad == 0) {
+		bp = mandoc_calloc(1, sizeof(*bp));
+		bp->parent = parent;
+		if (last == NULL)
+			first = bp;
+		else {
+			last->next = bp;
+			bp->prev = last;
+		}
+		last = bp;
+		bp->text = cache_get_str(ci);
+		bp->left = cache_get_str(ci);
+		bp->right = cache_get_str(ci);
+		bp->top = cache_get_str(ci);
+		bp->bottom = cache_get_str(ci);
+		bp->expectargs = (uint32_t)cache_get_int(ci);
+		bp->args = (uint32_t)cache_get_int(ci);
+		bp->size = cache_get_int(ci);
+		bp->type = cache_get_range(ci, 0, EQN_MATRIX);
+		bp->font = cache_get_range(ci, 0, EQNFONT__MAX - 1);
+		bp->pos = cache_get_range(ci, 0, EQNPOS__MAX - 1);
+		bp->first = cache_get_eqn(ci, bp, depth + 1);
+	}
+	if (parent != NULL)
+		parent->last = last;
+	return first;
+}
+
+static void
+cache_get_norm(struct cache_in *ci, struct roff_node *n,
+    struct cache_link *lk)
+{
+	union mdoc_data	*norm;
+	const char	**cols;
+	int32_t		  i, sz;
+
+	switch (cache_get_range(ci, 0, 2)) {
+	case 0:
+		return;
+	case 1:
+		if (n->type == ROFFT_BLOCK || n->type == ROFFT_ELEM)
+			ci->bad = 1;
+		else
+			lk->norm = cache_get_range(ci, 0, INT32_MAX);
+		return;
+	default:
+		if (n->type != ROFFT_BLOCK && n->type != ROFFT_ELEM) {
+			ci->bad = 1;
+			return;
+		}
+		break;
+	}
+
+	norm = n->norm = mandoc_calloc(1, sizeof(*n->norm));
+	switch (n->tok) {
+	case MDOC_An:
+		norm->An.auth = cache_get_range(ci, 0, AUTH_nosplit);
+		break;
+	case MDOC_Bd:
+		norm->Bd.offs = cache_get_str(ci);
+		norm->Bd.type = cache_get_range(ci, 0, DISP_literal);
+		norm->Bd.comp = cache_get_int(ci);
+		break;
+	case MDOC_Bf:
+		norm->Bf.font = cache_get_range(ci, 0, FONT_Sy);
+		break;
+	case MDOC_Bl:
+		norm->Bl.width = cache_get_str(ci);
+		norm->Bl.offs = cache_get_str(ci);
+		norm->Bl.type = cache_get_range(ci, 0, LIST_MAX - 1);
+		norm->Bl.comp = cache_get_int(ci);
+		if ((sz = cache_get_count(ci)) > 0) {
+			cols = mandoc_calloc(sz, sizeof(*cols));
+			norm->Bl.cols = cols;
+			norm->Bl.ncols = sz;
+			for (i = 0; i < sz; i++)
+				cols[i] = cache_get_str(ci);
+		}
+		norm->Bl.count = cache_get_int(ci);
+		break;
+	case MDOC_En:
+		lk->es = cache_get_range(ci, -1, INT32_MAX);
+		break;
+	case MDOC_Rs:
+		norm->Rs.quote_T = cache_get_int(ci);
+		break;
+	default:
+		break;
+	}
+}
+
+static struct roff_node *
+cache_get_node(struct cache_in *ci, struct cache_meta *cm,
+    struct cache_link *lk)
+{
+	struct roff_node	*n;
+	struct mdoc_argv	*argv;
+	int32_t			 argsz, i, j, sz;
+
+	n = mandoc_calloc(1, sizeof(*n));
+	lk->parent = cm->nodesz == 0 ? cache_get_range(ci, -1, -1) :
+	    cache_get_range(ci, 0, cm->nodesz - 1);
+	cm->nodes[cm->nodesz++] = n;
+	lk->norm = lk->es = -1;
+
+	n->type = cache_get_range(ci, 0, ROFFT_EQN);
+	n->tok = cache_get_range(ci, 0, MAN_MAX - 1);
+	n->flags = cache_get_int(ci);
+	n->line = cache_get_int(ci);
+	n->pos = cache_get_int(ci);
+	n->prev_font = cache_get_int(ci);
+	n->aux = cache_get_int(ci);
+	n->sec = cache_get_range(ci, 0, SEC__MAX - 1);
+	n->end = cache_get_range(ci, 0, ENDBODY_SPACE);
+	lk->head = cache_get_range(ci, -1, INT32_MAX);
+	lk->body = cache_get_range(ci, -1, INT32_MAX);
+	lk->tail = cache_get_range(ci, -1, INT32_MAX);
+	n->string = cache_get_str(ci);
+	n->tag = cache_get_str(ci);
+
+	if ((sz = cache_get_count(ci)) > 0) {
+		n->args = mandoc_calloc(1, sizeof(*n->args));
+		n->args->argv = mandoc_calloc(sz, sizeof(*n->args->argv));
+		n->args->argc = sz;
+		n->args->refcnt = 1;
+		for (i = 0; i < sz && ci->bad == 0; i++) {
+			argv = n->args->argv + i;
+			argv->arg = cache_get_range(ci, 0, MDOC_ARG_MAX - 1);
+			argv->line = cache_get_int(ci);
+			argv->pos = cache_get_int(ci);
+			if ((argsz = cache_get_count(ci)) == 0)
+				continue;
+			argv->value = mandoc_calloc(argsz,
+			    sizeof(*argv->value));
+			argv->sz = argsz;
+			for (j = 0; j < argsz; j++)
+				argv->value[j] = cache_get_str(ci);
+		}
+	}
+
+	cache_get_norm(ci, n, lk);
+	i = cache_get_range(ci, -1, cm->spansz - 1);
+	n->span = i == -1 ? NULL : cm->spans[i];
+	n->eqn = cache_get_eqn(ci, NULL, 0);
+	return n;
+}
+
+/*
+ * Return the tree stored in the cache file,
+ * or NULL if the file is corrupt or belongs to different input.
+ */
+struct roff_meta *
+mandoc_cache_read(int fd, const char *fingerprint)
+{
+	struct stat		 st;
+	struct cache_in		 ci;
+	struct cache_meta	*cm;
+	struct cache_link	*links, *lk;
+	struct roff_node	*n, *np;
+	char			*buf, *cp;
+	size_t			 off;
+	ssize_t			 rsz;
+	int32_t			 i, sz;
+
+	if (fstat(fd, &st) == -1 || S_ISREG(st.st_mode) == 0 ||
+	    st.st_size > INT32_MAX)
+		return NULL;
+	buf = mandoc_malloc(st.st_size + 1);
+	off = 0;
+	while (off < (size_t)st.st_size) {
+		if ((rsz = read(fd, buf + off, st.st_size - off)) == -1) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (rsz == 0)
+			break;
+		off += rsz;
+	}
+	if (off < (size_t)st.st_size) {
+		free(buf);
+		return NULL;
+	}
+
+	memset(&ci, 0, sizeof(ci));
+	ci.cp = buf;
+	ci.end = buf + off;
+	cm = NULL;
+	links = NULL;
+
+	if (cache_get_int(&ci) != CACHE_MAGIC ||
+	    cache_get_int(&ci) != CACHE_VERSION ||
+	    cache_get_int(&ci) != TOKEN_NONE ||
+	    cache_get_int(&ci) != MDOC_ARG_MAX)
+		goto fail;
+	cp = cache_get_str(&ci);
+	if (cp == NULL || strcmp(cp, fingerprint) != 0) {
+		free(cp);
+		goto fail;
+	}
+	free(cp);
+
+	cm = mandoc_calloc(1, sizeof(*cm));
+	cm->meta.msec = cache_get_str(&ci);
+	cm->meta.vol = cache_get_str(&ci);
+	cm->meta.os = cache_get_str(&ci);
+	cm->meta.arch = cache_get_str(&ci);
+	cm->meta.title = cache_get_str(&ci);
+	cm->meta.name = cache_get_str(&ci);
+	cm->meta.date = cache_get_str(&ci);
+	cm->meta.sodest = cache_get_str(&ci);
+	cm->meta.hasbody = cache_get_int(&ci);
+	cm->meta.rcsids = cache_get_int(&ci);
+	cm->meta.os_e = cache_get_range(&ci, 0, MANDOC_OS_OPENBSD);
+	cm->meta.macroset = cache_get_range(&ci, 0, MACROSET_MAN);
+
+	/* Tables, with all their layout and data rows. */
+
+	sz = cache_get_count(&ci);
+	ci.rowmax = cache_get_count(&ci);
+	ci.cellmax = cache_get_count(&ci);
+	ci.spanmax = cache_get_count(&ci);
+	if (ci.bad)
+		goto fail;
+	if (sz > 0)
+		cm->opts = mandoc_calloc(sz, sizeof(*cm->opts));
+	if (ci.rowmax > 0)
+		cm->rows = mandoc_calloc(ci.rowmax, sizeof(*cm->rows));
+	if (ci.cellmax > 0)
+		cm->cells = mandoc_calloc(ci.cellmax, sizeof(*cm->cells));
+	if (ci.spanmax > 0)
+		cm->spans = mandoc_calloc(ci.spanmax, sizeof(*cm->spans));
+	for (i = 0; i < sz && ci.bad == 0; i++)
+		cache_get_tbl(&ci, cm, i);
+
+	/* Nodes, to be linked when all of them exist. */
+
+	if ((sz = cache_get_count(&ci)) == 0 || ci.bad)
+		goto fail;
+	cm->nodes = mandoc_calloc(sz, sizeof(*cm->nodes));
+	links = mandoc_calloc(sz, sizeof(*links));
+	for (i = 0; i < sz && ci.bad == 0; i++)
+		cache_get_node(&ci, cm, links + i);
+	if (ci.bad || ci.cp != ci.end || cm->nodes[0]->type != ROFFT_ROOT)
+		goto fail;
+
+	for (i = 0; i < sz; i++) {
+		n = cm->nodes[i];
+		lk = links + i;
+		if (lk->head >= sz || lk->body >= sz || lk->tail >= sz ||
+		    lk->norm >= sz || lk->es >= sz)
+			goto fail;
+		if (lk->parent != -1) {
+			np = cm->nodes[lk->parent];
+			n->parent = np;
+			if (np->last == NULL)
+				np->child = n;
+			else {
+				np->last->next = n;
+				n->prev = np->last;
+			}
+			np->last = n;
+		}
+		if (lk->head != -1)
+			n->head = cm->nodes[lk->head];
+		if (lk->body != -1)
+			n->body = cm->nodes[lk->body];
+		if (lk->tail != -1)
+			n->tail = cm->nodes[lk->tail];
+		if (lk->norm != -1) {
+			np = cm->nodes[lk->norm];
+			if (np->norm == NULL || (np->type != ROFFT_BLOCK &&
+			    np->type != ROFFT_ELEM))
+				goto fail;
+			n->norm = np->norm;
+		}
+		if (lk->es != -1)
+			n->norm->Es = cm->nodes[lk->es];
+	}
+	cm->meta.first = cm->nodes[0];
+	free(links);
+	free(buf);
+	return &cm->meta;
+
+fail:
+	free(links);
+	free(buf);
+	if (cm != NULL)
+		mandoc_cache_free(&cm->meta);
+	return NULL;
+}
+
+void
+mandoc_cache_free(struct roff_meta *meta)
+{
+	struct cache_meta	*cm;
+	struct roff_node	*n;
+	struct tbl_span		*sp;
+	struct tbl_dat		*dp;
+	size_t			 i;
+	int32_t			 j;
+
+	if ((cm = (struct cache_meta *)meta) == NULL)
+		return;
+
+	for (j = 0; j < cm->nodesz; j++) {
+		n = cm->nodes[j];
+		if (n->norm != NULL &&
+		    (n->type == ROFFT_BLOCK || n->type == ROFFT_ELEM)) {
+			switch (n->tok) {
+			case MDOC_Bd:
+				free((void *)n->norm->Bd.offs);
+				break;
+			case MDOC_Bl:
+				free((void *)n->norm->Bl.width);
+				free((void *)n->norm->Bl.offs);
+				for (i = 0; i < n->norm->Bl.ncols; i++)
+					free((void *)n->norm->Bl.cols[i]);
+				free(n->norm->Bl.cols);
+				break;
+			default:
+				break;
+			}
+		}
+		roff_node_free(n);
+	}
+	free(cm->nodes);
+
+	for (j = 0; j < cm->cellsz; j++) {
+		free(cm->cells[j]->wstr);
+		free(cm->cells[j]);
+	}
+	free(cm->cells);
+	for (j = 0; j < cm->rowsz; j++)
+		free(cm->rows[j]);
+	free(cm->rows);
+	for (j = 0; j < cm->spansz; j++) {
+		sp = cm->spans[j];
+		while ((dp = sp->first) != NULL) {
+			sp->first = dp->next;
+			free(dp->string);
+			free(dp);
+		}
+		free(sp);
+	}
+	free(cm->spans);
+	free(cm->opts);
+
+	free(meta->msec);
+	free(meta->vol);
+	free(meta->os);
+	free(meta->arch);
+	free(meta->title);
+	free(meta->name);
+	free(meta->date);
+	free(meta->sodest);
+	free(cm);
+}
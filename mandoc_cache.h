@@ -0,0 +1,27 @@
+/* $Id$ */
+/*
+ * Copyright (c) 2026 The mandoc developers
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Storing validated syntax trees in files and reading them back,
+ * such that a page can be formatted again without parsing it again.
+ * For use by the main program only.
+ */
+
+struct	roff_meta;
+
+int		  mandoc_cache_write(int, const struct roff_meta *,
+			const char *);
+struct roff_meta *mandoc_cache_read(int, const char *);
+void		  mandoc_cache_free(struct roff_meta *);
@@ -277,11 +277,11 @@ static	const char *const type_message[MANDOCERR_MAX] = {
 	"fork",
 	"fstat",
 	"getline",
-	"glob",
 	"gzclose",
 	"gzdopen",
 	"mkstemp",
 	"open",
+	"opendir",
 	"pledge",
 	"read",
 	"wait",
@@ -292,6 +292,7 @@ static	FILE		*fileptr = NULL;
 static	const char	*filename = NULL;
 static	enum mandocerr	 min_type = MANDOCERR_BADARG;
 static	enum mandoclevel rc = MANDOCLEVEL_OK;
+static	unsigned long	 count = 0;
 
 
 void
@@ -337,6 +338,30 @@ mandoc_msg_setrc(enum mandoclevel level)
 		rc = level;
 }
 
+/*
+ * Return the number of messages not suppressed by the minimum type,
+ * such that callers can tell whether some operation caused any.
+ */
+unsigned long
+mandoc_msg_getcount(void)
+{
+	return count;
+}
+
+/*
+ * Reset the exit status and return the old one,
+ * such that the level of the messages about one file can be found.
+ */
+enum mandoclevel
+mandoc_msg_resetrc(void)
+{
+	enum mandoclevel	 old;
+
+	old = rc;
+	rc = MANDOCLEVEL_OK;
+	return old;
+}
+
 void
 mandoc_msg(enum mandocerr t, int line, int col, const char *fmt, ...)
 {
@@ -345,6 +370,7 @@ mandoc_msg(enum mandocerr t, int line, int col, const char *fmt, ...)
 
 	if (t < min_type)
 		return;
+	count++;
 
 	level = MANDOCLEVEL_SYSERR;
 	while (t < lowest_type[level])
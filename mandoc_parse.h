@@ -31,14 +31,27 @@
 #define	MPARSE_VALIDATE	(1 << 6)  /* call validation functions */
 #define	MPARSE_COMMENT	(1 << 7)  /* save comments in the tree */
 
+/*
+ * Default size of the cache of files included with .so.
+ */
+#define	MPARSE_INCLSZ	(1024 * 1024)
+
 
 struct	roff_meta;
+struct	roff_node;
 struct	mparse;
 
 struct mparse	 *mparse_alloc(int, enum mandoc_os, const char *);
 void		  mparse_copy(const struct mparse *);
 void		  mparse_free(struct mparse *);
+void		  mparse_include(struct mparse *,
+			void (*)(void *, const char *), void *);
+void		  mparse_include_cache(struct mparse *, size_t);
 int		  mparse_open(struct mparse *, const char *);
 void		  mparse_readfd(struct mparse *, int, const char *);
 void		  mparse_reset(struct mparse *);
 struct roff_meta *mparse_result(struct mparse *);
+void		  mparse_stream(struct mparse *, void (*)(void *,
+			const struct roff_meta *, struct roff_node *),
+			void *);
+void		  roffhash_freeall(void);
@@ -52,7 +52,7 @@ enum	outt {
 	OUTT_HTML
 };
 
-static	void	  process(struct mparse *, enum outt, void *);
+static	void	  process(struct mparse *, enum outt, void *, int);
 static	int	  read_fds(int, int *);
 static	void	  usage(void) __attribute__((__noreturn__));
 
@@ -123,12 +123,10 @@ main(int argc, char *argv[])
 	struct manoutput	 options;
 	struct mparse		*parser;
 	void			*formatter;
+	FILE			*outfp, *errfp;
 	const char		*defos;
 	const char		*errstr;
 	int			 clientfd;
-	int			 old_stdin;
-	int			 old_stdout;
-	int			 old_stderr;
 	int			 fds[3];
 	int			 state, opt;
 	enum outt		 outtype;
@@ -181,72 +179,68 @@ main(int argc, char *argv[])
 	mchars_alloc();
 	parser = mparse_alloc(MPARSE_SO | MPARSE_UTF8 | MPARSE_LATIN1 |
 	    MPARSE_VALIDATE, MANDOC_OS_OTHER, defos);
+	mparse_include_cache(parser, MPARSE_INCLSZ);
 
 	memset(&options, 0, sizeof(options));
-	switch (outtype) {
-	case OUTT_ASCII:
-		formatter = ascii_alloc(&options);
-		break;
-	case OUTT_UTF8:
-		formatter = utf8_alloc(&options);
-		break;
-	case OUTT_HTML:
+	if (outtype == OUTT_HTML)
 		options.fragment = 1;
-		formatter = html_alloc(&options);
-		break;
-	}
 
-	state = 1;  /* work to do */
-	fflush(stdout);
-	fflush(stderr);
-	if ((old_stdin = dup(STDIN_FILENO)) == -1 ||
-	    (old_stdout = dup(STDOUT_FILENO)) == -1 ||
-	    (old_stderr = dup(STDERR_FILENO)) == -1) {
-		warn("dup");
-		state = -1;  /* error */
-	}
+	/*
+	 * Format to the client's descriptors through stdio streams
+	 * rather than moving them onto our own standard streams.
+	 */
 
+	state = 1;  /* work to do */
 	while (state == 1 && (state = read_fds(clientfd, fds)) == 1) {
-		if (dup2(fds[0], STDIN_FILENO) == -1 ||
-		    dup2(fds[1], STDOUT_FILENO) == -1 ||
-		    dup2(fds[2], STDERR_FILENO) == -1) {
-			warn("dup2");
+		outfp = fdopen(fds[1], "w");
+		errfp = outfp == NULL ? NULL : fdopen(fds[2], "w");
+		if (errfp == NULL) {
+			warn("fdopen");
+			if (outfp == NULL)
+				close(fds[1]);
+			else
+				fclose(outfp);
+			close(fds[0]);
+			close(fds[2]);
 			state = -1;
 			break;
 		}
+		options.outfp = outfp;
+		mandoc_msg_setoutfile(errfp);
 
-		close(fds[0]);
-		close(fds[1]);
-		close(fds[2]);
+		switch (outtype) {
+		case OUTT_ASCII:
+			formatter = ascii_alloc(&options);
+			break;
+		case OUTT_UTF8:
+			formatter = utf8_alloc(&options);
+			break;
+		case OUTT_HTML:
+			formatter = html_alloc(&options);
+			break;
+		}
 
-		process(parser, outtype, formatter);
+		process(parser, outtype, formatter, fds[0]);
 		mparse_reset(parser);
-		if (outtype == OUTT_HTML)
-			html_reset(formatter);
-
-		fflush(stdout);
-		fflush(stderr);
-		/* Close file descriptors by restoring the old ones. */
-		if (dup2(old_stderr, STDERR_FILENO) == -1 ||
-		    dup2(old_stdout, STDOUT_FILENO) == -1 ||
-		    dup2(old_stdin, STDIN_FILENO) == -1) {
-			warn("dup2");
-			state = -1;
+
+		switch (outtype) {
+		case OUTT_ASCII:
+		case OUTT_UTF8:
+			ascii_free(formatter);
+			break;
+		case OUTT_HTML:
+			html_free(formatter);
 			break;
 		}
+		mandoc_msg_setoutfile(NULL);
+		close(fds[0]);
+		fclose(outfp);
+		fclose(errfp);
 	}
 
 	close(clientfd);
-	switch (outtype) {
-	case OUTT_ASCII:
-	case OUTT_UTF8:
-		ascii_free(formatter);
-		break;
-	case OUTT_HTML:
-		html_free(formatter);
-		break;
-	}
 	mparse_free(parser);
+	roffhash_freeall();
 	mchars_free();
 #if DEBUG_MEMORY
 	mandoc_dbg_finish();
@@ -255,11 +249,11 @@ main(int argc, char *argv[])
 }
 
 static void
-process(struct mparse *parser, enum outt outtype, void *formatter)
+process(struct mparse *parser, enum outt outtype, void *formatter, int fd)
 {
 	struct roff_meta *meta;
 
-	mparse_readfd(parser, STDIN_FILENO, "<unixfd>");
+	mparse_readfd(parser, fd, "<unixfd>");
 	meta = mparse_result(parser);
 	if (meta->macroset == MACROSET_MDOC) {
 		switch (outtype) {
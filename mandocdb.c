@@ -23,6 +23,7 @@
 #include <sys/types.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 
 #include <assert.h>
 #include <ctype.h>
@@ -37,6 +38,7 @@
 #include "compat_fts.h"
 #endif
 #include <limits.h>
+#include <signal.h>
 #if HAVE_SANDBOX_INIT
 #include <sandbox.h>
 #endif
@@ -47,6 +49,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <zlib.h>
 
 #include "mandoc_aux.h"
 #include "mandoc_ohash.h"
@@ -81,8 +84,26 @@ struct	inodev {
 	dev_t		 st_dev;
 };
 
+struct	content {
+	uint64_t	 hash;
+	size_t		 sz;
+};
+
+/*
+ * A file found by a treescan() worker process, sent to the parent;
+ * followed by the file name, section, architecture, name, and suffix,
+ * each NUL-terminated.  A record with sz == 0 ends a directory.
+ */
+struct	scanrec {
+	struct inodev	 inodev;
+	size_t		 sz;      /* total length of the strings */
+	int		 gzip;    /* filename has a .gz suffix */
+	enum form	 dform;   /* format from directory */
+};
+
 struct	mpage {
 	struct inodev	 inodev;  /* used for hashing routine */
+	struct content	 content; /* used for hashing with -s */
 	struct dba_array *dba;
 	char		*sec;     /* section from file content */
 	char		*arch;    /* architecture from file content */
@@ -94,8 +115,11 @@ struct	mpage {
 	enum form	 form;    /* format from file content */
 };
 
+/*
+ * All strings of an mlink are stored in the same allocation,
+ * right after the structure, starting with the file name.
+ */
 struct	mlink {
-	char		 file[PATH_MAX]; /* filename rel. to manpath */
 	char		*dsec;    /* section from directory */
 	char		*arch;    /* architecture from directory */
 	char		*name;    /* name from file name (not empty) */
@@ -105,6 +129,7 @@ struct	mlink {
 	int		 gzip;	  /* filename has a .gz suffix */
 	enum form	 dform;   /* format from directory */
 	enum form	 fform;   /* format from file name suffix */
+	char		 file[];  /* filename rel. to manpath */
 };
 
 typedef	int (*mdoc_fp)(struct mpage *, const struct roff_meta *,
@@ -129,10 +154,12 @@ static	int	 fts_compare(const FTSENT *const *, const FTSENT *const *);
 #else
 static	int	 fts_compare(const FTSENT **, const FTSENT **);
 #endif
-static	void	 mlink_add(struct mlink *, const struct stat *);
+static	void	 mlink_add(const char *, const char *, const char *,
+			const char *, const char *, enum form, int,
+			const struct stat *);
 static	void	 mlink_check(struct mpage *, struct mlink *);
-static	void	 mlink_free(struct mlink *);
 static	void	 mlinks_undupe(struct mpage *);
+static	int	 mpage_share(struct mpage *);
 static	void	 mpages_free(void);
 static	void	 mpages_merge(struct dba *, struct mparse *);
 static	void	 parse_cat(struct mpage *, int);
@@ -168,14 +195,22 @@ static	void	 putmdockey(const struct mpage *,
 #ifdef READ_ALLOWED_PATH
 static	int	 read_allowed(const char *);
 #endif
+static	int	 read_content(const char *, char **, size_t *);
 static	int	 render_string(char **, size_t *);
 static	void	 say(const char *, const char *, ...)
 			__attribute__((__format__ (__printf__, 2, 3)));
 static	int	 set_basedir(const char *, int);
 static	int	 treescan(void);
+static	int	 treescan_read(FILE *);
+static	int	 treewalk(int, FILE **);
+static	void	 treewalk_put(FILE *, const char *, const char *,
+			const char *, const char *, const char *,
+			enum form, int, const struct stat *);
 static	size_t	 utf8(unsigned int, char [7]);
 
 static	int		 nodb; /* no database changes */
+static	int		 jobs = 1; /* number of treescan() processes */
+static	int		 share; /* merge pages with identical content */
 static	int		 mparse_options; /* abort the parse early */
 static	int		 use_all; /* use all found files */
 static	int		 debug; /* print what we're doing */
@@ -188,6 +223,7 @@ static	size_t		 basedir_len; /* strlen(basedir) */
 static	struct mpage	*mpage_head; /* list of distinct manual pages */
 static	struct ohash	 mpages; /* table of distinct manual pages */
 static	struct ohash	 mlinks; /* table of directory entries */
+static	struct ohash	 contents; /* table of page contents for -s */
 static	struct ohash	 names; /* table of all names */
 static	struct ohash	 strings; /* table of all strings */
 static	uint64_t	 name_mask;
@@ -322,12 +358,12 @@ mandocdb(int argc, char *argv[])
 	struct manconf	  conf;
 	struct mparse	 *mp;
 	struct dba	 *dba;
-	const char	 *path_arg, *progname;
+	const char	 *path_arg, *progname, *errstr;
 	size_t		  j, sz;
 	int		  ch, i;
 
 #if HAVE_PLEDGE
-	if (pledge("stdio rpath wpath cpath", NULL) == -1) {
+	if (pledge("stdio rpath wpath cpath proc", NULL) == -1) {
 		warn("pledge");
 		return (int)MANDOCLEVEL_SYSERR;
 	}
@@ -357,7 +393,7 @@ mandocdb(int argc, char *argv[])
 	path_arg = NULL;
 	op = OP_DEFAULT;
 
-	while ((ch = getopt(argc, argv, "aC:Dd:npQT:tu:v")) != -1)
+	while ((ch = getopt(argc, argv, "aC:Dd:j:npQsT:tu:v")) != -1)
 		switch (ch) {
 		case 'a':
 			use_all = 1;
@@ -375,6 +411,13 @@ mandocdb(int argc, char *argv[])
 			path_arg = optarg;
 			op = OP_UPDATE;
 			break;
+		case 'j':
+			jobs = strtonum(optarg, 1, 256, &errstr);
+			if (errstr != NULL) {
+				warnx("-j %s: %s", optarg, errstr);
+				goto usage;
+			}
+			break;
 		case 'n':
 			nodb = 1;
 			break;
@@ -384,6 +427,9 @@ mandocdb(int argc, char *argv[])
 		case 'Q':
 			mparse_options |= MPARSE_QUICK;
 			break;
+		case 's':
+			share = 1;
+			break;
 		case 'T':
 			if (strcmp(optarg, "utf8") != 0) {
 				warnx("-T%s: Unsupported output format",
@@ -414,8 +460,9 @@ mandocdb(int argc, char *argv[])
 	argv += optind;
 
 #if HAVE_PLEDGE
-	if (nodb) {
-		if (pledge("stdio rpath", NULL) == -1) {
+	if (nodb || jobs == 1) {
+		if (pledge(nodb ? jobs > 1 ? "stdio rpath proc" :
+		    "stdio rpath" : "stdio rpath wpath cpath", NULL) == -1) {
 			warn("pledge");
 			return (int)MANDOCLEVEL_SYSERR;
 		}
@@ -430,6 +477,7 @@ mandocdb(int argc, char *argv[])
 	exitcode = (int)MANDOCLEVEL_OK;
 	mchars_alloc();
 	mp = mparse_alloc(mparse_options, MANDOC_OS_OTHER, NULL);
+	mparse_include_cache(mp, MPARSE_INCLSZ);
 	mandoc_ohash_init(&mpages, 6, offsetof(struct mpage, inodev));
 	mandoc_ohash_init(&mlinks, 6, offsetof(struct mlink, file));
 
@@ -528,6 +576,7 @@ mandocdb(int argc, char *argv[])
 out:
 	manconf_free(&conf);
 	mparse_free(mp);
+	roffhash_freeall();
 	mchars_free();
 	mpages_free();
 	ohash_delete(&mpages);
@@ -538,9 +587,9 @@ out:
 	return exitcode;
 usage:
 	progname = getprogname();
-	fprintf(stderr, "usage: %s [-aDnpQ] [-C file] [-Tutf8]\n"
-			"       %s [-aDnpQ] [-Tutf8] dir ...\n"
-			"       %s [-DnpQ] [-Tutf8] -d dir [file ...]\n"
+	fprintf(stderr, "usage: %s [-aDnpQs] [-C file] [-j jobs] [-Tutf8]\n"
+			"       %s [-aDnpQs] [-j jobs] [-Tutf8] dir ...\n"
+			"       %s [-DnpQs] [-Tutf8] -d dir [file ...]\n"
 			"       %s [-Dnp] -u dir [file ...]\n"
 			"       %s [-Q] -t file ...\n",
 		        progname, progname, progname, progname, progname);
@@ -575,15 +624,98 @@ fts_compare(const FTSENT **a, const FTSENT **b)
  *   [./]cat<section>[/<arch>]/<name>.0
  *
  * TODO: accommodate for multi-language directories.
+ *
+ * With -j, the directories below the base directory are scanned
+ * by worker processes, each taking every jobs-th directory, such
+ * that the parent can add the files in the same order as without -j.
  */
 static int
 treescan(void)
+{
+	FILE		**fps;
+	pid_t		 *pids;
+	int		  fd[2], ij, jj, rc, saved, status;
+
+	if (jobs == 1)
+		return treewalk(-1, NULL);
+
+	/* Errors from earlier trees must survive a serial rescan. */
+
+	saved = exitcode;
+	pids = mandoc_reallocarray(NULL, jobs, sizeof(*pids));
+	fps = mandoc_reallocarray(NULL, jobs, sizeof(*fps));
+	fflush(stdout);
+	fflush(stderr);
+	for (ij = 0; ij < jobs; ij++) {
+		if (pipe(fd) == -1) {
+			say("", "&pipe");
+			break;
+		}
+		if ((pids[ij] = fork()) == -1) {
+			say("", "&fork");
+			close(fd[0]);
+			close(fd[1]);
+			break;
+		}
+		if (pids[ij] == 0) {
+			close(fd[0]);
+			for (jj = 0; jj < ij; jj++)
+				fclose(fps[jj]);
+			if ((fps[0] = fdopen(fd[1], "w")) == NULL)
+				_exit((int)MANDOCLEVEL_SYSERR);
+			treewalk(ij, fps);
+			if (fclose(fps[0]) == EOF)
+				_exit((int)MANDOCLEVEL_SYSERR);
+			_exit(exitcode);
+		}
+		close(fd[1]);
+		if ((fps[ij] = fdopen(fd[0], "r")) == NULL) {
+			say("", "&fdopen");
+			close(fd[0]);
+			kill(pids[ij], SIGTERM);
+			waitpid(pids[ij], NULL, 0);
+			break;
+		}
+	}
+
+	/* If not all workers could be started, scan serially. */
+
+	rc = ij == jobs ? treewalk(-1, fps) : -1;
+	for (jj = 0; jj < ij; jj++) {
+		fclose(fps[jj]);
+		if (rc != 1)
+			kill(pids[jj], SIGTERM);
+		while (waitpid(pids[jj], &status, 0) == -1 && errno == EINTR)
+			continue;
+		if (rc == 1 && WIFEXITED(status) &&
+		    WEXITSTATUS(status) > exitcode)
+			exitcode = WEXITSTATUS(status);
+	}
+	free(pids);
+	free(fps);
+	if (rc == -1) {
+		exitcode = saved;
+		rc = treewalk(-1, NULL);
+	}
+	return rc;
+}
+
+/*
+ * Walk the tree.  Without -j, job is -1 and fps is NULL.
+ * The parent process is called with job -1 and one stream
+ * per worker; it handles the base directory itself and reads the
+ * contents of each subdirectory from the worker responsible for it.
+ * Workers are called with their number and the stream to write to;
+ * they only handle files in their own subdirectories.
+ * Return 1 on success or 0 on failure.
+ */
+static int
+treewalk(int job, FILE **fps)
 {
 	char		 buf[PATH_MAX];
 	FTS		*f;
 	FTSENT		*ff;
-	struct mlink	*mlink;
-	int		 gzip;
+	int		 gzip, idir, indir;
 	enum form	 dform;
 	char		*dsec, *arch, *fsec, *cp;
 	const char	*path;
@@ -602,9 +734,28 @@ treescan(void)
 
 	dsec = arch = NULL;
 	dform = FORM_NONE;
+	idir = indir = 0;
 
 	while ((ff = fts_read(f)) != NULL) {
 		path = ff->fts_path + 2;
+
+		/*
+		 * A worker leaves everything outside its own
+		 * subdirectories to the parent, and marks the end
+		 * of each of its subdirectories for the parent.
+		 */
+
+		if (job >= 0 && ff->fts_level < 2) {
+			if (indir) {
+				treewalk_put(fps[0], NULL, NULL, NULL,
+				    NULL, NULL, FORM_NONE, 0, NULL);
+				indir = 0;
+			}
+			if (ff->fts_info != FTS_D && ff->fts_info != FTS_DP &&
+			    (ff->fts_info != FTS_DNR || ff->fts_level == 0))
+				continue;
+		}
+
 		switch (ff->fts_info) {
 
 		/*
@@ -687,21 +838,17 @@ treescan(void)
 			} else
 				fsec[-1] = '\0';
 
-			mlink = mandoc_calloc(1, sizeof(struct mlink));
-			if (strlcpy(mlink->file, path,
-			    sizeof(mlink->file)) >=
-			    sizeof(mlink->file)) {
+			if (strlen(path) >= PATH_MAX) {
 				say(path, "Filename too long");
-				free(mlink);
 				continue;
 			}
-			mlink->dform = dform;
-			mlink->dsec = dsec;
-			mlink->arch = arch;
-			mlink->name = ff->fts_name;
-			mlink->fsec = fsec;
-			mlink->gzip = gzip;
-			mlink_add(mlink, ff->fts_statp);
+			if (job >= 0)
+				treewalk_put(fps[0], path, dsec, arch,
+				    ff->fts_name, fsec, dform, gzip,
+				    ff->fts_statp);
+			else
+				mlink_add(path, dsec, arch, ff->fts_name,
+				    fsec, dform, gzip, ff->fts_statp);
 			continue;
 
 		case FTS_D:
@@ -742,12 +889,32 @@ treescan(void)
 				dsec = NULL;
 			}
 
-			if (dsec != NULL || use_all)
+			if (dsec == NULL && ! use_all) {
+				if (warnings && job == -1)
+					say(path, "Unknown directory part");
+				fts_set(f, ff, FTS_SKIP);
+				break;
+			}
+			if (fps == NULL)
 				break;
 
-			if (warnings)
-				say(path, "Unknown directory part");
-			fts_set(f, ff, FTS_SKIP);
+			/*
+			 * With -j, every jobs-th subdirectory
+			 * belongs to the same worker.
+			 */
+
+			if (job == -1) {
+				fts_set(f, ff, FTS_SKIP);
+				if (treescan_read(fps[idir++ % jobs]) == 0) {
+					fts_close(f);
+					return 0;
+				}
+				dform = FORM_NONE;
+				dsec = NULL;
+			} else if (idir++ % jobs == job)
+				indir = 1;
+			else
+				fts_set(f, ff, FTS_SKIP);
 			break;
 		case 2:
 			/*
@@ -769,10 +936,96 @@ treescan(void)
 		}
 	}
 
+	if (indir)
+		treewalk_put(fps[0], NULL, NULL, NULL, NULL, NULL,
+		    FORM_NONE, 0, NULL);
 	fts_close(f);
 	return 1;
 }
 
+/*
+ * In a worker process, send one file to the parent process,
+ * or the end of the current directory if file is NULL.
+ * If the parent cannot be reached, there is no point in going on.
+ */
+static void
+treewalk_put(FILE *fp, const char *file, const char *dsec,
+    const char *arch, const char *name, const char *fsec,
+    enum form dform, int gzip, const struct stat *st)
+{
+	struct scanrec	 rec;
+	const char	*strs[5];
+	int		 i;
+
+	memset(&rec, 0, sizeof(rec));
+	if (file != NULL) {
+		strs[0] = file;
+		strs[1] = dsec == NULL ? "" : dsec;
+		strs[2] = arch == NULL ? "" : arch;
+		strs[3] = name == NULL ? "" : name;
+		strs[4] = fsec == NULL ? "" : fsec;
+		for (i = 0; i < 5; i++)
+			rec.sz += strlen(strs[i]) + 1;
+		rec.inodev.st_ino = st->st_ino;
+		rec.inodev.st_dev = st->st_dev;
+		rec.gzip = gzip;
+		rec.dform = dform;
+	}
+	if (fwrite(&rec, sizeof(rec), 1, fp) != 1)
+		_exit((int)MANDOCLEVEL_SYSERR);
+	for (i = 0; file != NULL && i < 5; i++)
+		if (fwrite(strs[i], strlen(strs[i]) + 1, 1, fp) != 1)
+			_exit((int)MANDOCLEVEL_SYSERR);
+}
+
+/*
+ * In the parent process, add all files of one directory
+ * found by a worker process.
+ */
+static int
+treescan_read(FILE *fp)
+{
+	struct scanrec	 rec;
+	struct stat	 st;
+	char		*buf, *strs[5];
+	size_t		 bufsz;
+	int		 i;
+
+	buf = NULL;
+	bufsz = 0;
+	memset(&st, 0, sizeof(st));
+	for (;;) {
+		if (fread(&rec, sizeof(rec), 1, fp) != 1)
+			break;
+		if (rec.sz == 0) {
+			free(buf);
+			return 1;
+		}
+		if (rec.sz > bufsz) {
+			bufsz = rec.sz;
+			buf = mandoc_realloc(buf, bufsz);
+		}
+		if (fread(buf, rec.sz, 1, fp) != 1 || buf[rec.sz - 1] != '\0')
+			break;
+		strs[0] = buf;
+		for (i = 1; i < 5; i++) {
+			strs[i] = strchr(strs[i - 1], '\0') + 1;
+			if (strs[i] >= buf + rec.sz)
+				break;
+		}
+		if (i < 5)
+			break;
+		st.st_ino = rec.inodev.st_ino;
+		st.st_dev = rec.inodev.st_dev;
+		mlink_add(strs[0], strs[1], strs[2], strs[3], strs[4],
+		    rec.dform, rec.gzip, &st);
+	}
+	free(buf);
+	exitcode = (int)MANDOCLEVEL_SYSERR;
+	say("", "%s", "treescan worker process died");
+	return 0;
+}
+
 /*
  * Add a file to the mlinks table.
  * Do not verify that it's a "valid" looking manpage (we'll do that
@@ -791,8 +1044,9 @@ static void
 filescan(const char *infile)
 {
 	struct stat	 st;
-	struct mlink	*mlink;
-	char		*linkfile, *p, *realdir, *start, *usefile;
+	enum form	 dform;
+	char		*dsec, *arch, *fsec, *name;
+	char		*file, *linkfile, *p, *realdir, *start, *usefile;
 	size_t		 realdir_len;
 
 	assert(use_all);
@@ -913,15 +1167,14 @@ filescan(const char *infile)
 		}
 	} while (/* CONSTCOND */ 0);
 
-	mlink = mandoc_calloc(1, sizeof(struct mlink));
-	mlink->dform = FORM_NONE;
-	if (strlcpy(mlink->file, start, sizeof(mlink->file)) >=
-	    sizeof(mlink->file)) {
+	if (strlen(start) >= PATH_MAX) {
 		say(start, "Filename too long");
-		free(mlink);
 		free(usefile);
 		return;
 	}
+	file = mandoc_strdup(start);
+	dform = FORM_NONE;
+	dsec = arch = fsec = NULL;
 
 	/*
 	 * In test mode or when the original name is absolute
@@ -946,17 +1199,17 @@ filescan(const char *infile)
 	if ((p = strchr(start, '/')) != NULL) {
 		*p++ = '\0';
 		if (strncmp(start, "man", 3) == 0) {
-			mlink->dform = FORM_SRC;
-			mlink->dsec = start + 3;
+			dform = FORM_SRC;
+			dsec = start + 3;
 		} else if (strncmp(start, "cat", 3) == 0) {
-			mlink->dform = FORM_CAT;
-			mlink->dsec = start + 3;
+			dform = FORM_CAT;
+			dsec = start + 3;
 		}
 
 		start = p;
-		if (mlink->dsec != NULL && (p = strchr(start, '/')) != NULL) {
+		if (dsec != NULL && (p = strchr(start, '/')) != NULL) {
 			*p++ = '\0';
-			mlink->arch = start;
+			arch = start;
 			start = p;
 		}
 	}
@@ -971,44 +1224,84 @@ filescan(const char *infile)
 
 	if (*p == '.') {
 		*p++ = '\0';
-		mlink->fsec = p;
+		fsec = p;
 	}
 
 	/*
 	 * Now try to parse the name.
 	 * Use the filename portion of the path.
 	 */
-	mlink->name = start;
+	name = start;
 	if ((p = strrchr(start, '/')) != NULL) {
-		mlink->name = p + 1;
+		name = p + 1;
 		*p = '\0';
 	}
-	mlink_add(mlink, &st);
+	mlink_add(file, dsec, arch, name, fsec, dform, 0, &st);
+	free(file);
 	free(usefile);
 }
 
+/*
+ * Allocate an mlink together with copies of all its strings,
+ * such that trees with many files do not need many allocations.
+ */
 static void
-mlink_add(struct mlink *mlink, const struct stat *st)
+mlink_add(const char *file, const char *dsec, const char *arch,
+    const char *name, const char *fsec, enum form dform, int gzip,
+    const struct stat *st)
 {
 	struct inodev	 inodev;
 	struct mpage	*mpage;
+	struct mlink	*mlink;
+	char		*cp;
+	size_t		 filesz, dsecsz, archsz, namesz, fsecsz;
 	unsigned int	 slot;
 
-	assert(NULL != mlink->file);
-
-	mlink->dsec = mandoc_strdup(mlink->dsec ? mlink->dsec : "");
-	mlink->arch = mandoc_strdup(mlink->arch ? mlink->arch : "");
-	mlink->name = mandoc_strdup(mlink->name ? mlink->name : "");
-	mlink->fsec = mandoc_strdup(mlink->fsec ? mlink->fsec : "");
-
-	if ('0' == *mlink->fsec) {
-		free(mlink->fsec);
-		mlink->fsec = mandoc_strdup(mlink->dsec);
+	assert(NULL != file);
+
+	if (dsec == NULL)
+		dsec = "";
+	if (arch == NULL)
+		arch = "";
+	if (name == NULL)
+		name = "";
+	if (fsec == NULL)
+		fsec = "";
+
+	filesz = strlen(file) + 1;
+	dsecsz = strlen(dsec) + 1;
+	archsz = strlen(arch) + 1;
+	namesz = strlen(name) + 1;
+	fsecsz = *fsec == '0' ? 0 : strlen(fsec) + 1;
+
+	mlink = mandoc_calloc(1, sizeof(*mlink) +
+	    filesz + dsecsz + archsz + namesz + fsecsz);
+	cp = mlink->file;
+	memcpy(cp, file, filesz);
+	cp += filesz;
+	mlink->dsec = cp;
+	memcpy(cp, dsec, dsecsz);
+	cp += dsecsz;
+	mlink->arch = cp;
+	memcpy(cp, arch, archsz);
+	cp += archsz;
+	mlink->name = cp;
+	memcpy(cp, name, namesz);
+	cp += namesz;
+	mlink->dform = dform;
+	mlink->gzip = gzip;
+
+	if ('0' == *fsec) {
+		mlink->fsec = mlink->dsec;
 		mlink->fform = FORM_CAT;
-	} else if ('1' <= *mlink->fsec && '9' >= *mlink->fsec)
-		mlink->fform = FORM_SRC;
-	else
-		mlink->fform = FORM_NONE;
+	} else {
+		mlink->fsec = cp;
+		memcpy(cp, fsec, fsecsz);
+		if ('1' <= *fsec && '9' >= *fsec)
+			mlink->fform = FORM_SRC;
+		else
+			mlink->fform = FORM_NONE;
+	}
 
 	slot = ohash_qlookup(&mlinks, mlink->file);
 	assert(NULL == ohash_find(&mlinks, slot));
@@ -1034,17 +1327,6 @@ mlink_add(struct mlink *mlink, const struct stat *st)
 	mlink->mpage = mpage;
 }
 
-static void
-mlink_free(struct mlink *mlink)
-{
-
-	free(mlink->dsec);
-	free(mlink->arch);
-	free(mlink->name);
-	free(mlink->fsec);
-	free(mlink);
-}
-
 static void
 mpages_free(void)
 {
@@ -1054,7 +1336,7 @@ mpages_free(void)
 	while ((mpage = mpage_head) != NULL) {
 		while ((mlink = mpage->mlinks) != NULL) {
 			mpage->mlinks = mlink->next;
-			mlink_free(mlink);
+			free(mlink);
 		}
 		mpage_head = mpage->next;
 		free(mpage->sec);
@@ -1101,7 +1383,7 @@ mlinks_undupe(struct mpage *mpage)
 		if (use_all)
 			goto nextlink;
 		*prev = mlink->next;
-		mlink_free(mlink);
+		free(mlink);
 		continue;
 nextlink:
 		prev = &(*prev)->next;
@@ -1179,12 +1461,21 @@ mpages_merge(struct dba *dba, struct mparse *mp)
 	struct mlink		*mlink, *mlink_dest;
 	struct roff_meta	*meta;
 	char			*cp;
-	int			 fd;
+	unsigned int		 slot;
+	int			 fd, shared;
+
+	if (share)
+		mandoc_ohash_init(&contents, 6,
+		    offsetof(struct mpage, content));
 
 	for (mpage = mpage_head; mpage != NULL; mpage = mpage->next) {
 		mlinks_undupe(mpage);
-		if ((mlink = mpage->mlinks) == NULL)
+		if (mpage->mlinks == NULL)
+			continue;
+		shared = share ? mpage_share(mpage) : -1;
+		if (shared == 1)
 			continue;
+		mlink = mpage->mlinks;
 
 		name_mask = NAME_MASK;
 		mandoc_ohash_init(&names, 4, offsetof(struct str, key));
@@ -1301,10 +1592,131 @@ mpages_merge(struct dba *dba, struct mparse *mp)
 
 		dbadd(dba, mpage);
 
+		/*
+		 * Only remember pages that made it into the database,
+		 * such that later copies can be added to them.
+		 */
+
+		if (shared == 0 && mpage->dba != NULL) {
+			slot = ohash_lookup_memory(&contents,
+			    (char *)&mpage->content, sizeof(struct content),
+			    (uint32_t)mpage->content.hash);
+			if (ohash_find(&contents, slot) == NULL)
+				ohash_insert(&contents, slot, mpage);
+		}
+
 nextpage:
 		ohash_delete(&strings);
 		ohash_delete(&names);
 	}
+	if (share)
+		ohash_delete(&contents);
+}
+
+/*
+ * With -s, check whether an earlier page has exactly the same
+ * content, after decompression.  If so, treat the links to this
+ * page like hard links to the earlier page, such that the file
+ * is not parsed again, and return 1.  Return 0 for new content
+ * and -1 if the file cannot be read.
+ */
+static int
+mpage_share(struct mpage *mpage)
+{
+	struct mpage	*mpage_dest;
+	struct mlink	*mlink;
+	char		*buf, *obuf;
+	size_t		 i, sz, osz;
+	uint64_t	 hash;
+	unsigned int	 slot;
+	int		 same;
+
+	mlink = mpage->mlinks;
+	if (read_content(mlink->file, &buf, &sz) == 0)
+		return -1;
+
+	/* 64-bit FNV-1a. */
+
+	hash = 0xcbf29ce484222325ULL;
+	for (i = 0; i < sz; i++) {
+		hash ^= (unsigned char)buf[i];
+		hash *= 0x100000001b3ULL;
+	}
+	memset(&mpage->content, 0, sizeof(mpage->content));
+	mpage->content.hash = hash;
+	mpage->content.sz = sz;
+
+	slot = ohash_lookup_memory(&contents, (char *)&mpage->content,
+	    sizeof(struct content), (uint32_t)hash);
+	if ((mpage_dest = ohash_find(&contents, slot)) == NULL) {
+		free(buf);
+		return 0;
+	}
+
+	/* Guard against hash collisions. */
+
+	same = 0;
+	if (read_content(mpage_dest->mlinks->file, &obuf, &osz)) {
+		same = osz == sz && memcmp(obuf, buf, sz) == 0;
+		free(obuf);
+	}
+	free(buf);
+	if (same == 0)
+		return 0;
+
+	if (debug)
+		say(mlink->file, "Same content as %s",
+		    mpage_dest->mlinks->file);
+
+	/* Add the links to the database and move them to the target. */
+
+	while (1) {
+		mlink->mpage = mpage_dest;
+		dbadd_mlink(mlink);
+		if (mlink->next == NULL)
+			break;
+		mlink = mlink->next;
+	}
+	mlink->next = mpage_dest->mlinks->next;
+	mpage_dest->mlinks->next = mpage->mlinks;
+	mpage->mlinks = NULL;
+	return 1;
+}
+
+/*
+ * Read a whole file, decompressing it if it is gzipped.
+ */
+static int
+read_content(const char *file, char **buf, size_t *sz)
+{
+	gzFile		 gz;
+	size_t		 bufsz;
+	int		 gzerrnum, ret;
+
+	if ((gz = gzopen(file, "rb")) == NULL) {
+		say(file, "&gzopen");
+		return 0;
+	}
+	*buf = NULL;
+	*sz = bufsz = 0;
+	for (;;) {
+		if (*sz == bufsz) {
+			bufsz = bufsz == 0 ? 65536 : bufsz * 2;
+			*buf = mandoc_realloc(*buf, bufsz);
+		}
+		ret = gzread(gz, *buf + *sz, bufsz - *sz);
+		if (ret <= 0)
+			break;
+		*sz += ret;
+	}
+	if (ret < 0) {
+		(void)gzerror(gz, &gzerrnum);
+		say(file, "gzread: %s", gzerrnum == Z_ERRNO ?
+		    strerror(errno) : zError(gzerrnum));
+		free(*buf);
+	}
+	gzclose(gz);
+	return ret == 0;
 }
 
 static void
@@ -142,9 +142,11 @@ manconf_free(struct manconf *conf)
 		free(conf->manpath.paths[i]);
 
 	free(conf->manpath.paths);
+	free(conf->output.cache);
 	free(conf->output.includes);
 	free(conf->output.man);
 	free(conf->output.paper);
+	free(conf->output.site);
 	free(conf->output.style);
 }
 
@@ -214,11 +216,11 @@ manconf_output(struct manoutput *conf, const char *cp, int fromfile)
 	const char *const toks[] = {
 	    /* Tokens requiring an argument. */
 	    "includes", "man", "paper", "style", "indent", "width",
-	    "outfilename", "tagfilename",
+	    "outfilename", "tagfilename", "cache", "site",
 	    /* Token taking an optional argument. */
 	    "tag",
 	    /* Tokens not taking arguments. */
-	    "fragment", "mdoc", "noval", "toc"
+	    "compress", "fragment", "mdoc", "noval", "stream", "toc"
 	};
 	const size_t ntoks = sizeof(toks) / sizeof(toks[0]);
 
@@ -239,11 +241,11 @@ manconf_output(struct manoutput *conf, const char *cp, int fromfile)
 		}
 	}
 
-	if (tok < 8 && *cp == '\0') {
+	if (tok < 10 && *cp == '\0') {
 		mandoc_msg(MANDOCERR_BADVAL_MISS, 0, 0, "-O %s=?", toks[tok]);
 		return -1;
 	}
-	if (tok > 8 && tok < ntoks && *cp != '\0') {
+	if (tok > 10 && tok < ntoks && *cp != '\0') {
 		mandoc_msg(MANDOCERR_BADVAL, 0, 0, "-O %s=%s", toks[tok], cp);
 		return -1;
 	}
@@ -313,27 +315,49 @@ manconf_output(struct manoutput *conf, const char *cp, int fromfile)
 		}
 		conf->tagfilename = mandoc_strdup(cp);
 		return 0;
+	case 8:
+		if (conf->cache != NULL) {
+			oldval = mandoc_strdup(conf->cache);
+			break;
+		}
+		conf->cache = mandoc_strdup(cp);
+		return 0;
+	case 9:
+		if (fromfile)	/* Only valid on the command line. */
+			return 0;
+		if (conf->site != NULL) {
+			oldval = mandoc_strdup(conf->site);
+			break;
+		}
+		conf->site = mandoc_strdup(cp);
+		return 0;
 	/*
 	 * If the index of the following token changes,
 	 * do not forget to adjust the range check above the switch.
 	 */
-	case 8:
+	case 10:
 		if (conf->tag != NULL) {
 			oldval = mandoc_strdup(conf->tag);
 			break;
 		}
 		conf->tag = mandoc_strdup(cp);
 		return 0;
-	case 9:
+	case 11:
+		conf->compress = 1;
+		return 0;
+	case 12:
 		conf->fragment = 1;
 		return 0;
-	case 10:
+	case 13:
 		conf->mdoc = 1;
 		return 0;
-	case 11:
+	case 14:
 		conf->noval = 1;
 		return 0;
-	case 12:
+	case 15:
+		conf->stream = 1;
+		return 0;
+	case 16:
 		conf->toc = 1;
 		return 0;
 	default:
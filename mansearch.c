@@ -18,7 +18,11 @@
 #include "config.h"
 
 #include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
+#include <sys/un.h>
 
 #include <assert.h>
 #if HAVE_ERR
@@ -28,12 +32,15 @@
 #include <fcntl.h>
 #include <glob.h>
 #include <limits.h>
+#include <poll.h>
 #include <regex.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "mandoc_aux.h"
@@ -52,6 +59,30 @@ struct	expr {
 	enum { EXPR_TERM, EXPR_OR, EXPR_AND } type;
 };
 
+/*
+ * A message exchanged with the search server: a sequence of
+ * NUL-terminated strings, preceded on the wire by its length.
+ */
+struct	msg {
+	char		*buf;
+	size_t		 sz;      /* Bytes used. */
+	size_t		 maxsz;   /* Bytes allocated. */
+	size_t		 pos;     /* Read position. */
+};
+
+/*
+ * A connection to the search server, either reading a request
+ * or writing a reply, each preceded by its length.
+ */
+struct	conn {
+	struct msg	 in;      /* Request being read. */
+	struct msg	 out;     /* Reply being written. */
+	time_t		 last;    /* Time of the last progress. */
+};
+
+#define	MSG_MAX		(64 * 1024 * 1024)  /* Maximum message size. */
+#define	SOCK_TIMEOUT	10  /* Seconds to wait for the other side. */
+
 const char *const mansearch_keynames[KEY_MAX] = {
 	"arch",	"sec",	"Xr",	"Ar",	"Fa",	"Fl",	"Dv",	"Fn",
 	"Ic",	"Pa",	"Cm",	"Li",	"Em",	"Cd",	"Va",	"Ft",
@@ -78,6 +109,23 @@ static	struct expr	*exprterm(const struct mansearch *,
 				int, char *[], int *);
 static	void		 exprfree(struct expr *);
 static	int		 manpage_compare(const void *, const void *);
+static	int		 mansearch_remote(const struct mansearch *,
+				const struct manpaths *, int, char *[],
+				struct manpage **, size_t *);
+static	int		 mansearch_io(struct pollfd *, struct conn *);
+static	int		 mansearch_answer(struct msg *, struct msg *);
+static	void		 msg_puts(struct msg *, const char *);
+static	void		 msg_putopt(struct msg *, const char *);
+static	void		 msg_putnum(struct msg *, unsigned long long);
+static	const char	*msg_gets(struct msg *);
+static	const char	*msg_getopt(struct msg *, int *);
+static	int		 msg_getnum(struct msg *, unsigned long long,
+				unsigned long long *);
+static	int		 msg_send(int, const struct msg *);
+static	int		 msg_recv(int, struct msg *);
+static	int		 sock_io(int, void *, size_t, int);
+
+static	int		 server_fd = -1;  /* Client connection. */
 
 
 int
@@ -96,6 +144,10 @@ mansearch(const struct mansearch *search,
 	unsigned int	 slot;
 	int		 argi, chdir_status, getcwd_status, im;
 
+	if (server_fd != -1 &&
+	    (im = mansearch_remote(search, paths, argc, argv, res, sz)) != -1)
+		return im;
+
 	argi = 0;
 	if ((e = exprcomp(search, argc, argv, &argi)) == NULL) {
 		*sz = 0;
@@ -849,3 +901,582 @@ exprfree(struct expr *e)
 		exprfree(e->child);
 	free(e);
 }
+
+
+/*** search server ****************************************************/
+
+/*
+ * Connect to a search server started with mansearch_serve().
+ * On success, later calls to mansearch() ask the server first
+ * and only fall back to searching themselves if that fails.
+ * Return 0 on success or -1 if no server is available.
+ */
+int
+mansearch_connect(const char *path)
+{
+	struct sockaddr_un	 sun;
+	struct timeval		 tv;
+	int			 fd;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if (strlcpy(sun.sun_path, path, sizeof(sun.sun_path)) >=
+	    sizeof(sun.sun_path))
+		return -1;
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+		return -1;
+	tv.tv_sec = SOCK_TIMEOUT;
+	tv.tv_usec = 0;
+	if (connect(fd, (struct sockaddr *)&sun, sizeof(sun)) == -1 ||
+	    fcntl(fd, F_SETFD, FD_CLOEXEC) == -1 ||
+	    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == -1) {
+		close(fd);
+		return -1;
+	}
+	if (server_fd != -1)
+		close(server_fd);
+	server_fd = fd;
+	return 0;
+}
+
+/*
+ * Ask the search server to run the query.
+ * Return -1 if it cannot, such that the caller searches itself,
+ * otherwise the return value of mansearch().
+ */
+static int
+mansearch_remote(const struct mansearch *search,
+	const struct manpaths *paths, int argc, char *argv[],
+	struct manpage **res, size_t *sz)
+{
+	struct msg		 msg;
+	struct manpage		*mpage;
+	const char		*cp;
+	unsigned long long	 num;
+	size_t			 cur, i;
+	int			 irc;
+
+	/* The server does not know our working directory. */
+
+	for (i = 0; i < paths->sz; i++)
+		if (paths->paths[i][0] != '/')
+			return -1;
+
+	memset(&msg, 0, sizeof(msg));
+	msg_putnum(&msg, search->argmode);
+	msg_putnum(&msg, search->firstmatch);
+	msg_putnum(&msg, res != NULL);
+	msg_putopt(&msg, search->arch);
+	msg_putopt(&msg, search->sec);
+	msg_putopt(&msg, search->outkey);
+	msg_putnum(&msg, paths->sz);
+	for (i = 0; i < paths->sz; i++)
+		msg_puts(&msg, paths->paths[i]);
+	msg_putnum(&msg, argc);
+	for (i = 0; i < (size_t)argc; i++)
+		msg_puts(&msg, argv[i]);
+	irc = msg_send(server_fd, &msg);
+	free(msg.buf);
+	memset(&msg, 0, sizeof(msg));
+	if (irc == -1 || msg_recv(server_fd, &msg) == -1)
+		goto fail;
+
+	/*
+	 * If the server could not parse the expression,
+	 * search locally to show the error messages to the user.
+	 */
+
+	if (msg_getnum(&msg, 1, &num) == -1 ||
+	    (res != NULL && num == 0)) {
+		free(msg.buf);
+		return -1;
+	}
+	irc = num;
+	if (msg_getnum(&msg, res == NULL ? 1 : MSG_MAX, &num) == -1)
+		goto fail;
+	*sz = num;
+	if (res == NULL) {
+		free(msg.buf);
+		return irc;
+	}
+	*res = num == 0 ? NULL :
+	    mandoc_reallocarray(NULL, num, sizeof(**res));
+	for (cur = 0; cur < *sz; cur++) {
+		mpage = *res + cur;
+		memset(mpage, 0, sizeof(*mpage));
+		if ((cp = msg_gets(&msg)) == NULL)
+			goto fail_res;
+		mpage->file = mandoc_strdup(cp);
+		if ((cp = msg_gets(&msg)) == NULL)
+			goto fail_res;
+		mpage->names = mandoc_strdup(cp);
+		if ((cp = msg_getopt(&msg, &irc)) == NULL && irc == -1)
+			goto fail_res;
+		if (cp != NULL)
+			mpage->output = mandoc_strdup(cp);
+		if (msg_getnum(&msg, UINT64_MAX, &num) == -1)
+			goto fail_res;
+		mpage->bits = num;
+		if (paths->sz == 0 ||
+		    msg_getnum(&msg, paths->sz - 1, &num) == -1)
+			goto fail_res;
+		mpage->ipath = num;
+		if (msg_getnum(&msg, 10, &num) == -1)
+			goto fail_res;
+		mpage->sec = num;
+		if (msg_getnum(&msg, FORM_NONE, &num) == -1 || num == 0)
+			goto fail_res;
+		mpage->form = num;
+	}
+	free(msg.buf);
+	return 1;
+
+fail_res:
+	mansearch_free(*res, cur + 1);
+	*res = NULL;
+fail:
+	free(msg.buf);
+	close(server_fd);
+	server_fd = -1;
+	return -1;
+}
+
+/*
+ * Answer search requests on the Unix domain socket at path,
+ * keeping all databases mapped between requests.
+ * Connections are non-blocking, such that a slow client
+ * cannot delay the answers to other clients, and connections
+ * making no progress for SOCK_TIMEOUT seconds are closed.
+ * Only return in case of errors.
+ */
+int
+mansearch_serve(const char *path)
+{
+	struct sockaddr_un	 sun;
+	struct stat		 sb;
+	struct pollfd		*pfd;
+	struct conn		*conn;
+	size_t			 i, pfdsz, pfdmax;
+	time_t			 now, paused, wake;
+	mode_t			 omask;
+	int			 fd, sfd, timeout;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if (strlcpy(sun.sun_path, path, sizeof(sun.sun_path)) >=
+	    sizeof(sun.sun_path)) {
+		warnx("%s: socket path too long", path);
+		return -1;
+	}
+	if (lstat(path, &sb) == 0 && S_ISSOCK(sb.st_mode) &&
+	    unlink(path) == -1) {
+		warn("%s", path);
+		return -1;
+	}
+	if ((sfd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		warn("socket");
+		return -1;
+	}
+	omask = umask(0077);
+	if (bind(sfd, (struct sockaddr *)&sun, sizeof(sun)) == -1) {
+		warn("%s", path);
+		umask(omask);
+		close(sfd);
+		return -1;
+	}
+	umask(omask);
+	if (fcntl(sfd, F_SETFL, O_NONBLOCK) == -1 ||
+	    listen(sfd, SOMAXCONN) == -1) {
+		warn("listen");
+		close(sfd);
+		return -1;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	dbm_keep(1);
+	pfdmax = 8;
+	pfd = mandoc_reallocarray(NULL, pfdmax, sizeof(*pfd));
+	conn = mandoc_reallocarray(NULL, pfdmax, sizeof(*conn));
+	pfd[0].fd = sfd;
+	pfd[0].events = POLLIN;
+	pfdsz = 1;
+	paused = 0;
+
+	for (;;) {
+		/* Wake up when accepting resumes or a connection expires. */
+
+		now = time(NULL);
+		wake = paused;
+		for (i = 1; i < pfdsz; i++)
+			if (wake == 0 || conn[i].last + SOCK_TIMEOUT < wake)
+				wake = conn[i].last + SOCK_TIMEOUT;
+		timeout = wake == 0 ? -1 : wake <= now ? 0 :
+		    (int)(wake - now) * 1000;
+		if (poll(pfd, pfdsz, timeout) == -1) {
+			if (errno == EINTR)
+				continue;
+			warn("poll");
+			break;
+		}
+		now = time(NULL);
+		if (paused != 0 && now >= paused) {
+			pfd[0].events = POLLIN;
+			paused = 0;
+		}
+
+		/* Serve ready connections, drop closed and stuck ones. */
+
+		for (i = 1; i < pfdsz; i++) {
+			if (pfd[i].revents != 0) {
+				if (mansearch_io(pfd + i, conn + i) == 0) {
+					conn[i].last = now;
+					continue;
+				}
+			} else if (now < conn[i].last + SOCK_TIMEOUT)
+				continue;
+			close(pfd[i].fd);
+			free(conn[i].in.buf);
+			free(conn[i].out.buf);
+			pfdsz--;
+			pfd[i] = pfd[pfdsz];
+			conn[i] = conn[pfdsz];
+			i--;
+		}
+
+		if ((pfd[0].revents & POLLIN) == 0)
+			continue;
+		if ((fd = accept(sfd, NULL, NULL)) == -1) {
+			if (errno == EMFILE || errno == ENFILE) {
+				/* Wait a second for connections to close. */
+				warn("accept");
+				pfd[0].events = 0;
+				paused = now + 1;
+			} else if (errno != EINTR && errno != ECONNABORTED &&
+			    errno != EAGAIN && errno != EWOULDBLOCK)
+				warn("accept");
+			continue;
+		}
+		if (fcntl(fd, F_SETFL, O_NONBLOCK) == -1) {
+			warn("fcntl");
+			close(fd);
+			continue;
+		}
+		if (pfdsz == pfdmax) {
+			pfdmax *= 2;
+			pfd = mandoc_reallocarray(pfd, pfdmax, sizeof(*pfd));
+			conn = mandoc_reallocarray(conn, pfdmax,
+			    sizeof(*conn));
+		}
+		pfd[pfdsz].fd = fd;
+		pfd[pfdsz].events = POLLIN;
+		pfd[pfdsz].revents = 0;
+		memset(conn + pfdsz, 0, sizeof(*conn));
+		conn[pfdsz].last = now;
+		pfdsz++;
+	}
+
+	for (i = 1; i < pfdsz; i++) {
+		close(pfd[i].fd);
+		free(conn[i].in.buf);
+		free(conn[i].out.buf);
+	}
+	free(conn);
+	free(pfd);
+	close(sfd);
+	dbm_keep(0);
+	return -1;
+}
+
+/*
+ * Continue reading a request from a client or writing the reply,
+ * whichever the connection is waiting for.  Once a request is
+ * complete, answer it and switch to writing; once the reply is
+ * written, switch back to reading.
+ * Return -1 if the connection is to be closed.
+ */
+static int
+mansearch_io(struct pollfd *pfd, struct conn *conn)
+{
+	struct msg	*msg;
+	uint32_t	 len;
+	size_t		 want;
+	ssize_t		 nb;
+
+	if (pfd->revents & (POLLERR | POLLNVAL))
+		return -1;
+
+	if (pfd->events & POLLOUT) {
+		msg = &conn->out;
+		nb = write(pfd->fd, msg->buf + msg->pos, msg->sz - msg->pos);
+		if (nb == -1)
+			return errno == EAGAIN || errno == EWOULDBLOCK ||
+			    errno == EINTR ? 0 : -1;
+		msg->pos += nb;
+		if (msg->pos < msg->sz)
+			return 0;
+		free(msg->buf);
+		memset(msg, 0, sizeof(*msg));
+		pfd->events = POLLIN;
+		return 0;
+	}
+
+	/*
+	 * Read the length first, then the rest of the message,
+	 * but never beyond its end.
+	 */
+
+	msg = &conn->in;
+	if (msg->buf == NULL) {
+		msg->maxsz = sizeof(len);
+		msg->buf = mandoc_malloc(msg->maxsz);
+	}
+	want = msg->maxsz - msg->sz;
+	nb = read(pfd->fd, msg->buf + msg->sz, want);
+	if (nb == -1)
+		return errno == EAGAIN || errno == EWOULDBLOCK ||
+		    errno == EINTR ? 0 : -1;
+	if (nb == 0)
+		return -1;
+	msg->sz += nb;
+	if (msg->sz == sizeof(len) && msg->maxsz == sizeof(len)) {
+		memcpy(&len, msg->buf, sizeof(len));
+		if (len > MSG_MAX)
+			return -1;
+		msg->maxsz += len;
+		msg->buf = mandoc_realloc(msg->buf, msg->maxsz);
+	}
+	if (msg->sz < msg->maxsz)
+		return 0;
+
+	msg->pos = sizeof(len);
+	if (mansearch_answer(msg, &conn->out) == -1)
+		return -1;
+	free(msg->buf);
+	memset(msg, 0, sizeof(*msg));
+	pfd->events = POLLOUT;
+	return 0;
+}
+
+/*
+ * Run the search requested in the complete message req
+ * and store the result in reply, including its length.
+ * Return -1 if the request is malformed.
+ */
+static int
+mansearch_answer(struct msg *req, struct msg *reply)
+{
+	struct mansearch	 search;
+	struct manpaths		 paths;
+	struct manpage		*res;
+	char			**argv;
+	unsigned long long	 num;
+	size_t			 i, ressz;
+	uint32_t		 len;
+	int			 argc, irc, wantres;
+
+	argv = NULL;
+	paths.paths = NULL;
+	irc = -1;
+	memset(&search, 0, sizeof(search));
+	if (msg_getnum(req, ARG_EXPR, &num) == -1)
+		goto out;
+	search.argmode = num;
+	if (msg_getnum(req, 1, &num) == -1)
+		goto out;
+	search.firstmatch = num;
+	if (msg_getnum(req, 1, &num) == -1)
+		goto out;
+	wantres = num;
+	if ((search.arch = msg_getopt(req, &irc)) == NULL && irc == -1)
+		goto out;
+	if ((search.sec = msg_getopt(req, &irc)) == NULL && irc == -1)
+		goto out;
+	if ((search.outkey = msg_getopt(req, &irc)) == NULL && irc == -1)
+		goto out;
+	irc = -1;
+
+	/* Each string takes at least one byte: check before allocating. */
+
+	if (msg_getnum(req, MSG_MAX, &num) == -1 ||
+	    num > req->sz - req->pos)
+		goto out;
+	paths.sz = num;
+	paths.paths = mandoc_reallocarray(NULL, paths.sz + 1,
+	    sizeof(*paths.paths));
+	for (i = 0; i < paths.sz; i++)
+		if ((paths.paths[i] = (char *)msg_gets(req)) == NULL)
+			goto out;
+	if (msg_getnum(req, MSG_MAX, &num) == -1 || num == 0 ||
+	    num > req->sz - req->pos)
+		goto out;
+	argc = num;
+	argv = mandoc_reallocarray(NULL, argc + 1, sizeof(*argv));
+	for (i = 0; i < (size_t)argc; i++)
+		if ((argv[i] = (char *)msg_gets(req)) == NULL)
+			goto out;
+	argv[argc] = NULL;
+
+	res = NULL;
+	ressz = 0;
+	irc = mansearch(&search, &paths, argc, argv,
+	    wantres ? &res : NULL, &ressz);
+
+	/* Leave room for the length in front of the reply. */
+
+	memset(reply, 0, sizeof(*reply));
+	reply->sz = reply->maxsz = sizeof(len);
+	reply->buf = mandoc_malloc(reply->maxsz);
+	msg_putnum(reply, irc);
+	msg_putnum(reply, ressz);
+	for (i = 0; wantres && i < ressz; i++) {
+		msg_puts(reply, res[i].file);
+		msg_puts(reply, res[i].names);
+		msg_putopt(reply, res[i].output);
+		msg_putnum(reply, res[i].bits);
+		msg_putnum(reply, res[i].ipath);
+		msg_putnum(reply, res[i].sec);
+		msg_putnum(reply, res[i].form);
+	}
+	if (wantres)
+		mansearch_free(res, ressz);
+	len = reply->sz - sizeof(len);
+	memcpy(reply->buf, &len, sizeof(len));
+	irc = 0;
+
+out:
+	free(argv);
+	free(paths.paths);
+	return irc == -1 ? -1 : 0;
+}
+
+static void
+msg_puts(struct msg *msg, const char *cp)
+{
+	size_t	 sz;
+
+	sz = strlen(cp) + 1;
+	if (msg->sz + sz > msg->maxsz) {
+		msg->maxsz = msg->sz + sz + 1024;
+		msg->buf = mandoc_realloc(msg->buf, msg->maxsz);
+	}
+	memcpy(msg->buf + msg->sz, cp, sz);
+	msg->sz += sz;
+}
+
+/*
+ * Strings that may be NULL are prefixed with "+", NULL is sent as "-".
+ */
+static void
+msg_putopt(struct msg *msg, const char *cp)
+{
+	char	*buf;
+
+	if (cp == NULL) {
+		msg_puts(msg, "-");
+		return;
+	}
+	mandoc_asprintf(&buf, "+%s", cp);
+	msg_puts(msg, buf);
+	free(buf);
+}
+
+static void
+msg_putnum(struct msg *msg, unsigned long long num)
+{
+	char	 buf[24];
+
+	(void)snprintf(buf, sizeof(buf), "%llu", num);
+	msg_puts(msg, buf);
+}
+
+static const char *
+msg_gets(struct msg *msg)
+{
+	const char	*cp, *ep;
+
+	cp = msg->buf + msg->pos;
+	if (msg->pos >= msg->sz ||
+	    (ep = memchr(cp, '\0', msg->sz - msg->pos)) == NULL)
+		return NULL;
+	msg->pos += ep - cp + 1;
+	return cp;
+}
+
+/*
+ * Return the string or NULL; in the latter case, set *irc
+ * to 0 if NULL was sent or to -1 if the message is malformed.
+ */
+static const char *
+msg_getopt(struct msg *msg, int *irc)
+{
+	const char	*cp;
+
+	*irc = -1;
+	if ((cp = msg_gets(msg)) == NULL)
+		return NULL;
+	if (*cp == '+')
+		return cp + 1;
+	if (strcmp(cp, "-") == 0)
+		*irc = 0;
+	return NULL;
+}
+
+static int
+msg_getnum(struct msg *msg, unsigned long long max,
+	unsigned long long *num)
+{
+	const char	*cp;
+	char		*ep;
+
+	if ((cp = msg_gets(msg)) == NULL || *cp < '0' || *cp > '9')
+		return -1;
+	errno = 0;
+	*num = strtoull(cp, &ep, 10);
+	return errno != 0 || *ep != '\0' || *num > max ? -1 : 0;
+}
+
+static int
+msg_send(int fd, const struct msg *msg)
+{
+	uint32_t	 sz;
+
+	sz = msg->sz;
+	return sock_io(fd, &sz, sizeof(sz), 1) == -1 ||
+	    sock_io(fd, msg->buf, msg->sz, 1) == -1 ? -1 : 0;
+}
+
+static int
+msg_recv(int fd, struct msg *msg)
+{
+	uint32_t	 sz;
+
+	if (sock_io(fd, &sz, sizeof(sz), 0) == -1 || sz > MSG_MAX)
+		return -1;
+	msg->sz = msg->maxsz = sz;
+	msg->pos = 0;
+	msg->buf = mandoc_malloc(sz + 1);
+	return sock_io(fd, msg->buf, sz, 0);
+}
+
+/*
+ * Write or read exactly sz bytes, depending on the last argument.
+ */
+static int
+sock_io(int fd, void *buf, size_t sz, int out)
+{
+	ssize_t	 nb;
+
+	while (sz > 0) {
+		nb = out ? write(fd, buf, sz) : read(fd, buf, sz);
+		if (nb == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (nb == 0)
+			return -1;
+		buf = (char *)buf + nb;
+		sz -= nb;
+	}
+	return 0;
+}
@@ -116,3 +116,5 @@ int	mansearch(const struct mansearch *cfg, /* options */
 		struct manpage **res, /* results */
 		size_t *ressz); /* results returned */
 void	mansearch_free(struct manpage *, size_t);
+int	mansearch_connect(const char *);
+int	mansearch_serve(const char *);
@@ -681,7 +681,7 @@ mdoc_xr_pre(MDOC_ARGS)
 	} else
 		section = label = NULL;
 
-	if (h->base_man1)
+	if (html_manlink(h, name, section))
 		print_otag(h, TAG_A, "chM?", "Xr",
 		    name, section, "aria-label", label);
 	else
@@ -266,6 +266,8 @@ static const struct mdoc_man_act mdoc_man_acts[MDOC_MAX - MDOC_Dd] = {
 };
 static const struct mdoc_man_act *mdoc_man_act(enum roff_tok);
 
+static	FILE		*outfp;	/* output stream */
+
 static	int		outflags;
 #define	MMAN_spc	(1 << 0)  /* blank character before next word */
 #define	MMAN_spc_force	(1 << 1)  /* even before trailing punctuation */
@@ -357,8 +359,8 @@ font_push(char newfont)
 	}
 	*fontqueue.tail = newfont;
 	print_word("");
-	printf("\\f");
-	putchar(newfont);
+	fprintf(outfp, "\\f");
+	putc(newfont, outfp);
 	outflags &= ~MMAN_spc;
 }
 
@@ -370,8 +372,8 @@ font_pop(void)
 		fontqueue.tail--;
 	outflags &= ~MMAN_spc;
 	print_word("");
-	printf("\\f");
-	putchar(*fontqueue.tail);
+	fprintf(outfp, "\\f");
+	putc(*fontqueue.tail, outfp);
 }
 
 static void
@@ -385,23 +387,23 @@ print_word(const char *s)
 		if (MMAN_PP & outflags) {
 			if (MMAN_sp & outflags) {
 				if (MMAN_PD & outflags) {
-					printf("\n.PD");
+					fprintf(outfp, "\n.PD");
 					outflags &= ~MMAN_PD;
 				}
 			} else if ( ! (MMAN_PD & outflags)) {
-				printf("\n.PD 0");
+				fprintf(outfp, "\n.PD 0");
 				outflags |= MMAN_PD;
 			}
-			printf("\n.PP\n");
+			fprintf(outfp, "\n.PP\n");
 		} else if (MMAN_sp & outflags)
-			printf("\n.sp\n");
+			fprintf(outfp, "\n.sp\n");
 		else if (MMAN_br & outflags)
-			printf("\n.br\n");
+			fprintf(outfp, "\n.br\n");
 		else if (MMAN_nl & outflags)
-			putchar('\n');
+			putc('\n', outfp);
 		outflags &= ~(MMAN_PP|MMAN_sp|MMAN_br|MMAN_nl|MMAN_spc);
 		if (1 == TPremain)
-			printf(".br\n");
+			fprintf(outfp, ".br\n");
 		TPremain = 0;
 	} else if (MMAN_spc & outflags) {
 		/*
@@ -414,8 +416,8 @@ print_word(const char *s)
 		    NULL == strchr(".,:;)]?!", s[0]) || '\0' != s[1]) {
 			if (MMAN_Bk & outflags &&
 			    ! (MMAN_Bk_susp & outflags))
-				putchar('\\');
-			putchar(' ');
+				putc('\\', outfp);
+			putc(' ', outfp);
 			if (TPremain)
 				TPremain--;
 		}
@@ -435,22 +437,22 @@ print_word(const char *s)
 	for ( ; *s; s++) {
 		switch (*s) {
 		case ASCII_NBRSP:
-			printf("\\ ");
+			fprintf(outfp, "\\ ");
 			break;
 		case ASCII_HYPH:
-			putchar('-');
+			putc('-', outfp);
 			break;
 		case ASCII_BREAK:
-			printf("\\:");
+			fprintf(outfp, "\\:");
 			break;
 		case ' ':
 			if (MMAN_nbrword & outflags) {
-				printf("\\ ");
+				fprintf(outfp, "\\ ");
 				break;
 			}
 			/* FALLTHROUGH */
 		default:
-			putchar((unsigned char)*s);
+			putc((unsigned char)*s, outfp);
 			break;
 		}
 		if (TPremain)
@@ -610,20 +612,21 @@ man_mdoc(void *arg, const struct roff_meta *mdoc)
 {
 	struct roff_node *n;
 
-	printf(".\\\" Automatically generated from an mdoc input file."
+	outfp = arg == NULL ? stdout : arg;
+	fprintf(outfp, ".\\\" Automatically generated from an mdoc input file."
 	    "  Do not edit.\n");
 	for (n = mdoc->first->child; n != NULL; n = n->next) {
 		if (n->type != ROFFT_COMMENT)
 			break;
-		printf(".\\\"%s\n", n->string);
+		fprintf(outfp, ".\\\"%s\n", n->string);
 	}
 
-	printf(".TH \"%s\" \"%s\" \"%s\" \"%s\" \"%s\"\n",
+	fprintf(outfp, ".TH \"%s\" \"%s\" \"%s\" \"%s\" \"%s\"\n",
 	    mdoc->title, (mdoc->msec == NULL ? "" : mdoc->msec),
 	    mdoc->date, mdoc->os, mdoc->vol);
 
 	/* Disable hyphenation and if nroff, disable justification. */
-	printf(".nh\n.if n .ad l");
+	fprintf(outfp, ".nh\n.if n .ad l");
 
 	outflags = MMAN_nl | MMAN_Sm;
 	if (0 == fontqueue.size) {
@@ -633,7 +636,7 @@ man_mdoc(void *arg, const struct roff_meta *mdoc)
 	}
 	for (; n != NULL; n = n->next)
 		print_node(mdoc, n);
-	putchar('\n');
+	putc('\n', outfp);
 }
 
 static void
@@ -681,7 +684,7 @@ print_node(DECL_ARGS)
 		if (MMAN_nl & outflags &&
 		    ('.' == *n->string || '\'' == *n->string)) {
 			print_word("");
-			printf("\\&");
+			fprintf(outfp, "\\&");
 			outflags &= ~MMAN_spc;
 		}
 		if (n->flags & NODE_DELIMC)
@@ -847,7 +850,7 @@ pre_sect(DECL_ARGS)
 		outflags |= MMAN_sp;
 		print_block(mdoc_man_act(n->tok)->prefix, 0);
 		print_word("");
-		putchar('\"');
+		putc('\"', outfp);
 		outflags &= ~MMAN_spc;
 	}
 	return 1;
@@ -864,7 +867,7 @@ post_sect(DECL_ARGS)
 		return;
 	outflags &= ~MMAN_spc;
 	print_word("");
-	putchar('\"');
+	putc('\"', outfp);
 	outflags |= MMAN_nl;
 	if (MDOC_Sh == n->tok && SEC_AUTHORS == n->sec)
 		outflags &= ~(MMAN_An_split | MMAN_An_nosplit);
@@ -1483,7 +1486,7 @@ pre_it(DECL_ARGS)
 			return 1;
 		case LIST_tag:
 			print_width(&bln->norm->Bl, n->child);
-			putchar('\n');
+			putc('\n', outfp);
 			outflags &= ~MMAN_spc;
 			return 1;
 		default:
@@ -1566,7 +1569,7 @@ post_it(DECL_ARGS)
 			break;
 		case LIST_column:
 			if (NULL != n->next) {
-				putchar('\t');
+				putc('\t', outfp);
 				outflags &= ~MMAN_spc;
 			}
 			break;
@@ -1670,7 +1673,7 @@ pre_nm(DECL_ARGS)
 		if (roff_node_prev(n->parent) == NULL)
 			outflags |= MMAN_sp;
 		print_block(".HP", 0);
-		printf(" %dn", man_strlen(name) + 1);
+		fprintf(outfp, " %dn", man_strlen(name) + 1);
 		outflags |= MMAN_nl;
 	}
 	font_push('B');
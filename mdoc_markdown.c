@@ -256,6 +256,7 @@ static	int	 escflags; /* Escape in generated markdown code: */
 
 static	int	 code_blocks, quote_blocks, list_blocks;
 static	int	 outcount;
+static	FILE	*outfp;  /* Output stream. */
 
 
 static const struct md_act *
@@ -268,6 +269,7 @@ md_act(enum roff_tok tok)
 void
 markdown_mdoc(void *arg, const struct roff_meta *mdoc)
 {
+	outfp = arg == NULL ? stdout : arg;
 	outflags = MD_Sm;
 	md_word(mdoc->title);
 	if (mdoc->msec != NULL) {
@@ -291,7 +293,7 @@ markdown_mdoc(void *arg, const struct roff_meta *mdoc)
 	md_word(mdoc->os);
 	md_word("-");
 	md_word(mdoc->date);
-	putchar('\n');
+	putc('\n', outfp);
 }
 
 static void
@@ -420,21 +422,21 @@ md_preword(void)
 	 */
 
 	if (outflags & MD_sp)
-		putchar('\n');
+		putc('\n', outfp);
 	else if (outflags & MD_br) {
-		putchar(' ');
-		putchar(' ');
+		putc(' ', outfp);
+		putc(' ', outfp);
 	} else if (outflags & MD_nl && escflags & ESC_EOL)
 		md_named("zwnj");
 
 	/* Start a new line if necessary. */
 
 	if (outflags & (MD_nl | MD_br | MD_sp)) {
-		putchar('\n');
+		putc('\n', outfp);
 		for (cp = md_stack('\0'); *cp != '\0'; cp++) {
-			putchar(*cp);
+			putc(*cp, outfp);
 			if (*cp == '>')
-				putchar(' ');
+				putc(' ', outfp);
 		}
 		outflags &= ~(MD_nl | MD_br | MD_sp);
 		escflags = ESC_BOL;
@@ -444,9 +446,9 @@ md_preword(void)
 
 	} else if (outflags & MD_spc) {
 		if (outflags & MD_Bk)
-			fputs("&nbsp;", stdout);
+			fputs("&nbsp;", outfp);
 		else
-			putchar(' ');
+			putc(' ', outfp);
 		escflags &= ~ESC_FON;
 		outcount++;
 	}
@@ -474,7 +476,7 @@ md_rawword(const char *s)
 	if (escflags & ESC_FON) {
 		escflags &= ~ESC_FON;
 		if (*s == '*' && !code_blocks)
-			fputs("&zwnj;", stdout);
+			fputs("&zwnj;", outfp);
 	}
 
 	while (*s != '\0') {
@@ -651,10 +653,10 @@ md_word(const char *s)
 					uc = 0xFFFD;
 				if (code_blocks) {
 					seq = mchars_uc2str(uc);
-					fputs(seq, stdout);
+					fputs(seq, outfp);
 					outcount += strlen(seq);
 				} else {
-					printf("&#%d;", uc);
+					fprintf(outfp, "&#%d;", uc);
 					outcount++;
 				}
 				escflags &= ~ESC_FON;
@@ -669,11 +671,11 @@ md_word(const char *s)
 			break;
 		}
 		if (bs)
-			putchar('\\');
+			putc('\\', outfp);
 		md_char(c);
 		if (breakline &&
 		    (*s == '\0' || *s == ' ' || *s == ASCII_NBRSP)) {
-			printf("  \n");
+			fprintf(outfp, "  \n");
 			breakline = 0;
 			while (*s == ' ' || *s == ASCII_NBRSP)
 				s++;
@@ -694,7 +696,7 @@ md_word(const char *s)
 static void
 md_named(const char *s)
 {
-	printf("&%s;", s);
+	fprintf(outfp, "&%s;", s);
 	escflags &= ~(ESC_FON | ESC_EOL);
 	outcount++;
 }
@@ -706,7 +708,7 @@ static void
 md_char(unsigned char c)
 {
 	if (c != '\0') {
-		putchar(c);
+		putc(c, outfp);
 		if (c == '*')
 			escflags |= ESC_FON;
 		else
@@ -1238,7 +1240,7 @@ md_pre_It(struct roff_node *n)
 			md_preword();
 			if (bln->norm->Bl.count < 99)
 				bln->norm->Bl.count++;
-			printf("%d.\t", bln->norm->Bl.count);
+			fprintf(outfp, "%d.\t", bln->norm->Bl.count);
 			escflags &= ~ESC_FON;
 			break;
 		case LIST_column:
@@ -1321,7 +1323,7 @@ md_post_It(struct roff_node *n)
 		if (i < 1)
 			i = 1;
 		while (i-- > 0)
-			putchar(' ');
+			putc(' ', outfp);
 
 		outflags &= ~MD_spc;
 		escflags &= ~ESC_FON;
@@ -1345,10 +1347,10 @@ md_uri(const char *s)
 {
 	while (*s != '\0') {
 		if (strchr("%()<>", *s) != NULL) {
-			printf("%%%2.2hhX", *s);
+			fprintf(outfp, "%%%2.2hhX", *s);
 			outcount += 3;
 		} else {
-			putchar(*s);
+			putc(*s, outfp);
 			outcount++;
 		}
 		s++;
@@ -1409,7 +1411,7 @@ md_pre_Mt(struct roff_node *n)
 	for (nch = n->child; nch != NULL; nch = nch->next) {
 		md_uri(nch->string);
 		if (nch->next != NULL) {
-			putchar(' ');
+			putc(' ', outfp);
 			outcount++;
 		}
 	}
@@ -251,41 +251,69 @@ terminal_mdoc(void *arg, const struct roff_meta *mdoc)
 	struct roff_node	*n, *nn;
 	struct termp		*p;
 
+	n = mdoc->first->child;
 	p = (struct termp *)arg;
+	if (p->synopsisonly == 0) {
+		for (; n != NULL; n = n->next)
+			terminal_mdoc_stream(arg, mdoc, n);
+		terminal_mdoc_stream(arg, mdoc, NULL);
+		return;
+	}
+
 	p->tcol->rmargin = p->maxrmargin = p->defrmargin;
 	term_tab_set(p, NULL);
 	term_tab_set(p, "T");
 	term_tab_set(p, ".5i");
 
-	n = mdoc->first->child;
-	if (p->synopsisonly) {
-		for (nn = NULL; n != NULL; n = n->next) {
-			if (n->tok != MDOC_Sh)
-				continue;
-			if (n->sec == SEC_SYNOPSIS)
-				break;
-			if (nn == NULL && n->sec == SEC_NAME)
-				nn = n;
-		}
-		if (n == NULL)
-			n = nn;
-		p->flags |= TERMP_NOSPACE;
-		if (n != NULL && (n = n->child->next->child) != NULL)
-			print_mdoc_nodelist(p, NULL, mdoc, n);
-		term_newln(p);
-	} else {
+	for (nn = NULL; n != NULL; n = n->next) {
+		if (n->tok != MDOC_Sh)
+			continue;
+		if (n->sec == SEC_SYNOPSIS)
+			break;
+		if (nn == NULL && n->sec == SEC_NAME)
+			nn = n;
+	}
+	if (n == NULL)
+		n = nn;
+	p->flags |= TERMP_NOSPACE;
+	if (n != NULL && (n = n->child->next->child) != NULL)
+		print_mdoc_nodelist(p, NULL, mdoc, n);
+	term_newln(p);
+}
+
+/*
+ * Format one top level node of the document, printing the page
+ * header before the first one, or finish the document if n is NULL.
+ * This allows formatting to start before parsing is complete.
+ */
+void
+terminal_mdoc_stream(void *arg, const struct roff_meta *mdoc,
+    struct roff_node *n)
+{
+	struct termp		*p;
+
+	p = (struct termp *)arg;
+	if (p->docstate == 0) {
+		p->tcol->rmargin = p->maxrmargin = p->defrmargin;
+		term_tab_set(p, NULL);
+		term_tab_set(p, "T");
+		term_tab_set(p, ".5i");
 		term_begin(p, print_mdoc_head, print_mdoc_foot, mdoc);
-		while (n != NULL &&
-		    (n->type == ROFFT_COMMENT ||
-		     n->flags & NODE_NOPRT))
-			n = n->next;
-		if (n != NULL) {
-			if (n->tok != MDOC_Sh)
-				term_vspace(p);
-			print_mdoc_nodelist(p, NULL, mdoc, n);
-		}
+		p->docstate = 1;
+	}
+	if (n == NULL) {
 		term_end(p);
+		p->docstate = 0;
+		return;
+	}
+	if (p->docstate == 1) {
+		if (n->type == ROFFT_COMMENT || n->flags & NODE_NOPRT)
+			return;
+		if (n->tok != MDOC_Sh)
+			term_vspace(p);
+		p->docstate = 2;
 	}
+	print_mdoc_node(p, NULL, mdoc, n);
 }
 
 static void
@@ -330,7 +330,8 @@ mdoc_validate(struct roff_man *mdoc)
 
 	mdoc->last = mdoc->last->child;
 	while (mdoc->last != NULL) {
-		mdoc_validate(mdoc);
+		if ((mdoc->last->flags & NODE_CHECKED) == 0)
+			mdoc_validate(mdoc);
 		if (mdoc->last == n)
 			mdoc->last = mdoc->last->child;
 		else
@@ -41,12 +41,12 @@ struct	tbl_colgroup {
 };
 
 static	size_t	tblcalc_data(struct rofftbl *, struct roffcol *,
-			const struct tbl_opts *, const struct tbl_dat *,
+			const struct tbl_opts *, struct tbl_dat *,
 			size_t);
 static	size_t	tblcalc_literal(struct rofftbl *, struct roffcol *,
-			const struct tbl_dat *, size_t);
+			const struct tbl_opts *, struct tbl_dat *, size_t);
 static	size_t	tblcalc_number(struct rofftbl *, struct roffcol *,
-			const struct tbl_opts *, const struct tbl_dat *);
+			const struct tbl_opts *, struct tbl_dat *);
 
 
 /*
@@ -120,7 +120,7 @@ tblcalc(struct rofftbl *tbl, const struct tbl_span *sp_first,
 	struct roffsu		 su;
 	const struct tbl_opts	*opts;
 	const struct tbl_span	*sp;
-	const struct tbl_dat	*dp;
+	struct tbl_dat		*dp;
 	struct roffcol		*col;
 	struct tbl_colgroup	*first_group, **gp, *g;
 	size_t			*colwidth;
@@ -418,7 +418,7 @@ tblcalc(struct rofftbl *tbl, const struct tbl_span *sp_first,
 
 static size_t
 tblcalc_data(struct rofftbl *tbl, struct roffcol *col,
-    const struct tbl_opts *opts, const struct tbl_dat *dp, size_t mw)
+    const struct tbl_opts *opts, struct tbl_dat *dp, size_t mw)
 {
 	size_t		 sz;
 
@@ -435,7 +435,7 @@ tblcalc_data(struct rofftbl *tbl, struct roffcol *col,
 	case TBL_CELL_CENTRE:
 	case TBL_CELL_LEFT:
 	case TBL_CELL_RIGHT:
-		return tblcalc_literal(tbl, col, dp, mw);
+		return tblcalc_literal(tbl, col, opts, dp, mw);
 	case TBL_CELL_NUMBER:
 		return tblcalc_number(tbl, col, opts, dp);
 	case TBL_CELL_DOWN:
@@ -447,9 +447,9 @@ tblcalc_data(struct rofftbl *tbl, struct roffcol *col,
 
 static size_t
 tblcalc_literal(struct rofftbl *tbl, struct roffcol *col,
-    const struct tbl_dat *dp, size_t mw)
+    const struct tbl_opts *opts, struct tbl_dat *dp, size_t mw)
 {
-	const char	*str;	/* Beginning of the first line. */
+	char		*str;	/* Beginning of the first line. */
 	const char	*beg;	/* Beginning of the current line. */
 	char		*end;	/* End of the current line. */
 	size_t		 lsz;	/* Length of the current line. */
@@ -458,25 +458,29 @@ tblcalc_literal(struct rofftbl *tbl, struct roffcol *col,
 
 	if (dp->string == NULL || *dp->string == '\0')
 		return 0;
-	str = mw ? mandoc_strdup(dp->string) : dp->string;
+	if (mw == 0) {
+		tblcalc_cell(tbl, opts, dp, 0);
+		if (col != NULL && col->width < dp->width)
+			col->width = dp->width;
+		return dp->width;
+	}
+	str = mandoc_strdup(dp->string);
 	msz = lsz = 0;
 	for (beg = str; beg != NULL && *beg != '\0'; beg = end) {
-		end = mw ? strchr(beg, ' ') : NULL;
-		if (end != NULL) {
+		if ((end = strchr(beg, ' ')) != NULL) {
 			*end++ = '\0';
 			while (*end == ' ')
 				end++;
 		}
 		wsz = (*tbl->slen)(beg, tbl->arg);
-		if (mw && lsz && lsz + 1 + wsz <= mw)
+		if (lsz && lsz + 1 + wsz <= mw)
 			lsz += 1 + wsz;
 		else
 			lsz = wsz;
 		if (msz < lsz)
 			msz = lsz;
 	}
-	if (mw)
-		free((void *)str);
+	free(str);
 	if (col != NULL && col->width < msz)
 		col->width = msz;
 	return msz;
@@ -484,19 +488,75 @@ tblcalc_literal(struct rofftbl *tbl, struct roffcol *col,
 
 static size_t
 tblcalc_number(struct rofftbl *tbl, struct roffcol *col,
-		const struct tbl_opts *opts, const struct tbl_dat *dp)
+		const struct tbl_opts *opts, struct tbl_dat *dp)
 {
-	const char	*cp, *lastdigit, *lastpoint;
 	size_t		 intsz, totsz;
-	char		 buf[2];
 
 	if (dp->string == NULL || *dp->string == '\0')
 		return 0;
 
-	totsz = (*tbl->slen)(dp->string, tbl->arg);
+	tblcalc_cell(tbl, opts, dp, col != NULL);
+	totsz = dp->width;
 	if (col == NULL)
 		return totsz;
 
+	/* Not a number, treat as a literal string. */
+
+	if (dp->intwidth == SIZE_MAX) {
+		if (col != NULL && col->width < totsz)
+			col->width = totsz;
+		return totsz;
+	}
+	intsz = dp->intwidth;
+
+	/*
+         * If this number has more integer digits than all numbers
+         * seen on earlier lines, shift them all to the right.
+	 * If it has fewer, shift this number to the right.
+	 */
+
+	if (intsz > col->decimal) {
+		col->nwidth += intsz - col->decimal;
+		col->decimal = intsz;
+	} else
+		totsz += col->decimal - intsz;
+
+	/* Update the maximum total width seen so far. */
+
+	if (totsz > col->nwidth)
+		col->nwidth = totsz;
+	if (col->nwidth > col->width)
+		col->width = col->nwidth;
+	return totsz;
+}
+
+/*
+ * Measure the width of the string in a data cell and, if "number"
+ * is set, the width of the part left of the decimal point, or
+ * SIZE_MAX if the string isn't a number.  The results are stored
+ * in the cell, such that rendering it after the layout calculation
+ * does not need to measure it again.
+ */
+void
+tblcalc_cell(struct rofftbl *tbl, const struct tbl_opts *opts,
+    struct tbl_dat *dp, int number)
+{
+	const char	*cp, *lastdigit, *lastpoint;
+	char		 buf[2];
+
+	if (dp->wkey != tbl) {
+		dp->wkey = tbl;
+		dp->width = dp->string == NULL ? 0 :
+		    (*tbl->slen)(dp->string, tbl->arg);
+		dp->intdone = 0;
+	}
+	if (number == 0 || dp->intdone)
+		return;
+	dp->intdone = 1;
+	dp->intwidth = SIZE_MAX;
+	if (dp->string == NULL)
+		return;
+
 	/*
 	 * Find the last digit and
 	 * the last decimal point that is adjacent to a digit.
@@ -515,43 +575,17 @@ tblcalc_number(struct rofftbl *tbl, struct roffcol *col,
 		else if (isdigit((unsigned char)cp[0]))
 			lastdigit = cp;
 	}
-
-	/* Not a number, treat as a literal string. */
-
-	if (lastdigit == NULL) {
-		if (col != NULL && col->width < totsz)
-			col->width = totsz;
-		return totsz;
-	}
+	if (lastdigit == NULL)
+		return;
 
 	/* Measure the width of the integer part. */
 
 	if (lastpoint == NULL)
 		lastpoint = lastdigit + 1;
-	intsz = 0;
+	dp->intwidth = 0;
 	buf[1] = '\0';
 	for (cp = dp->string; cp < lastpoint; cp++) {
 		buf[0] = cp[0];
-		intsz += (*tbl->slen)(buf, tbl->arg);
+		dp->intwidth += (*tbl->slen)(buf, tbl->arg);
 	}
-
-	/*
-         * If this number has more integer digits than all numbers
-         * seen on earlier lines, shift them all to the right.
-	 * If it has fewer, shift this number to the right.
-	 */
-
-	if (intsz > col->decimal) {
-		col->nwidth += intsz - col->decimal;
-		col->decimal = intsz;
-	} else
-		totsz += col->decimal - intsz;
-
-	/* Update the maximum total width seen so far. */
-
-	if (totsz > col->nwidth)
-		col->nwidth = totsz;
-	if (col->nwidth > col->width)
-		col->width = col->nwidth;
-	return totsz;
 }
@@ -58,8 +58,12 @@ struct	rofftbl {
 };
 
 
+struct	tbl_dat;
+struct	tbl_opts;
 struct	tbl_span;
 
 const char	 *a2roffsu(const char *, struct roffsu *, enum roffscale);
 void		  tblcalc(struct rofftbl *,
 			const struct tbl_span *, size_t, size_t);
+void		  tblcalc_cell(struct rofftbl *, const struct tbl_opts *,
+			struct tbl_dat *, int);
@@ -28,10 +28,60 @@
 #include "mandoc_parse.h"
 #include "libmandoc.h"
 
+static	int	 preconv_char(const struct buf *, size_t *,
+			struct buf *, size_t *, int *);
+static	void	 preconv_put(struct buf *, size_t *, unsigned int);
+
+
+/*
+ * Convert a run of non-ASCII characters starting at ib->buf[*ii],
+ * as long as the output buffer has room for the worst case.
+ * Return 0 if not even the first character can be converted.
+ */
 int
 preconv_encode(const struct buf *ib, size_t *ii, struct buf *ob, size_t *oi,
     int *filenc)
 {
+
+	assert(ib->buf[*ii] & 0x80);
+	if (preconv_char(ib, ii, ob, oi, filenc) == 0)
+		return 0;
+	while (*ii < ib->sz && ib->buf[*ii] & 0x80 && *oi + 12 <= ob->sz)
+		if (preconv_char(ib, ii, ob, oi, filenc) == 0)
+			break;
+	return 1;
+}
+
+/*
+ * Write the \[uXXXX] escape sequence for one Unicode code point.
+ * This is called for every non-ASCII character in the input,
+ * so avoid the overhead of snprintf(3).
+ */
+static void
+preconv_put(struct buf *ob, size_t *oi, unsigned int accum)
+{
+	static const char	 hex[] = "0123456789ABCDEF";
+	char			*cp;
+	int			 shift;
+
+	cp = ob->buf + *oi;
+	*cp++ = '\\';
+	*cp++ = '[';
+	*cp++ = 'u';
+	shift = accum > 0xfffff ? 20 : accum > 0xffff ? 16 : 12;
+	while (shift >= 0) {
+		*cp++ = hex[(accum >> shift) & 0xf];
+		shift -= 4;
+	}
+	*cp++ = ']';
+	*cp = '\0';
+	*oi = cp - ob->buf;
+}
+
+static int
+preconv_char(const struct buf *ib, size_t *ii, struct buf *ob, size_t *oi,
+    int *filenc)
+{
 	const unsigned char	*cu;
 	int			 nby;
 	unsigned int		 accum;
@@ -92,7 +142,7 @@ preconv_encode(const struct buf *ib, size_t *ii, struct buf *ob, size_t *oi,
 	assert(accum < 0x110000);
 	assert(accum < 0xd800 || accum > 0xdfff);
 
-	*oi += snprintf(ob->buf + *oi, 11, "\\[u%.4X]", accum);
+	preconv_put(ob, oi, accum);
 	*ii = (const char *)cu - ib->buf;
 	*filenc &= ~MPARSE_LATIN1;
 	return 1;
@@ -101,8 +151,7 @@ latin:
 	if ( ! (*filenc & MPARSE_LATIN1))
 		return 0;
 
-	*oi += snprintf(ob->buf + *oi, 11,
-	    "\\[u%.4X]", (unsigned char)ib->buf[(*ii)++]);
+	preconv_put(ob, oi, (unsigned char)ib->buf[(*ii)++]);
 
 	*filenc &= ~MPARSE_UTF8;
 	return 1;
@@ -50,6 +50,37 @@
 #include "tag.h"
 
 #define	REPARSE_LIMIT	1000
+#define	INCL_MAX	64 /* maximum number of cached .so files */
+
+/*
+ * While streaming, validation runs before parsing is complete,
+ * so the state of the validator is kept separate from the state
+ * of the parser and swapped in and out.
+ */
+struct	vstate {
+	struct roff_node *last_es; /* most recent Es node */
+	int		  flags; /* validation flags */
+	enum roff_sec	  lastsec; /* last section seen */
+	enum roff_sec	  lastnamed; /* last standard section seen */
+	int		  ns; /* value of the nS register */
+};
+
+/*
+ * The contents of a file included with .so, kept in memory
+ * such that later documents including it need not read it again.
+ */
+struct	incl {
+	struct incl	 *next; /* less recently used file */
+	char		 *buf; /* decompressed contents */
+	size_t		  sz; /* size of buf */
+	dev_t		  dev; /* identity of the file */
+	ino_t		  ino;
+	time_t		  mtime; /* state of the file when read */
+	off_t		  size;
+	int		  gzip; /* the file was decompressed */
+	int		  mmap; /* buf was obtained from mmap(2) */
+	int		  busy; /* number of active inclusions */
+};
 
 struct	mparse {
 	struct roff	 *roff; /* roff parser (!NULL) */
@@ -57,6 +88,19 @@ struct	mparse {
 	struct buf	 *primary; /* buffer currently being parsed */
 	struct buf	 *secondary; /* copy of top level input */
 	struct buf	 *loop; /* open .while request line */
+	void		(*streamf)(void *, const struct roff_meta *,
+				struct roff_node *); /* streaming output */
+	void		 *streamarg; /* argument of streamf */
+	void		(*inclf)(void *, const char *); /* .so callback */
+	void		 *inclarg; /* argument of inclf */
+	struct incl	 *incls; /* cached .so files, most recent first */
+	size_t		  inclsz; /* total size of incls */
+	size_t		  inclmax; /* maximum of inclsz, 0 = no caching */
+	int		  incln; /* number of incls */
+	struct roff_node *streamtop; /* last top level node seen */
+	struct roff_node *streamval; /* last top level node validated */
+	struct roff_node *streamout; /* last top level node output */
+	struct vstate	  vstate; /* saved validation state */
 	const char	 *os_s; /* default operating system */
 	int		  options; /* parser options */
 	int		  gzip; /* current input file is gzipped */
@@ -67,10 +111,19 @@ struct	mparse {
 
 static	void	  choose_parser(struct mparse *);
 static	void	  free_buf_list(struct buf *);
+static	void	  incl_free(struct incl *);
+static	struct incl	*incl_get(struct mparse *, int);
+static	void	  incl_trim(struct mparse *);
 static	void	  resize_buf(struct buf *, size_t);
 static	int	  mparse_buf_r(struct mparse *, struct buf, size_t, int);
 static	int	  read_whole_file(struct mparse *, int, struct buf *, int *);
 static	void	  mparse_end(struct mparse *);
+static	void	  mparse_flush(struct mparse *, int);
+static	int	  mparse_issec(const struct roff_node *);
+static	int	  mparse_ready(const struct roff_meta *,
+			const struct roff_node *);
+static	size_t	  mparse_span(const char *, size_t);
+static	void	  mparse_swap(struct mparse *);
 
 
 static void
@@ -81,6 +134,24 @@ resize_buf(struct buf *buf, size_t initial)
 	buf->buf = mandoc_realloc(buf->buf, buf->sz);
 }
 
+/*
+ * Return the number of leading bytes in the buffer that are
+ * printable ASCII characters and can be copied without any
+ * checks or conversion.  Tabs are not included: they are rare
+ * enough that handling them one by one costs nothing.
+ */
+static size_t
+mparse_span(const char *buf, size_t sz)
+{
+	const unsigned char	*cp, *ep;
+
+	cp = (const unsigned char *)buf;
+	ep = cp + sz;
+	while (cp < ep && *cp >= 0x20 && *cp < 0x7f)
+		cp++;
+	return cp - (const unsigned char *)buf;
+}
+
 static void
 free_buf_list(struct buf *buf)
 {
@@ -94,6 +165,92 @@ free_buf_list(struct buf *buf)
 	}
 }
 
+/*
+ * Find the file open on fd in the .so cache, or read it and add it.
+ * Return NULL if the file cannot be read.
+ */
+static struct incl *
+incl_get(struct mparse *curp, int fd)
+{
+	struct stat	  st;
+	struct buf	  fb;
+	struct incl	**pp, *inc;
+	int		  with_mmap;
+
+	if (fstat(fd, &st) == -1) {
+		mandoc_msg(MANDOCERR_FSTAT, 0, 0, "%s", strerror(errno));
+		return NULL;
+	}
+	for (pp = &curp->incls; (inc = *pp) != NULL; pp = &inc->next) {
+		if (inc->ino != st.st_ino || inc->dev != st.st_dev)
+			continue;
+		if (inc->mtime == st.st_mtime && inc->size == st.st_size &&
+		    inc->gzip == curp->gzip) {
+			*pp = inc->next;
+			inc->next = curp->incls;
+			curp->incls = inc;
+			return inc;
+		}
+		if (inc->busy == 0) {
+			*pp = inc->next;
+			curp->inclsz -= inc->sz;
+			curp->incln--;
+			incl_free(inc);
+		}
+		break;
+	}
+	if (read_whole_file(curp, fd, &fb, &with_mmap) == -1)
+		return NULL;
+	inc = mandoc_calloc(1, sizeof(*inc));
+	inc->buf = fb.buf;
+	inc->sz = fb.sz;
+	inc->dev = st.st_dev;
+	inc->ino = st.st_ino;
+	inc->mtime = st.st_mtime;
+	inc->size = st.st_size;
+	inc->gzip = curp->gzip;
+	inc->mmap = with_mmap;
+	inc->next = curp->incls;
+	curp->incls = inc;
+	curp->inclsz += inc->sz;
+	curp->incln++;
+	return inc;
+}
+
+/*
+ * Drop the least recently used files that are not being parsed
+ * until the cache is small enough again.
+ */
+static void
+incl_trim(struct mparse *curp)
+{
+	struct incl	**pp, **victim, *inc;
+
+	while (curp->inclsz > curp->inclmax || curp->incln > INCL_MAX) {
+		victim = NULL;
+		for (pp = &curp->incls; *pp != NULL; pp = &(*pp)->next)
+			if ((*pp)->busy == 0)
+				victim = pp;
+		if (victim == NULL)
+			break;
+		inc = *victim;
+		*victim = inc->next;
+		curp->inclsz -= inc->sz;
+		curp->incln--;
+		incl_free(inc);
+	}
+}
+
+static void
+incl_free(struct incl *inc)
+{
+	if (inc->mmap)
+		munmap(inc->buf, inc->sz);
+	else
+		free(inc->buf);
+	free(inc);
+}
+
 static void
 choose_parser(struct mparse *curp)
 {
@@ -131,11 +288,11 @@ choose_parser(struct mparse *curp)
 	if (format == MPARSE_MDOC) {
 		curp->man->meta.macroset = MACROSET_MDOC;
 		if (curp->man->mdocmac == NULL)
-			curp->man->mdocmac = roffhash_alloc(MDOC_Dd, MDOC_MAX);
+			curp->man->mdocmac = roffhash_get(MDOC_Dd);
 	} else {
 		curp->man->meta.macroset = MACROSET_MAN;
 		if (curp->man->manmac == NULL)
-			curp->man->manmac = roffhash_alloc(MAN_TH, MAN_MAX);
+			curp->man->manmac = roffhash_get(MAN_TH);
 	}
 	curp->man->meta.first->tok = TOKEN_NONE;
 }
@@ -160,6 +317,7 @@ mparse_buf_r(struct mparse *curp, struct buf blk, size_t i, int start)
 	int		 lnn; /* line number in the real file */
 	int		 fd;
 	int		 inloop; /* Saw .while on this level. */
+	size_t		 sz; /* length of a run of plain characters */
 	unsigned char	 c;
 
 	ln.sz = 256;
@@ -200,6 +358,20 @@ mparse_buf_r(struct mparse *curp, struct buf blk, size_t i, int start)
 				break;
 			}
 
+			/*
+			 * Plain ASCII text makes up most of the input
+			 * and is copied in bulk.
+			 */
+
+			if ((sz = mparse_span(blk.buf + i, blk.sz - i)) > 0) {
+				while (pos + sz + 12 > ln.sz)
+					resize_buf(&ln, 256);
+				memcpy(ln.buf + pos, blk.buf + i, sz);
+				pos += sz;
+				i += sz;
+				continue;
+			}
+
 			/*
 			 * Make sure we have space for the worst
 			 * case of 12 bytes: "\\[u10ffff]\n\0"
@@ -249,12 +421,13 @@ mparse_buf_r(struct mparse *curp, struct buf blk, size_t i, int start)
 		 */
 
 		thisln = mandoc_malloc(sizeof(*thisln));
-		thisln->buf = mandoc_strdup(ln.buf);
-		thisln->sz = strlen(ln.buf) + 1;
+		thisln->sz = pos + 1;
+		thisln->buf = mandoc_malloc(thisln->sz);
+		memcpy(thisln->buf, ln.buf, thisln->sz);
 		thisln->next = NULL;
 		if (firstln == NULL) {
 			firstln = lastln = thisln;
-			if (curp->secondary == NULL)
+			if (curp->secondary == NULL && curp->streamf == NULL)
 				curp->secondary = firstln;
 		} else {
 			lastln->next = thisln;
@@ -385,6 +558,8 @@ rerun:
 				    mandoc_strdup(ln.buf + of);
 				goto out;
 			}
+			if (curp->inclf != NULL)
+				(*curp->inclf)(curp->inclarg, ln.buf + of);
 			if ((fd = mparse_open(curp, ln.buf + of)) != -1) {
 				mparse_readfd(curp, fd, ln.buf + of);
 				close(fd);
@@ -421,6 +596,21 @@ rerun:
 			goto rerun;
 		}
 
+		/*
+		 * While streaming, hand completed top level nodes
+		 * to the formatter, and outside .while loops, forget
+		 * the lines already parsed.
+		 */
+
+		if (curp->streamf != NULL && start) {
+			if (curp->loop == NULL) {
+				free_buf_list(firstln);
+				firstln = lastln = NULL;
+			}
+			if (curp->man->meta.first->last != curp->streamtop)
+				mparse_flush(curp, 0);
+		}
+
 		pos = (line_result & ROFF_APPEND) ? strlen(ln.buf) : 0;
 	}
 out:
@@ -562,6 +752,7 @@ mparse_readfd(struct mparse *curp, int fd, const char *filename)
 
 	struct buf	 blk;
 	struct buf	*save_primary;
+	struct incl	*inc;
 	const char	*save_filename, *cp;
 	size_t		 offset;
 	int		 save_filenc, save_lineno;
@@ -577,8 +768,19 @@ mparse_readfd(struct mparse *curp, int fd, const char *filename)
         else
                 curp->man->filesec = '\0';
 
-	if (read_whole_file(curp, fd, &blk, &with_mmap) == -1)
-		return;
+	/* Included files are shared with later documents. */
+
+	if (recursion_depth > 0 && curp->inclmax > 0) {
+		if ((inc = incl_get(curp, fd)) == NULL)
+			return;
+		inc->busy++;
+		blk.buf = inc->buf;
+		blk.sz = inc->sz;
+	} else {
+		if (read_whole_file(curp, fd, &blk, &with_mmap) == -1)
+			return;
+		inc = NULL;
+	}
 
 	/*
 	 * Save some properties of the parent file.
@@ -613,7 +815,10 @@ mparse_readfd(struct mparse *curp, int fd, const char *filename)
 	 * Clean up and restore saved parent properties.
 	 */
 
-	if (with_mmap)
+	if (inc != NULL) {
+		inc->busy--;
+		incl_trim(curp);
+	} else if (with_mmap)
 		munmap(blk.buf, blk.sz);
 	else
 		free(blk.buf);
@@ -677,11 +882,11 @@ mparse_alloc(int options, enum mandoc_os os_e, const char *os_s)
 	if (curp->options & MPARSE_MDOC) {
 		curp->man->meta.macroset = MACROSET_MDOC;
 		if (curp->man->mdocmac == NULL)
-			curp->man->mdocmac = roffhash_alloc(MDOC_Dd, MDOC_MAX);
+			curp->man->mdocmac = roffhash_get(MDOC_Dd);
 	} else if (curp->options & MPARSE_MAN) {
 		curp->man->meta.macroset = MACROSET_MAN;
 		if (curp->man->manmac == NULL)
-			curp->man->manmac = roffhash_alloc(MAN_TH, MAN_MAX);
+			curp->man->manmac = roffhash_get(MAN_TH);
 	}
 	curp->man->meta.first->tok = TOKEN_NONE;
 	curp->man->meta.os_e = os_e;
@@ -697,6 +902,8 @@ mparse_reset(struct mparse *curp)
 	roff_man_reset(curp->man);
 	free_buf_list(curp->secondary);
 	curp->secondary = NULL;
+	curp->streamtop = curp->streamval = curp->streamout = NULL;
+	memset(&curp->vstate, 0, sizeof(curp->vstate));
 	curp->gzip = 0;
 	tag_alloc();
 }
@@ -705,24 +912,194 @@ void
 mparse_free(struct mparse *curp)
 {
 	tag_free();
-	roffhash_free(curp->man->mdocmac);
-	roffhash_free(curp->man->manmac);
 	roff_man_free(curp->man);
 	roff_free(curp->roff);
 	free_buf_list(curp->secondary);
+	curp->inclmax = 0;
+	incl_trim(curp);
 	free(curp);
 }
 
+/*
+ * Tell inclf about each file included with .so before trying to
+ * open it, for example to find out on which files the result depends.
+ */
+void
+mparse_include(struct mparse *curp,
+    void (*inclf)(void *, const char *), void *arg)
+{
+	curp->inclf = inclf;
+	curp->inclarg = arg;
+}
+
+/*
+ * Keep up to maxsz bytes of files included with .so in memory,
+ * such that later documents including the same files need not
+ * read and decompress them again.  Files are identified by device,
+ * inode, modification time, and size, so a file changed on disk is
+ * read again.  Passing 0 disables the cache and empties it.
+ */
+void
+mparse_include_cache(struct mparse *curp, size_t maxsz)
+{
+	curp->inclmax = maxsz;
+	incl_trim(curp);
+}
+
+/*
+ * Pass each top level node to streamf as soon as it is complete,
+ * and free the sections already passed, such that the memory needed
+ * for the syntax tree no longer grows with the size of the document.
+ */
+void
+mparse_stream(struct mparse *curp, void (*streamf)(void *,
+    const struct roff_meta *, struct roff_node *), void *arg)
+{
+	curp->streamf = streamf;
+	curp->streamarg = arg;
+}
+
+/*
+ * Validate the top level nodes that are complete, or all of them
+ * and the root node at the end of the document, and pass them to
+ * the formatter as soon as the prologue information is complete.
+ */
+static void
+mparse_flush(struct mparse *curp, int end)
+{
+	struct roff_man		*man;
+	struct roff_node	*root, *last, *n, *np, *target;
+	enum roff_next		 next;
+
+	man = curp->man;
+	root = man->meta.first;
+	curp->streamtop = root->last;
+
+	last = man->last;
+	next = man->next;
+	mparse_swap(curp);
+	for (;;) {
+		n = curp->streamval == NULL ? root->child :
+		    curp->streamval->next;
+		if (n == NULL || (n == root->last && end == 0))
+			break;
+		n->flags |= NODE_CHECKED;
+		man->last = n;
+		if (man->meta.macroset == MACROSET_MDOC)
+			mdoc_validate(man);
+		else
+			man_validate(man);
+		curp->streamval = man->last == root ? NULL : man->last;
+	}
+	if (end) {
+		man->last = root;
+		if (man->meta.macroset == MACROSET_MDOC)
+			mdoc_validate(man);
+		else
+			man_validate(man);
+	}
+	mparse_swap(curp);
+	man->last = last;
+	man->next = next;
+
+	/*
+	 * Output lags validation by one node because validating
+	 * a node may delete the preceding one.  Do not start
+	 * before the first section such that all prologue
+	 * macros are seen before printing the page header.
+	 */
+
+	if (end)
+		target = curp->streamval;
+	else if (mparse_ready(&man->meta, curp->streamval))
+		target = curp->streamval->prev;
+	else
+		return;
+	if (curp->streamout == target)
+		return;
+	do {
+		n = curp->streamout == NULL ? root->child :
+		    curp->streamout->next;
+		tag_postprocess(man, n);
+		(*curp->streamf)(curp->streamarg, &man->meta, n);
+		curp->streamout = n;
+	} while (n != target);
+
+	/*
+	 * Free the sections before the last one formatted,
+	 * except when a later En may still refer to them.
+	 */
+
+	tag_forget();
+	n = curp->streamout->prev;
+	while (n != NULL) {
+		last = n;
+		n = n->prev;
+		if (mparse_issec(last) == 0)
+			continue;
+		for (np = curp->vstate.last_es; np != NULL; np = np->parent)
+			if (np == last)
+				break;
+		if (np == NULL)
+			roff_node_delete(man, last);
+	}
+}
+
+static int
+mparse_issec(const struct roff_node *n)
+{
+	return n->type == ROFFT_BLOCK &&
+	    (n->tok == MDOC_Sh || n->tok == MAN_SH);
+}
+
+/*
+ * Whether the page header can be printed
+ * and the body of the page has started.
+ */
+static int
+mparse_ready(const struct roff_meta *meta, const struct roff_node *n)
+{
+	if (n == NULL || mparse_issec(n) == 0 ||
+	    meta->title == NULL || meta->date == NULL)
+		return 0;
+	return meta->macroset == MACROSET_MAN ||
+	    (meta->os != NULL && meta->vol != NULL);
+}
+
+static void
+mparse_swap(struct mparse *curp)
+{
+	struct vstate	 save;
+	struct roff_man	*man;
+
+	man = curp->man;
+	save.last_es = man->last_es;
+	save.flags = man->flags;
+	save.lastsec = man->lastsec;
+	save.lastnamed = man->lastnamed;
+	save.ns = roff_getreg(curp->roff, "nS");
+	man->last_es = curp->vstate.last_es;
+	man->flags = curp->vstate.flags;
+	man->lastsec = curp->vstate.lastsec;
+	man->lastnamed = curp->vstate.lastnamed;
+	roff_setreg(curp->roff, "nS", curp->vstate.ns, '=');
+	curp->vstate = save;
+}
+
 struct roff_meta *
 mparse_result(struct mparse *curp)
 {
+	if (curp->streamf != NULL) {
+		mparse_flush(curp, 1);
+		return &curp->man->meta;
+	}
 	roff_state_reset(curp->man);
 	if (curp->options & MPARSE_VALIDATE) {
 		if (curp->man->meta.macroset == MACROSET_MDOC)
 			mdoc_validate(curp->man);
 		else
 			man_validate(curp->man);
-		tag_postprocess(curp->man, curp->man->meta.first);
+		tag_postprocess_all(curp->man);
 	}
 	return &curp->man->meta;
 }
@@ -0,0 +1,372 @@
+#!/bin/sh
+#
+# $Id$
+#
+# Copyright (c) 2026 The mandoc developers
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+#
+# Regression tests for command line options that need more than one
+# run of mandoc(1) or more than one input file, such that regress.pl
+# cannot run them.  Run from the regress directory after building.
+# Expected output is produced by running the same version of mandoc
+# without the option under test.
+
+TOP=$(cd .. && pwd)
+TMP=$(mktemp -d "${TMPDIR:-/tmp}/cmdline.XXXXXXXXXX") || exit 1
+trap 'rm -rf "$TMP"' 0
+trap 'exit 1' 1 2 15
+
+# Some programs exist as links to mandoc only after installation.
+for prog in mandoc man makewhatis apropos whatis; do
+	ln -s "$TOP/mandoc" "$TMP/$prog"
+done
+PATH=$TMP:$PATH
+
+count=0
+failed=0
+
+fail() {
+	echo "FAILED: $*"
+	failed=$((failed + 1))
+}
+
+# Usage: same test expected actual
+# Empty expected output always indicates a failure.
+same() {
+	count=$((count + 1))
+	[ -s "$2" ] && cmp -s "$2" "$3" || fail "$1"
+}
+
+# Usage: status test expected command ...
+status() {
+	count=$((count + 1))
+	test=$1
+	want=$2
+	shift 2
+	"$@" > /dev/null 2>&1
+	got=$?
+	[ "$got" -eq "$want" ] || fail "$test: exit status $got"
+}
+
+# --- input files ------------------------------------------------------
+
+cat > "$TMP/warn.1" << 'EOF'
+.Dd January 1, 2020
+.Dt WARN 1
+.Os
+.Sh NAME
+.Nm warn
+.Nd page causing a warning
+.Sh DESCRIPTION
+Some text.
+.Pp
+.Pp
+More text.
+EOF
+
+# --- -O cache ---------------------------------------------------------
+
+test_cache() {
+	mkdir "$TMP/cache"
+	mandoc -T ascii "$TMP/warn.1" > "$TMP/plain" 2>&1
+	mandoc -T ascii -O cache="$TMP/cache" "$TMP/warn.1" \
+	    > "$TMP/first" 2>&1
+	mandoc -T ascii -O cache="$TMP/cache" "$TMP/warn.1" \
+	    > "$TMP/second" 2>&1
+	same cache/first "$TMP/plain" "$TMP/first"
+	same cache/second "$TMP/plain" "$TMP/second"
+	count=$((count + 1))
+	ls "$TMP/cache" | grep -q . || fail cache/stored
+
+	# Requesting messages bypasses the cache.
+	mandoc -W warning -T ascii "$TMP/warn.1" > "$TMP/plain" 2>&1
+	mandoc -W warning -T ascii -O cache="$TMP/cache" "$TMP/warn.1" \
+	    > "$TMP/second" 2>&1
+	same cache/warning "$TMP/plain" "$TMP/second"
+	status cache/warning-status 2 mandoc -W warning -T ascii \
+	    -O cache="$TMP/cache" "$TMP/warn.1"
+	rm -rf "$TMP/cache"
+}
+
+# --- -O compress ------------------------------------------------------
+
+test_compress() {
+	mandoc -T pdf "$TMP/warn.1" | perl -e 'undef $/; $_ = <>;
+	    print $1 while /stream\n(.*?)endstream/sg' > "$TMP/plain"
+	mandoc -T pdf -O compress "$TMP/warn.1" > "$TMP/pdf"
+	perl -MCompress::Zlib -e 'undef $/; $_ = <>;
+	    print uncompress($1) // die while
+	    /\/Filter \/FlateDecode\n>>\nstream\n(.*?)\nendstream/sg' \
+	    "$TMP/pdf" > "$TMP/unz"
+	same compress/pages "$TMP/plain" "$TMP/unz"
+	count=$((count + 1))
+	head -n 1 "$TMP/pdf" | grep -q '^%PDF-1\.2$' ||
+	    fail compress/version
+}
+
+# --- -T lint -O cache -------------------------------------------------
+
+test_lint() {
+	mkdir "$TMP/cache"
+	mandoc -T lint "$TMP/warn.1" > "$TMP/plain" 2>&1
+	mandoc -T lint -O cache="$TMP/cache" "$TMP/warn.1" > "$TMP/first" 2>&1
+	mandoc -T lint -O cache="$TMP/cache" "$TMP/warn.1" > "$TMP/second" 2>&1
+	same lint/first "$TMP/plain" "$TMP/first"
+	same lint/second "$TMP/plain" "$TMP/second"
+	status lint/status 2 mandoc -T lint -O cache="$TMP/cache" "$TMP/warn.1"
+
+	# Changing a file included with .so invalidates the entry.
+	printf '.Dd January 1, 2020\n.Dt SO 1\n.Os\n.so incl.in\n' \
+	    > "$TMP/so.1"
+	printf '.Sh NAME\n.Nm incl\n.Nd included\n' > "$TMP/incl.in"
+	(cd "$TMP" && mandoc -T lint -O cache=cache so.1) > /dev/null 2>&1
+	printf '.Sh NAME\n.Nm incl\n.Nd included\n.Zz\n' > "$TMP/incl.in"
+	(cd "$TMP" && mandoc -T lint so.1) > "$TMP/plain" 2>&1
+	(cd "$TMP" && mandoc -T lint -O cache=cache so.1) > "$TMP/second" 2>&1
+	same lint/include "$TMP/plain" "$TMP/second"
+	status lint/include-status 3 sh -c \
+	    "cd '$TMP' && mandoc -T lint -O cache=cache so.1"
+	rm -rf "$TMP/cache" "$TMP/incl.in" "$TMP/so.1"
+}
+
+# --- .so include cache ------------------------------------------------
+
+test_include() {
+	mkdir "$TMP/so"
+	printf '.ds Cm common string\n.Pp\nCommon text \\*(Cm.\n' \
+	    > "$TMP/so/common.in"
+	printf 'Compressed text.\n' | gzip > "$TMP/so/zcommon.in.gz"
+	for i in 1 2 3; do
+		printf '.Dd January 1, 2020\n.Dt P%s 1\n.Os\n.Sh NAME\n' $i \
+		    > "$TMP/so/head"
+		printf '.Nm p%s\n.Nd page %s\n.Sh DESCRIPTION\n' $i $i \
+		    >> "$TMP/so/head"
+		{ cat "$TMP/so/head"
+		  printf '.so common.in\n.so zcommon.in\n.so common.in\n'
+		} > "$TMP/so/p$i.1"
+		{ cat "$TMP/so/head"
+		  cat "$TMP/so/common.in"
+		  gunzip -c "$TMP/so/zcommon.in.gz"
+		  cat "$TMP/so/common.in"; } > "$TMP/so/inline$i.1"
+	done
+
+	# Files included again must not be parsed differently.
+	(cd "$TMP/so" && mandoc -T ascii inline1.1 inline2.1 inline3.1) \
+	    > "$TMP/plain" 2>&1
+	(cd "$TMP/so" && mandoc -T ascii p1.1 p2.1 p3.1) > "$TMP/second" 2>&1
+	same include/output "$TMP/plain" "$TMP/second"
+	rm -rf "$TMP/so"
+}
+
+# --- -O site ---------------------------------------------------------
+
+# Usage: has test file string
+has() {
+	count=$((count + 1))
+	grep -qF -- "$3" "$2" || fail "$1"
+}
+
+test_site() {
+	mkdir -p "$TMP/src/man1" "$TMP/src/man8/amd64" "$TMP/src/man9" \
+	    "$TMP/site"
+	cat > "$TMP/src/man1/links.1" << 'EOF'
+.Dd January 1, 2020
+.Dt LINKS 1
+.Os
+.Sh NAME
+.Nm links
+.Nd cross references
+.Sh SEE ALSO
+.Xr missing 3 ,
+.Xr tool 8 ,
+.Xr zap 8
+EOF
+	for page in man8/tool.8 man8/amd64/zap.8 man9/kf.9; do
+		name=${page##*/}
+		sed "s/^\.Dt .*/.Dt X ${name#*.}/; s/^\.Nm .*/.Nm ${name%.*}/" \
+		    "$TMP/warn.1" > "$TMP/src/$page"
+	done
+	echo '.Xr links 1' >> "$TMP/src/man8/amd64/zap.8"
+
+	mandoc -T html -O site="$TMP/site" -M "$TMP/src"
+	has site/link "$TMP/site/man1/links.1.html" \
+	    'href="../man8/tool.8.html"'
+	has site/arch "$TMP/site/man1/links.1.html" \
+	    'href="../man8/amd64/zap.8.html"'
+	has site/up "$TMP/site/man8/amd64/zap.8.html" \
+	    'href="../../man1/links.1.html"'
+	has site/index "$TMP/site/man9/index.html" 'href="kf.9.html"'
+	count=$((count + 1))
+	grep -q 'href="[^"]*missing' "$TMP/site/man1/links.1.html" &&
+	    fail site/missing
+
+	# Output of removed pages is deleted.
+	rm -r "$TMP/src/man8/tool.8" "$TMP/src/man9"
+	mandoc -T html -O site="$TMP/site" -M "$TMP/src"
+	count=$((count + 1))
+	[ -e "$TMP/site/man8/tool.8.html" ] && fail site/removed
+	count=$((count + 1))
+	[ -e "$TMP/site/man9" ] && fail site/section
+	count=$((count + 1))
+	[ -e "$TMP/site/man8/amd64/zap.8.html" ] || fail site/kept
+	count=$((count + 1))
+	grep -q 'href="../man8/tool.8.html"' \
+	    "$TMP/site/man1/links.1.html" && fail site/relink
+	rm -rf "$TMP/src" "$TMP/site"
+}
+
+# --- -j ---------------------------------------------------------------
+
+test_jobs() {
+	for i in 1 2 3 4 5; do
+		sed "s/^\.Nm warn/.Nm warn$i/" "$TMP/warn.1" > "$TMP/warn$i.1"
+	done
+	(cd "$TMP" && mandoc -W all -T ascii warn[1-5].1) \
+	    > "$TMP/plain" 2> "$TMP/plainerr"
+	(cd "$TMP" && mandoc -W all -T ascii -j 3 warn[1-5].1) \
+	    > "$TMP/jobs" 2> "$TMP/jobserr"
+	same jobs/output "$TMP/plain" "$TMP/jobs"
+	same jobs/messages "$TMP/plainerr" "$TMP/jobserr"
+	status jobs/status 2 mandoc -W warning -T ascii -j 3 "$TMP/warn1.1"
+	status jobs/apropos 5 apropos -j 2 warn
+	status jobs/whatis 5 whatis -j 2 warn
+}
+
+# --- -O stream --------------------------------------------------------
+
+test_stream() {
+	for file in mdoc/Sh/first.in mdoc/Bl/nested.in mdoc/Xr/args.in \
+	    man/SH/broken.in man/RS/nested.in man/TP/vert.in; do
+		mandoc -T ascii "$file" > "$TMP/plain" 2>&1
+		mandoc -T ascii -O stream "$file" > "$TMP/stream" 2>&1
+		same "stream/$file" "$TMP/plain" "$TMP/stream"
+	done
+
+	# The formatter state must be reset between documents.
+	mandoc -T ascii man/RS/nested.in mdoc/Bl/nested.in \
+	    man/TP/vert.in > "$TMP/plain" 2>&1
+	mandoc -T ascii -O stream man/RS/nested.in mdoc/Bl/nested.in \
+	    man/TP/vert.in > "$TMP/stream" 2>&1
+	same stream/multiple "$TMP/plain" "$TMP/stream"
+}
+
+# --- makewhatis -s and -j ---------------------------------------------
+
+# Usage: mktree dir
+mktree() {
+	mkdir -p "$1/man1/amd64" "$1/man1/i386" "$1/man8"
+	cp "$TMP/warn.1" "$1/man1/warn.1"
+	sed 's/^\.Dt .*/.Dt ARCHCMD 1/; s/^\.Nm .*/.Nm archcmd/' \
+	    "$TMP/warn.1" > "$1/man1/amd64/archcmd.1"
+	cp "$1/man1/amd64/archcmd.1" "$1/man1/i386/archcmd.1"
+	for i in 1 2 3 4; do
+		sed "s/^\.Dt .*/.Dt TOOL$i 8/; s/^\.Nm .*/.Nm tool$i/" \
+		    "$TMP/warn.1" > "$1/man8/tool$i.8"
+	done
+}
+
+test_makewhatis() {
+	mktree "$TMP/plain.d"
+	mktree "$TMP/jobs.d"
+	mktree "$TMP/links.d"
+	mktree "$TMP/dedup.d"
+	ln -f "$TMP/links.d/man1/amd64/archcmd.1" \
+	    "$TMP/links.d/man1/i386/archcmd.1"
+
+	# With -j, the database is the same as without.
+	makewhatis "$TMP/plain.d"
+	makewhatis -j 3 "$TMP/jobs.d"
+	same makewhatis/jobs "$TMP/plain.d/mandoc.db" "$TMP/jobs.d/mandoc.db"
+
+	# With -s, identical files are indexed like hard links.
+	makewhatis "$TMP/links.d"
+	makewhatis -s "$TMP/dedup.d"
+	same makewhatis/dedup "$TMP/links.d/mandoc.db" "$TMP/dedup.d/mandoc.db"
+	makewhatis -s -j 3 "$TMP/dedup.d"
+	same makewhatis/dedup-jobs "$TMP/links.d/mandoc.db" \
+	    "$TMP/dedup.d/mandoc.db"
+	rm -rf "$TMP/plain.d" "$TMP/jobs.d" "$TMP/links.d" "$TMP/dedup.d"
+}
+
+# --- apropos -D -------------------------------------------------------
+
+test_server() {
+	mktree "$TMP/tree.d"
+	makewhatis "$TMP/tree.d"
+	apropos -D "$TMP/sock" &
+	server=$!
+	i=0
+	while [ ! -S "$TMP/sock" ] && [ $i -lt 50 ]; do
+		sleep 0.1
+		i=$((i + 1))
+	done
+
+	apropos -M "$TMP/tree.d" -s 8 tool > "$TMP/answer" 2>&1
+	MANSOCKET="$TMP/sock" apropos -M "$TMP/tree.d" -s 8 tool \
+	    > "$TMP/second" 2>&1
+	same server/apropos "$TMP/answer" "$TMP/second"
+	whatis -M "$TMP/tree.d" archcmd > "$TMP/plain" 2>&1
+	MANSOCKET="$TMP/sock" whatis -M "$TMP/tree.d" archcmd \
+	    > "$TMP/second" 2>&1
+	same server/whatis "$TMP/plain" "$TMP/second"
+	man -w -M "$TMP/tree.d" tool3 > "$TMP/plain" 2>&1
+	MANSOCKET="$TMP/sock" man -w -M "$TMP/tree.d" tool3 \
+	    > "$TMP/second" 2>&1
+	same server/man "$TMP/plain" "$TMP/second"
+
+	# A client sending an incomplete request must not block others.
+	perl -MIO::Socket::UNIX -e '$| = 1;
+	    $s = IO::Socket::UNIX->new(Peer => $ARGV[0]) or die;
+	    print $s "\x40\0"; sleep 8' "$TMP/sock" &
+	slow=$!
+	sleep 1
+	start=$(date +%s)
+	MANSOCKET="$TMP/sock" apropos -M "$TMP/tree.d" -s 8 tool \
+	    > "$TMP/second" 2>&1
+	end=$(date +%s)
+	same server/slow "$TMP/answer" "$TMP/second"
+	count=$((count + 1))
+	[ $((end - start)) -lt 5 ] || fail server/blocked
+
+	# Counts larger than the request are rejected before allocating.
+	perl -MIO::Socket::UNIX -e '
+	    $s = IO::Socket::UNIX->new(Peer => $ARGV[0]) or die;
+	    $m = "0\0" x 3 . "-\0" x 3 . "60000000\0";
+	    print $s pack("L", length $m) . $m; sysread $s, $b, 1' \
+	    "$TMP/sock"
+	count=$((count + 1))
+	kill -0 $server 2> /dev/null || fail server/count
+	kill $slow $server 2> /dev/null
+	wait
+	rm -rf "$TMP/tree.d" "$TMP/sock"
+}
+
+# --- main program -----------------------------------------------------
+
+test_cache
+test_compress
+test_lint
+test_include
+test_site
+test_jobs
+test_stream
+test_makewhatis
+test_server
+
+if [ "$failed" -gt 0 ]; then
+	echo "NUMBER OF FAILED TESTS: $failed (of $count tests run.)"
+	exit 1
+fi
+echo "All $count command line tests OK."
+exit 0
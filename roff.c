@@ -37,6 +37,7 @@
 #include "mandoc_parse.h"
 #include "libmandoc.h"
 #include "roff_int.h"
+#include "tag.h"
 #include "tbl_parse.h"
 #include "eqn_parse.h"
 
@@ -629,22 +630,46 @@ static	int	 roffce_lines;	/* number of input lines to center */
 static	struct roff_node *roffce_node;  /* active request */
 static	int	 roffit_lines;  /* number of lines to delay */
 static	char	*roffit_macro;  /* nil-terminated macro line */
+static	struct ohash roffhash_tabs[3];  /* requests, mdoc, man macros */
 
 
 /* --- request table ------------------------------------------------------ */
 
+/*
+ * Return the lookup table for the requests or the macros
+ * starting at mintok.  The tables never change after they are
+ * built, so they are built once and shared by all parsers until
+ * roffhash_freeall() is called.  Renamed and user-defined requests
+ * are looked up per parser before consulting these tables.
+ */
 struct ohash *
-roffhash_alloc(enum roff_tok mintok, enum roff_tok maxtok)
+roffhash_get(enum roff_tok mintok)
 {
-	struct ohash	*htab;
-	struct roffreq	*req;
-	enum roff_tok	 tok;
-	size_t		 sz;
-	unsigned int	 slot;
+	struct ohash		*htab;
+	struct roffreq		*req;
+	enum roff_tok		 tok, maxtok;
+	size_t			 sz;
+	unsigned int		 slot;
+
+	switch (mintok) {
+	case MDOC_Dd:
+		htab = roffhash_tabs + 1;
+		maxtok = MDOC_MAX;
+		break;
+	case MAN_TH:
+		htab = roffhash_tabs + 2;
+		maxtok = MAN_MAX;
+		break;
+	default:
+		assert(mintok == 0);
+		htab = roffhash_tabs;
+		maxtok = ROFF_RENAMED;
+		break;
+	}
+	if (htab->info.free != NULL)
+		return htab;
 
-	htab = mandoc_malloc(sizeof(*htab));
 	mandoc_ohash_init(htab, 8, offsetof(struct roffreq, name));
-
 	for (tok = mintok; tok < maxtok; tok++) {
 		if (roff_name[tok] == NULL)
 			continue;
@@ -658,19 +683,26 @@ roffhash_alloc(enum roff_tok mintok, enum roff_tok maxtok)
 	return htab;
 }
 
+/*
+ * Free the shared lookup tables.
+ * Call this only after all parsers have been freed.
+ */
 void
-roffhash_free(struct ohash *htab)
+roffhash_freeall(void)
 {
+	struct ohash	*htab;
 	struct roffreq	*req;
 	unsigned int	 slot;
 
-	if (htab == NULL)
-		return;
-	for (req = ohash_first(htab, &slot); req != NULL;
-	     req = ohash_next(htab, &slot))
-		free(req);
-	ohash_delete(htab);
-	free(htab);
+	for (htab = roffhash_tabs; htab < roffhash_tabs + 3; htab++) {
+		if (htab->info.free == NULL)
+			continue;
+		for (req = ohash_first(htab, &slot); req != NULL;
+		     req = ohash_next(htab, &slot))
+			free(req);
+		ohash_delete(htab);
+		htab->info.free = NULL;
+	}
 }
 
 enum roff_tok
@@ -792,7 +824,6 @@ roff_free(struct roff *r)
 	for (i = 0; i < r->mstacksz; i++)
 		free(r->mstack[i].argv);
 	free(r->mstack);
-	roffhash_free(r->reqtab);
 	free(r);
 }
 
@@ -802,7 +833,7 @@ roff_alloc(int options)
 	struct roff	*r;
 
 	r = mandoc_calloc(1, sizeof(struct roff));
-	r->reqtab = roffhash_alloc(0, ROFF_RENAMED);
+	r->reqtab = roffhash_get(0);
 	r->options = options | MPARSE_COMMENT;
 	r->format = options & (MPARSE_MDOC | MPARSE_MAN);
 	r->mstackpos = -1;
@@ -1098,6 +1129,8 @@ void
 roff_node_free(struct roff_node *n)
 {
 
+	if (n->flags & NODE_ID)
+		tag_unlink(n);
 	if (n->args != NULL)
 		mdoc_argv_free(n->args);
 	if (n->type == ROFFT_BLOCK || n->type == ROFFT_ELEM)
@@ -39,9 +39,9 @@
 #include "tag.h"
 
 struct tag_entry {
-	struct roff_node **nodes;
-	size_t	 maxnodes;
-	size_t	 nnodes;
+	size_t	*slots;		/* Indices into tag_nodes[]. */
+	size_t	 maxslots;
+	size_t	 nslots;
 	int	 prio;
 	char	 s[];
 };
@@ -49,9 +49,18 @@ struct tag_entry {
 static void		 tag_move_href(struct roff_man *,
 				struct roff_node *, const char *);
 static void		 tag_move_id(struct roff_node *);
+static void		 tag_node(struct roff_man *, struct roff_node *);
 
 static struct ohash	 tag_data;
 
+/*
+ * All tagged nodes in the order they were tagged.
+ * Nodes that lost their tag or were freed are replaced with NULL.
+ */
+static struct roff_node	**tag_nodes;
+static size_t		  tag_maxnodes;
+static size_t		  tag_nnodes;
+
 
 /*
  * Set up the ohash table to collect nodes
@@ -73,12 +82,51 @@ tag_free(void)
 		return;
 	entry = ohash_first(&tag_data, &slot);
 	while (entry != NULL) {
-		free(entry->nodes);
+		free(entry->slots);
 		free(entry);
 		entry = ohash_next(&tag_data, &slot);
 	}
 	ohash_delete(&tag_data);
 	tag_data.info.free = NULL;
+	free(tag_nodes);
+	tag_nodes = NULL;
+	tag_maxnodes = tag_nnodes = 0;
+}
+
+/*
+ * Forget which nodes carry each tag, for example because they
+ * were already formatted and are about to be freed, but remember
+ * the tags and their priorities.
+ */
+void
+tag_forget(void)
+{
+	struct tag_entry	*entry;
+	unsigned int		 slot;
+
+	entry = ohash_first(&tag_data, &slot);
+	while (entry != NULL) {
+		entry->nslots = 0;
+		entry = ohash_next(&tag_data, &slot);
+	}
+	tag_nnodes = 0;
+}
+
+/*
+ * The node is about to be freed.
+ * If it is still tagged, do not touch it later.
+ */
+void
+tag_unlink(const struct roff_node *n)
+{
+	size_t	 i;
+
+	for (i = tag_nnodes; i > 0; i--) {
+		if (tag_nodes[i - 1] == n) {
+			tag_nodes[i - 1] = NULL;
+			break;
+		}
+	}
 }
 
 /*
@@ -92,7 +140,7 @@ tag_put(const char *s, int prio, struct roff_node *n)
 	struct roff_node	*nold;
 	const char		*se, *src;
 	char			*cpy;
-	size_t			 len;
+	size_t			 i, len;
 	unsigned int		 slot;
 	int			 changed;
 
@@ -182,8 +230,8 @@ tag_put(const char *s, int prio, struct roff_node *n)
 	if (entry == NULL) {
 		entry = mandoc_malloc(sizeof(*entry) + len + 1);
 		memcpy(entry->s, s, len + 1);
-		entry->nodes = NULL;
-		entry->maxnodes = entry->nnodes = 0;
+		entry->slots = NULL;
+		entry->maxslots = entry->nslots = 0;
 		ohash_insert(&tag_data, slot, entry);
 	}
 
@@ -202,8 +250,11 @@ tag_put(const char *s, int prio, struct roff_node *n)
 	 */
 
 	else if (entry->prio > prio || prio == TAG_FALLBACK) {
-		while (entry->nnodes > 0) {
-			nold = entry->nodes[--entry->nnodes];
+		while (entry->nslots > 0) {
+			i = entry->slots[--entry->nslots];
+			if ((nold = tag_nodes[i]) == NULL)
+				continue;
+			tag_nodes[i] = NULL;
 			nold->flags &= ~NODE_ID;
 			free(nold->tag);
 			nold->tag = NULL;
@@ -216,12 +267,18 @@ tag_put(const char *s, int prio, struct roff_node *n)
 
 	/* Remember the new node. */
 
-	if (entry->maxnodes == entry->nnodes) {
-		entry->maxnodes += 4;
-		entry->nodes = mandoc_reallocarray(entry->nodes,
-		    entry->maxnodes, sizeof(*entry->nodes));
+	if (entry->maxslots == entry->nslots) {
+		entry->maxslots += 4;
+		entry->slots = mandoc_reallocarray(entry->slots,
+		    entry->maxslots, sizeof(*entry->slots));
+	}
+	if (tag_maxnodes == tag_nnodes) {
+		tag_maxnodes = tag_maxnodes == 0 ? 64 : tag_maxnodes * 2;
+		tag_nodes = mandoc_reallocarray(tag_nodes,
+		    tag_maxnodes, sizeof(*tag_nodes));
 	}
-	entry->nodes[entry->nnodes++] = n;
+	entry->slots[entry->nslots++] = tag_nnodes;
+	tag_nodes[tag_nnodes++] = n;
 	entry->prio = prio;
 	n->flags |= NODE_ID;
 	if (changed) {
@@ -339,35 +396,63 @@ tag_move_href(struct roff_man *man, struct roff_node *n, const char *tag)
  * the associated permalinks, and maybe move some tags
  * to the beginning of the respective paragraphs.
  */
-void
-tag_postprocess(struct roff_man *man, struct roff_node *n)
+static void
+tag_node(struct roff_man *man, struct roff_node *n)
 {
-	if (n->flags & NODE_ID) {
-		switch (n->tok) {
-		case MDOC_Pp:
-			tag_move_href(man, n->next, n->tag);
-			break;
-		case MDOC_Bd:
-		case MDOC_D1:
-		case MDOC_Dl:
-			tag_move_href(man, n->child, n->tag);
-			break;
-		case MDOC_Bl:
-			/* XXX No permalink for now. */
-			break;
-		default:
-			if (n->type == ROFFT_ELEM || n->tok == MDOC_Fo)
-				tag_move_id(n);
-			if (n->tok != MDOC_Tg)
-				n->flags |= NODE_HREF;
-			else if ((n->flags & NODE_ID) == 0) {
-				n->flags |= NODE_NOPRT;
-				free(n->tag);
-				n->tag = NULL;
-			}
-			break;
+	if ((n->flags & NODE_ID) == 0)
+		return;
+	switch (n->tok) {
+	case MDOC_Pp:
+		tag_move_href(man, n->next, n->tag);
+		break;
+	case MDOC_Bd:
+	case MDOC_D1:
+	case MDOC_Dl:
+		tag_move_href(man, n->child, n->tag);
+		break;
+	case MDOC_Bl:
+		/* XXX No permalink for now. */
+		break;
+	default:
+		if (n->type == ROFFT_ELEM || n->tok == MDOC_Fo)
+			tag_move_id(n);
+		if (n->tok != MDOC_Tg)
+			n->flags |= NODE_HREF;
+		else if ((n->flags & NODE_ID) == 0) {
+			n->flags |= NODE_NOPRT;
+			free(n->tag);
+			n->tag = NULL;
 		}
+		break;
 	}
+}
+
+/*
+ * Postprocess the tagged nodes in the subtree below n,
+ * for use while the rest of the document is still being parsed.
+ */
+void
+tag_postprocess(struct roff_man *man, struct roff_node *n)
+{
+	tag_node(man, n);
 	for (n = n->child; n != NULL; n = n->next)
 		tag_postprocess(man, n);
 }
+
+/*
+ * Postprocess all tagged nodes of a completely validated document
+ * without walking the whole syntax tree.  In-line macros are tagged
+ * in document order, so the first one in each paragraph still wins
+ * in tag_move_id(), and nodes receiving a tag from there are never
+ * postprocessed, just like during a walk, where they come earlier.
+ */
+void
+tag_postprocess_all(struct roff_man *man)
+{
+	size_t	 i;
+
+	for (i = 0; i < tag_nnodes; i++)
+		if (tag_nodes[i] != NULL)
+			tag_node(man, tag_nodes[i]);
+	tag_forget();
+}
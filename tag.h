@@ -32,4 +32,7 @@ void		 tag_alloc(void);
 int		 tag_exists(const char *);
 void		 tag_put(const char *, int, struct roff_node *);
 void		 tag_postprocess(struct roff_man *, struct roff_node *);
+void		 tag_postprocess_all(struct roff_man *);
+void		 tag_forget(void);
+void		 tag_unlink(const struct roff_node *);
 void		 tag_free(void);
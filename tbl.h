@@ -98,6 +98,10 @@ struct	tbl_dat {
 	int		  vspans;  /* How many vertical spans follow. */
 	int		  block;   /* T{ text block T} */
 	enum tbl_datt	  pos;
+	const void	 *wkey;    /* Formatter that measured the cell. */
+	size_t		  width;   /* Width of the string. */
+	size_t		  intwidth; /* Integer part, or SIZE_MAX if none. */
+	int		  intdone; /* Whether intwidth was measured. */
 };
 
 enum	tbl_spant {
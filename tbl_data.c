@@ -100,6 +100,7 @@ getdata(struct tbl_node *tbl, struct tbl_span *dp,
 	dat->vspans = 0;
 	dat->block = 0;
 	dat->pos = TBL_DATA_NONE;
+	dat->wkey = NULL;
 
 	/*
 	 * Increment the number of vertical spans in a data cell above,
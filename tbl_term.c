@@ -20,7 +20,7 @@
 #include <sys/types.h>
 
 #include <assert.h>
-#include <ctype.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -42,7 +42,7 @@ static	size_t	term_tbl_strlen(const char *, void *);
 static	size_t	term_tbl_sulen(const struct roffsu *, void *);
 static	void	tbl_data(struct termp *, const struct tbl_opts *,
 			const struct tbl_cell *,
-			const struct tbl_dat *,
+			struct tbl_dat *,
 			const struct roffcol *);
 static	void	tbl_direct_border(struct termp *, int, size_t);
 static	void	tbl_fill_border(struct termp *, int, size_t);
@@ -51,10 +51,10 @@ static	void	tbl_fill_string(struct termp *, const char *, size_t);
 static	void	tbl_hrule(struct termp *, const struct tbl_span *,
 			const struct tbl_span *, const struct tbl_span *,
 			int);
-static	void	tbl_literal(struct termp *, const struct tbl_dat *,
-			const struct roffcol *);
+static	void	tbl_literal(struct termp *, const struct tbl_opts *,
+			struct tbl_dat *, const struct roffcol *);
 static	void	tbl_number(struct termp *, const struct tbl_opts *,
-			const struct tbl_dat *,
+			struct tbl_dat *,
 			const struct roffcol *);
 static	void	tbl_word(struct termp *, const struct tbl_dat *);
 
@@ -165,7 +165,7 @@ void
 term_tbl(struct termp *tp, const struct tbl_span *sp)
 {
 	const struct tbl_cell	*cp, *cpn, *cpp, *cps;
-	const struct tbl_dat	*dp;
+	struct tbl_dat		*dp;
 	static size_t		 offset;
 	size_t			 save_offset;
 	size_t			 coloff, tsz;
@@ -713,7 +713,7 @@ tbl_hrule(struct termp *tp, const struct tbl_span *spp,
 
 static void
 tbl_data(struct termp *tp, const struct tbl_opts *opts,
-    const struct tbl_cell *cp, const struct tbl_dat *dp,
+    const struct tbl_cell *cp, struct tbl_dat *dp,
     const struct roffcol *col)
 {
 	switch (cp->pos) {
@@ -750,7 +750,7 @@ tbl_data(struct termp *tp, const struct tbl_opts *opts,
 	case TBL_CELL_CENTRE:
 	case TBL_CELL_LEFT:
 	case TBL_CELL_RIGHT:
-		tbl_literal(tp, dp, col);
+		tbl_literal(tp, opts, dp, col);
 		break;
 	case TBL_CELL_NUMBER:
 		tbl_number(tp, opts, dp, col);
@@ -809,14 +809,15 @@ tbl_direct_border(struct termp *tp, int c, size_t len)
 }
 
 static void
-tbl_literal(struct termp *tp, const struct tbl_dat *dp,
-		const struct roffcol *col)
+tbl_literal(struct termp *tp, const struct tbl_opts *opts,
+		struct tbl_dat *dp, const struct roffcol *col)
 {
 	size_t		 len, padl, padr, width;
 	int		 ic, hspans;
 
 	assert(dp->string);
-	len = term_strlen(tp, dp->string);
+	tblcalc_cell(&tp->tbl, opts, dp, 0);
+	len = dp->width;
 	width = col->width;
 	ic = dp->layout->col;
 	hspans = dp->hspans;
@@ -855,45 +856,23 @@ tbl_literal(struct termp *tp, const struct tbl_dat *dp,
 
 static void
 tbl_number(struct termp *tp, const struct tbl_opts *opts,
-		const struct tbl_dat *dp,
+		struct tbl_dat *dp,
 		const struct roffcol *col)
 {
-	const char	*cp, *lastdigit, *lastpoint;
 	size_t		 intsz, padl, totsz;
-	char		 buf[2];
 
 	/*
-	 * Almost the same code as in tblcalc_number():
-	 * First find the position of the decimal point.
+	 * The widths were already measured by tblcalc_number(),
+	 * unless the cell spans columns.
 	 */
 
 	assert(dp->string);
-	lastdigit = lastpoint = NULL;
-	for (cp = dp->string; cp[0] != '\0'; cp++) {
-		if (cp[0] == '\\' && cp[1] == '&') {
-			lastdigit = lastpoint = cp;
-			break;
-		} else if (cp[0] == opts->decimal &&
-		    (isdigit((unsigned char)cp[1]) ||
-		     (cp > dp->string && isdigit((unsigned char)cp[-1]))))
-			lastpoint = cp;
-		else if (isdigit((unsigned char)cp[0]))
-			lastdigit = cp;
-	}
-
-	/* Then measure both widths. */
+	tblcalc_cell(&tp->tbl, opts, dp, 1);
+	totsz = dp->width;
+	intsz = dp->intwidth;
 
 	padl = 0;
-	totsz = term_strlen(tp, dp->string);
-	if (lastdigit != NULL) {
-		if (lastpoint == NULL)
-			lastpoint = lastdigit + 1;
-		intsz = 0;
-		buf[1] = '\0';
-		for (cp = dp->string; cp < lastpoint; cp++) {
-			buf[0] = cp[0];
-			intsz += term_strlen(tp, buf);
-		}
+	if (intsz != SIZE_MAX) {
 
 		/*
 		 * Pad left to match the decimal position,
@@ -37,6 +37,7 @@ static	void		 adjbuf(struct termp_col *, size_t);
 static	void		 bufferc(struct termp *, char);
 static	void		 encode(struct termp *, const char *, size_t);
 static	void		 encode1(struct termp *, int);
+static	void		 putbuf(struct termp *, size_t, int);
 static	void		 endline(struct termp *);
 static	void		 term_field(struct termp *, size_t, size_t);
 static	void		 term_fill(struct termp *, size_t *, size_t *,
@@ -59,10 +60,13 @@ void
 term_free(struct termp *p)
 {
 	term_tab_free();
-	for (p->tcol = p->tcols; p->tcol < p->tcols + p->maxtcol; p->tcol++)
+	for (p->tcol = p->tcols; p->tcol < p->tcols + p->maxtcol; p->tcol++) {
 		free(p->tcol->buf);
+		free(p->tcol->wbuf);
+	}
 	free(p->tcols);
 	free(p->fontq);
+	free(p->mt);
 	free(p);
 }
 
@@ -178,7 +182,7 @@ term_flushln(struct termp *p)
 				continue;
 			case ' ':
 				if (p->flags & TERMP_BRTRSP)
-					vbr += (*p->width)(p, ' ');
+					vbr += p->tcol->wbuf[ic];
 				continue;
 			case '\n':
 			case ASCII_NBRZW:
@@ -273,14 +277,14 @@ term_fill(struct termp *p, size_t *nbr, size_t *vbr, size_t vtarget)
 		switch (p->tcol->buf[ic]) {
 		case '\b':  /* Escape \o (overstrike) or backspace markup. */
 			assert(ic > 0);
-			vis -= (*p->width)(p, p->tcol->buf[ic - 1]);
+			vis -= p->tcol->wbuf[ic - 1];
 			continue;
 
 		case ' ':
 		case ASCII_BREAK:  /* Escape \: (breakpoint). */
 			vn = vis;
 			if (p->tcol->buf[ic] == ' ')
-				vn += (*p->width)(p, ' ');
+				vn += p->tcol->wbuf[ic];
 			/* Can break at the end of a word. */
 			if (breakline || vn > vtarget)
 				break;
@@ -302,10 +306,11 @@ term_fill(struct termp *p, size_t *nbr, size_t *vbr, size_t vtarget)
 			 * We are about to decide whether to break the
 			 * line or not, so we no longer need this hyphen
 			 * to be marked as breakable.  Put back a real
-			 * hyphen such that we get the correct width.
+			 * hyphen; its width was already stored as
+			 * the width of a real hyphen by putbuf().
 			 */
 			p->tcol->buf[ic] = '-';
-			vis += (*p->width)(p, '-');
+			vis += p->tcol->wbuf[ic];
 			if (vis > vtarget) {
 				ic++;
 				break;
@@ -334,7 +339,7 @@ term_fill(struct termp *p, size_t *nbr, size_t *vbr, size_t vtarget)
 				p->tcol->buf[ic] = ' ';
 				/* FALLTHROUGH */
 			default:  /* Printable character. */
-				vis += (*p->width)(p, p->tcol->buf[ic]);
+				vis += p->tcol->wbuf[ic];
 				break;
 			}
 			graph = 1;
@@ -398,7 +403,7 @@ term_field(struct termp *p, size_t vbl, size_t nbr)
 					vt = vis + taboff;
 				dv = term_tab_next(vt) - vt;
 			} else
-				dv = (*p->width)(p, ' ');
+				dv = p->tcol->wbuf[ic];
 			vbl += dv;
 			vis += dv;
 			continue;
@@ -421,11 +426,11 @@ term_field(struct termp *p, size_t vbl, size_t nbr)
 
 		(*p->letter)(p, p->tcol->buf[ic]);
 		if (p->tcol->buf[ic] == '\b') {
-			dv = (*p->width)(p, p->tcol->buf[ic - 1]);
+			dv = p->tcol->wbuf[ic - 1];
 			p->viscol -= dv;
 			vis -= dv;
 		} else {
-			dv = (*p->width)(p, p->tcol->buf[ic]);
+			dv = p->tcol->wbuf[ic];
 			p->viscol += dv;
 			vis += dv;
 		}
@@ -807,6 +812,21 @@ adjbuf(struct termp_col *c, size_t sz)
 	while (c->maxcols <= sz)
 		c->maxcols <<= 2;
 	c->buf = mandoc_reallocarray(c->buf, c->maxcols, sizeof(*c->buf));
+	c->wbuf = mandoc_reallocarray(c->wbuf, c->maxcols, sizeof(*c->wbuf));
+}
+
+/*
+ * Store one character in the output buffer together with its
+ * visual width, such that term_fill() and term_flushln() need
+ * not measure it again, no matter how often the line is filled.
+ * A breakable hyphen is measured as the real hyphen it will
+ * eventually be printed as.
+ */
+static void
+putbuf(struct termp *p, size_t ic, int c)
+{
+	p->tcol->buf[ic] = c;
+	p->tcol->wbuf[ic] = (*p->width)(p, c == ASCII_HYPH ? '-' : c);
 }
 
 static void
@@ -819,7 +839,7 @@ bufferc(struct termp *p, char c)
 	if (p->col + 1 >= p->tcol->maxcols)
 		adjbuf(p->tcol, p->col + 1);
 	if (p->tcol->lastcol <= p->col || (c != ' ' && c != ASCII_NBRSP))
-		p->tcol->buf[p->col] = c;
+		putbuf(p, p->col, c);
 	if (p->tcol->lastcol < ++p->col)
 		p->tcol->lastcol = p->col;
 }
@@ -858,22 +878,19 @@ encode1(struct termp *p, int c)
 		    p->tcol->buf[p->col - 1] == '\t')
 			p->col--;
 		else
-			p->tcol->buf[p->col++] = '\b';
+			putbuf(p, p->col++, '\b');
 		p->flags &= ~TERMP_BACKBEFORE;
 	}
 	if (f == TERMFONT_UNDER || f == TERMFONT_BI) {
-		p->tcol->buf[p->col++] = '_';
-		p->tcol->buf[p->col++] = '\b';
+		putbuf(p, p->col++, '_');
+		putbuf(p, p->col++, '\b');
 	}
 	if (f == TERMFONT_BOLD || f == TERMFONT_BI) {
-		if (c == ASCII_HYPH)
-			p->tcol->buf[p->col++] = '-';
-		else
-			p->tcol->buf[p->col++] = c;
-		p->tcol->buf[p->col++] = '\b';
+		putbuf(p, p->col++, c == ASCII_HYPH ? '-' : c);
+		putbuf(p, p->col++, '\b');
 	}
 	if (p->tcol->lastcol <= p->col || (c != ' ' && c != ASCII_NBRSP))
-		p->tcol->buf[p->col] = c;
+		putbuf(p, p->col, c);
 	if (p->tcol->lastcol < ++p->col)
 		p->tcol->lastcol = p->col;
 	if (p->flags & TERMP_BACKAFTER) {
@@ -903,7 +920,7 @@ encode(struct termp *p, const char *word, size_t sz)
 		else {
 			if (p->tcol->lastcol <= p->col ||
 			    (word[i] != ' ' && word[i] != ASCII_NBRSP))
-				p->tcol->buf[p->col] = word[i];
+				putbuf(p, p->col, word[i]);
 			p->col++;
 
 			/*
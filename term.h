@@ -37,6 +37,7 @@ enum	termfont {
 };
 
 struct	eqn_box;
+struct	mtermp;
 struct	roff_meta;
 struct	roff_node;
 struct	tbl_span;
@@ -51,6 +52,7 @@ struct	termp_tbl {
 
 struct	termp_col {
 	int		 *buf;		/* Output buffer. */
+	size_t		 *wbuf;		/* Visual width of each byte in buf. */
 	size_t		  maxcols;	/* Allocated bytes in buf. */
 	size_t		  lastcol;	/* Last byte in buf. */
 	size_t		  col;		/* Byte in buf to be written. */
@@ -76,6 +78,7 @@ struct	termp {
 	size_t		  minbl;	/* Minimum blanks before next field. */
 	int		  synopsisonly; /* Print the synopsis only. */
 	int		  mdocstyle;	/* Imitate mdoc(7) output. */
+	int		  docstate;	/* 0: idle, 1: head done, 2: body. */
 	int		  ti;		/* Temporary indent for one line. */
 	int		  skipvsp;	/* Vertical space to skip. */
 	int		  flags;
@@ -121,6 +124,8 @@ struct	termp {
 				const struct roffsu *);
 	const void	 *argf;		/* arg for headf/footf */
 	const char	 *mc;		/* Margin character. */
+	FILE		 *outfp;	/* Output stream. */
+	struct mtermp	 *mt;		/* Margins of man(7) documents. */
 	struct termp_ps	 *ps;
 };
 
@@ -37,6 +37,7 @@
 #include "mandoc_aux.h"
 #include "out.h"
 #include "term.h"
+#include "term_tag.h"
 #include "manconf.h"
 #include "main.h"
 
@@ -123,6 +124,7 @@ ascii_init(enum termenc enc, const struct manoutput *outopts)
 	}
 #endif
 
+	p->outfp = outopts->outfp == NULL ? stdout : outopts->outfp;
 	if (outopts->mdoc)
 		p->mdocstyle = 1;
 	if (outopts->indent)
@@ -209,7 +211,7 @@ static void
 ascii_letter(struct termp *p, int c)
 {
 
-	putchar(c);
+	putc(c, p->outfp);
 }
 
 static void
@@ -236,7 +238,8 @@ ascii_endline(struct termp *p)
 	else
 		p->tcol->offset = 0;
 	p->ti = 0;
-	putchar('\n');
+	putc('\n', p->outfp);
+	term_tag_line(p->line);
 }
 
 static void
@@ -253,7 +256,7 @@ ascii_advance(struct termp *p, size_t len)
 	if (len > 256)
 		len = 256;
 	for (i = 0; i < len; i++)
-		putchar(' ');
+		putc(' ', p->outfp);
 }
 
 static int
@@ -398,7 +401,7 @@ locale_advance(struct termp *p, size_t len)
 	if (len > 256)
 		len = 256;
 	for (i = 0; i < len; i++)
-		putwchar(L' ');
+		putwc(L' ', p->outfp);
 }
 
 static void
@@ -411,13 +414,14 @@ locale_endline(struct termp *p)
 	else 
 		p->tcol->offset = 0;
 	p->ti = 0;
-	putwchar(L'\n');
+	putwc(L'\n', p->outfp);
+	term_tag_line(p->line);
 }
 
 static void
 locale_letter(struct termp *p, int c)
 {
 
-	putwchar(c);
+	putwc(c, p->outfp);
 }
 #endif
@@ -30,8 +30,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <zlib.h>
 
 #include "mandoc_aux.h"
+#include "mandoc.h"
 #include "out.h"
 #include "term.h"
 #include "manconf.h"
@@ -91,6 +93,12 @@ struct	termp_ps {
 	size_t		  pdfbody;	/* start of body object */
 	size_t		 *pdfobjs;	/* table of object offsets */
 	size_t		  pdfobjsz;	/* size of pdfobjs */
+	char		 *psout;	/* output buf, one page at a time */
+	size_t		  psoutsz;	/* output buf size */
+	size_t		  psoutcur;	/* cur index in output buf */
+	size_t		  pdfzstart;	/* index of page content in psout */
+	int		  pdfzpage;	/* page content to be compressed */
+	int		  compress;	/* -O compress: FlateDecode pages */
 };
 
 static	int		  ps_hspan(const struct termp *,
@@ -101,7 +109,9 @@ static	void		  ps_begin(struct termp *);
 static	void		  ps_closepage(struct termp *);
 static	void		  ps_end(struct termp *);
 static	void		  ps_endline(struct termp *);
+static	void		  ps_flush(struct termp *);
 static	void		  ps_growbuf(struct termp *, size_t);
+static	void		  ps_growout(struct termp *, size_t);
 static	void		  ps_letter(struct termp *, int);
 static	void		  ps_pclose(struct termp *);
 static	void		  ps_plast(struct termp *);
@@ -109,10 +119,12 @@ static	void		  ps_pletter(struct termp *, int);
 static	void		  ps_printf(struct termp *, const char *, ...)
 				__attribute__((__format__ (__printf__, 2, 3)));
 static	void		  ps_putchar(struct termp *, char);
+static	void		  ps_puts(struct termp *, const char *, size_t);
 static	void		  ps_setfont(struct termp *, enum termfont);
 static	void		  ps_setwidth(struct termp *, int, int);
 static	struct termp	 *pspdf_alloc(const struct manoutput *, enum termtype);
 static	void		  pdf_obj(struct termp *, size_t);
+static	size_t		  pdf_zflush(struct termp *);
 
 /*
  * We define, for the time being, three fonts: bold, oblique/italic, and
@@ -535,12 +547,14 @@ pspdf_alloc(const struct manoutput *outopts, enum termtype type)
 	p->tcol = p->tcols = mandoc_calloc(1, sizeof(*p->tcol));
 	p->maxtcol = 1;
 	p->type = type;
+	p->outfp = outopts->outfp == NULL ? stdout : outopts->outfp;
 
 	p->enc = TERMENC_ASCII;
 	p->fontq = mandoc_reallocarray(NULL,
 	    (p->fontsz = 8), sizeof(*p->fontq));
 	p->fontq[0] = p->fontl = TERMFONT_NONE;
 	p->ps = mandoc_calloc(1, sizeof(*p->ps));
+	p->ps->compress = type == TERMTYPE_PDF && outopts->compress;
 
 	p->advance = ps_advance;
 	p->begin = ps_begin;
@@ -648,6 +662,7 @@ pspdf_free(void *arg)
 
 	free(p->ps->psmarg);
 	free(p->ps->pdfobjs);
+	free(p->ps->psout);
 
 	free(p->ps);
 	term_free(p);
@@ -656,38 +671,56 @@ pspdf_free(void *arg)
 static void
 ps_printf(struct termp *p, const char *fmt, ...)
 {
-	va_list		 ap;
-	int		 pos, len;
-
-	va_start(ap, fmt);
+	va_list		 ap, aq;
+	char		*buf;
+	size_t		 avail;
+	int		 len;
 
 	/*
-	 * If we're running in regular mode, then pipe directly into
-	 * vprintf().  If we're processing margins, then push the data
-	 * into our growable margin buffer.
+	 * If we're processing margins, then push the data into our
+	 * growable margin buffer, otherwise into the output buffer
+	 * holding the current page.  Format in place into the space
+	 * left, and only if that doesn't suffice, grow and retry.
 	 */
 
-	if ( ! (PS_MARGINS & p->ps->flags)) {
-		len = vprintf(fmt, ap);
-		va_end(ap);
-		p->ps->pdfbytes += len < 0 ? 0 : (size_t)len;
-		return;
+	if (PS_MARGINS & p->ps->flags) {
+		ps_growbuf(p, PS_BUFSLOP);
+		buf = p->ps->psmarg + p->ps->psmargcur;
+		avail = p->ps->psmargsz - p->ps->psmargcur;
+	} else {
+		ps_growout(p, PS_BUFSLOP);
+		buf = p->ps->psout + p->ps->psoutcur;
+		avail = p->ps->psoutsz - p->ps->psoutcur;
 	}
 
-	/*
-	 * XXX: I assume that the in-margin print won't exceed
-	 * PS_BUFSLOP (128 bytes), which is reasonable but still an
-	 * assumption that will cause pukeage if it's not the case.
-	 */
-
-	ps_growbuf(p, PS_BUFSLOP);
-
-	pos = (int)p->ps->psmargcur;
-	vsnprintf(&p->ps->psmarg[pos], PS_BUFSLOP, fmt, ap);
-
+	va_start(ap, fmt);
+	va_copy(aq, ap);
+	len = vsnprintf(buf, avail, fmt, ap);
 	va_end(ap);
+	if (len < 0) {
+		va_end(aq);
+		return;
+	}
 
-	p->ps->psmargcur = strlen(p->ps->psmarg);
+	if ((size_t)len >= avail) {
+		if (PS_MARGINS & p->ps->flags) {
+			ps_growbuf(p, (size_t)len + 1);
+			buf = p->ps->psmarg + p->ps->psmargcur;
+		} else {
+			ps_growout(p, (size_t)len + 1);
+			buf = p->ps->psout + p->ps->psoutcur;
+		}
+		vsnprintf(buf, (size_t)len + 1, fmt, aq);
+	}
+	va_end(aq);
+
+	if (PS_MARGINS & p->ps->flags)
+		p->ps->psmargcur += len;
+	else {
+		p->ps->psoutcur += len;
+		if ( ! p->ps->pdfzpage)
+			p->ps->pdfbytes += len;
+	}
 }
 
 static void
@@ -698,8 +731,10 @@ ps_putchar(struct termp *p, char c)
 	/* See ps_printf(). */
 
 	if ( ! (PS_MARGINS & p->ps->flags)) {
-		putchar(c);
-		p->ps->pdfbytes++;
+		ps_growout(p, 1);
+		p->ps->psout[p->ps->psoutcur++] = c;
+		if ( ! p->ps->pdfzpage)
+			p->ps->pdfbytes++;
 		return;
 	}
 
@@ -710,6 +745,34 @@ ps_putchar(struct termp *p, char c)
 	p->ps->psmarg[pos] = '\0';
 }
 
+/*
+ * Append a string of known length to the output buffer.
+ * Not for use while processing margins.
+ */
+static void
+ps_puts(struct termp *p, const char *cp, size_t sz)
+{
+	assert( ! (PS_MARGINS & p->ps->flags));
+	ps_growout(p, sz);
+	memcpy(p->ps->psout + p->ps->psoutcur, cp, sz);
+	p->ps->psoutcur += sz;
+	if ( ! p->ps->pdfzpage)
+		p->ps->pdfbytes += sz;
+}
+
+/*
+ * Write out everything assembled in the output buffer.
+ */
+static void
+ps_flush(struct termp *p)
+{
+	assert( ! p->ps->pdfzpage);
+	if (p->ps->psoutcur == 0)
+		return;
+	fwrite(p->ps->psout, 1, p->ps->psoutcur, p->outfp);
+	p->ps->psoutcur = 0;
+}
+
 static void
 pdf_obj(struct termp *p, size_t obj)
 {
@@ -726,6 +789,43 @@ pdf_obj(struct termp *p, size_t obj)
 	ps_printf(p, "%zu 0 obj\n", obj);
 }
 
+/*
+ * Compress the content of the page just finished in place
+ * and return the compressed length.
+ */
+static size_t
+pdf_zflush(struct termp *p)
+{
+	Bytef		*zbuf;
+	uLongf		 zlen;
+	size_t		 start, len;
+	int		 rc;
+
+	/*
+	 * Compress into the free space behind the page content,
+	 * then move the result down to replace it.
+	 */
+
+	start = p->ps->pdfzstart;
+	len = p->ps->psoutcur - start;
+	zlen = compressBound(len);
+	ps_growout(p, zlen);
+	zbuf = (Bytef *)p->ps->psout + p->ps->psoutcur;
+	rc = compress2(zbuf, &zlen, (const Bytef *)p->ps->psout + start,
+	    len, Z_BEST_COMPRESSION);
+	if (rc != Z_OK)
+		errx((int)MANDOCLEVEL_SYSERR, "compress2: %s", zError(rc));
+	memmove(p->ps->psout + start, zbuf, zlen);
+	p->ps->psoutcur = start + zlen;
+	p->ps->pdfbytes += zlen;
+	p->ps->pdfzpage = 0;
+
+	/* Separate the binary data from the endstream keyword. */
+
+	ps_putchar(p, '\n');
+	return zlen;
+}
+
 static void
 ps_closepage(struct termp *p)
 {
@@ -740,10 +840,13 @@ ps_closepage(struct termp *p)
 	 */
 
 	assert(p->ps->psmarg && p->ps->psmarg[0]);
-	ps_printf(p, "%s", p->ps->psmarg);
+	ps_puts(p, p->ps->psmarg, p->ps->psmargcur);
 
 	if (TERMTYPE_PS != p->type) {
-		len = p->ps->pdfbytes - p->ps->pdflastpg;
+		if (p->ps->compress)
+			len = pdf_zflush(p);
+		else
+			len = p->ps->pdfbytes - p->ps->pdflastpg;
 		base = p->ps->pages * 4 + p->ps->pdfbody;
 
 		ps_printf(p, "endstream\nendobj\n");
@@ -771,6 +874,9 @@ ps_closepage(struct termp *p)
 	} else
 		ps_printf(p, "showpage\n");
 
+	/* The page is complete: write it out at once. */
+
+	ps_flush(p);
 	p->ps->pages++;
 	p->ps->psrow = p->ps->top;
 	assert( ! (PS_NEWPAGE & p->ps->flags));
@@ -801,6 +907,7 @@ ps_end(struct termp *p)
 		ps_printf(p, "%%%%Trailer\n");
 		ps_printf(p, "%%%%Pages: %zu\n", p->ps->pages);
 		ps_printf(p, "%%%%EOF\n");
+		ps_flush(p);
 		return;
 	}
 
@@ -842,6 +949,7 @@ ps_end(struct termp *p)
 	ps_printf(p, "startxref\n");
 	ps_printf(p, "%zu\n", xref);
 	ps_printf(p, "%%%%EOF\n");
+	ps_flush(p);
 }
 
 static void
@@ -929,7 +1037,7 @@ ps_begin(struct termp *p)
 		ps_printf(p, "%%%%EndFeature\n");
 		ps_printf(p, "%%%%EndSetup\n");
 	} else {
-		ps_printf(p, "%%PDF-1.1\n");
+		ps_printf(p, "%%PDF-1.%d\n", p->ps->compress ? 2 : 1);
 		pdf_obj(p, 1);
 		ps_printf(p, "<<\n");
 		ps_printf(p, ">>\n");
@@ -974,7 +1082,11 @@ ps_pletter(struct termp *p, int c)
 			ps_printf(p, "<<\n");
 			ps_printf(p, "/Length %zu 0 R\n",
 			    p->ps->pdfbody + 1 + p->ps->pages * 4);
+			if (p->ps->compress)
+				ps_printf(p, "/Filter /FlateDecode\n");
 			ps_printf(p, ">>\nstream\n");
+			p->ps->pdfzstart = p->ps->psoutcur;
+			p->ps->pdfzpage = p->ps->compress;
 		}
 		p->ps->pdflastpg = p->ps->pdfbytes;
 		p->ps->flags &= ~PS_NEWPAGE;
@@ -1360,3 +1472,16 @@ ps_growbuf(struct termp *p, size_t sz)
 	p->ps->psmargsz += sz;
 	p->ps->psmarg = mandoc_realloc(p->ps->psmarg, p->ps->psmargsz);
 }
+
+static void
+ps_growout(struct termp *p, size_t sz)
+{
+	if (p->ps->psoutcur + sz <= p->ps->psoutsz)
+		return;
+
+	if (p->ps->psoutsz == 0)
+		p->ps->psoutsz = 65536;
+	while (p->ps->psoutcur + sz > p->ps->psoutsz)
+		p->ps->psoutsz *= 2;
+	p->ps->psout = mandoc_realloc(p->ps->psout, p->ps->psoutsz);
+}
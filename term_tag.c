@@ -36,6 +36,7 @@
 #include "tag.h"
 #include "term_tag.h"
 
+static void tag_ready(char);
 static void tag_signal(int) __attribute__((__noreturn__));
 
 static struct tag_files tag_files;
@@ -57,6 +58,9 @@ term_tag_init(const char *outfilename, const char *suffix,
 	ofd = tfd = -1;
 	tag_files.tfs = NULL;
 	tag_files.tcpgid = -1;
+	tag_files.target = NULL;
+	tag_files.readyline = 0;
+	tag_files.readyfd = -1;
 
 	/* Clean up when dying from a signal. */
 
@@ -148,6 +152,31 @@ fail:
 	return NULL;
 }
 
+/*
+ * In a child process formatting for a pager that the parent process
+ * starts before formatting is complete, remember when to let it start:
+ * once the first screen of output is written, or if there is a tag
+ * target, the first screen starting at its first tagged line.
+ */
+void
+term_tag_early(int fd, const char *target, size_t lines)
+{
+	tag_files.readyfd = fd;
+	tag_files.target = target;
+	tag_files.readyline = lines;
+}
+
+/*
+ * Called by the terminal formatters after each output line.
+ */
+void
+term_tag_line(size_t line)
+{
+	if (tag_files.tfs != NULL && tag_files.readyfd != -1 &&
+	    tag_files.target == NULL && line >= tag_files.readyline)
+		tag_ready('y');
+}
+
 void
 term_tag_write(struct roff_node *n, size_t line)
 {
@@ -162,6 +191,39 @@ term_tag_write(struct roff_node *n, size_t line)
 	len = strcspn(cp, " \t\\");
 	fprintf(tag_files.tfs, "%.*s %s %zu\n",
 	    len, cp, tag_files.ofn, line);
+
+	if (tag_files.target != NULL &&
+	    strncmp(cp, tag_files.target, len) == 0 &&
+	    tag_files.target[len] == '\0') {
+		tag_files.target = NULL;
+		tag_files.readyline += line;
+	}
+
+	/* Once the pager runs, it may look up tags at any time. */
+
+	if (tag_files.readyline > 0 && tag_files.readyfd == -1)
+		fflush(tag_files.tfs);
+}
+
+/*
+ * Make the output written so far visible and let the parent process
+ * start the pager: 'y' if it can go to the tag target, if any,
+ * or 'n' if the tag target wasn't found.  Also pass the exit status
+ * so far, in case the parent does not wait for formatting to finish.
+ */
+static void
+tag_ready(char c)
+{
+	char	 buf[2];
+
+	fflush(stdout);
+	if (tag_files.tfs != NULL)
+		fflush(tag_files.tfs);
+	buf[0] = c;
+	buf[1] = (char)mandoc_msg_getrc();
+	(void)write(tag_files.readyfd, buf, sizeof(buf));
+	close(tag_files.readyfd);
+	tag_files.readyfd = -1;
 }
 
 /*
@@ -175,6 +237,8 @@ term_tag_close(void)
 {
 	int irc = 0;
 
+	if (tag_files.readyfd != -1)
+		tag_ready(tag_files.target == NULL ? 'y' : 'n');
 	if (tag_files.tfs != NULL) {
 		fclose(tag_files.tfs);
 		tag_files.tfs = NULL;
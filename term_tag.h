@@ -18,6 +18,8 @@
  * For use by the mandoc(1) ASCII and UTF-8 formatters only.
  */
 
+struct	roff_node;
+
 struct	tag_files {
 	char	 ofn[80];	/* Output file name. */
 	char	 tfn[80];	/* Tag file name. */
@@ -25,10 +27,15 @@ struct	tag_files {
 	int	 ofd;		/* Original output file descriptor. */
 	pid_t	 tcpgid;	/* Process group controlling the terminal. */
 	pid_t	 pager_pid;	/* Process ID of the pager. */
+	const char *target;	/* Tag the early pager starts at. */
+	size_t	 readyline;	/* Output line the early pager waits for. */
+	int	 readyfd;	/* Tell the early pager to start. */
 };
 
 
 struct tag_files	*term_tag_init(const char *, const char *, const char *);
+void			 term_tag_early(int, const char *, size_t);
+void			 term_tag_line(size_t);
 void			 term_tag_write(struct roff_node *, size_t);
 int			 term_tag_close(void);
 void			 term_tag_unlink(void);
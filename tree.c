@@ -44,22 +44,25 @@ static	void	print_meta(const struct roff_meta *);
 static	void	print_mdoc(const struct roff_node *, int);
 static	void	print_span(const struct tbl_span *, int);
 
+static	FILE	*outfp;	/* output stream */
 
 void
 tree_mdoc(void *arg, const struct roff_meta *mdoc)
 {
+	outfp = arg == NULL ? stdout : arg;
 	print_meta(mdoc);
-	putchar('\n');
+	putc('\n', outfp);
 	print_mdoc(mdoc->first->child, 0);
 }
 
 void
 tree_man(void *arg, const struct roff_meta *man)
 {
+	outfp = arg == NULL ? stdout : arg;
 	print_meta(man);
 	if (man->hasbody == 0)
-		puts("body  = empty");
-	putchar('\n');
+		fputs("body  = empty\n", outfp);
+	putc('\n', outfp);
 	print_man(man->first->child, 0);
 }
 
@@ -67,19 +70,19 @@ static void
 print_meta(const struct roff_meta *meta)
 {
 	if (meta->title != NULL)
-		printf("title = \"%s\"\n", meta->title);
+		fprintf(outfp, "title = \"%s\"\n", meta->title);
 	if (meta->name != NULL)
-		printf("name  = \"%s\"\n", meta->name);
+		fprintf(outfp, "name  = \"%s\"\n", meta->name);
 	if (meta->msec != NULL)
-		printf("sec   = \"%s\"\n", meta->msec);
+		fprintf(outfp, "sec   = \"%s\"\n", meta->msec);
 	if (meta->vol != NULL)
-		printf("vol   = \"%s\"\n", meta->vol);
+		fprintf(outfp, "vol   = \"%s\"\n", meta->vol);
 	if (meta->arch != NULL)
-		printf("arch  = \"%s\"\n", meta->arch);
+		fprintf(outfp, "arch  = \"%s\"\n", meta->arch);
 	if (meta->os != NULL)
-		printf("os    = \"%s\"\n", meta->os);
+		fprintf(outfp, "os    = \"%s\"\n", meta->os);
 	if (meta->date != NULL)
-		printf("date  = \"%s\"\n", meta->date);
+		fprintf(outfp, "date  = \"%s\"\n", meta->date);
 }
 
 static void
@@ -179,18 +182,18 @@ print_mdoc(const struct roff_node *n, int indent)
 		print_span(n->span, indent);
 	} else {
 		for (i = 0; i < indent; i++)
-			putchar(' ');
+			putc(' ', outfp);
 
-		printf("%s (%s)", p, t);
+		fprintf(outfp, "%s (%s)", p, t);
 
 		for (i = 0; i < (int)argc; i++) {
-			printf(" -%s", mdoc_argnames[argv[i].arg]);
+			fprintf(outfp, " -%s", mdoc_argnames[argv[i].arg]);
 			if (argv[i].sz > 0)
-				printf(" [");
+				fprintf(outfp, " [");
 			for (j = 0; j < (int)argv[i].sz; j++)
-				printf(" [%s]", argv[i].value[j]);
+				fprintf(outfp, " [%s]", argv[i].value[j]);
 			if (argv[i].sz > 0)
-				printf(" ]");
+				fprintf(outfp, " ]");
 		}
 		print_attr(n);
 	}
@@ -273,8 +276,8 @@ print_man(const struct roff_node *n, int indent)
 		print_span(n->span, indent);
 	} else {
 		for (i = 0; i < indent; i++)
-			putchar(' ');
-		printf("%s (%s)", p, t);
+			putc(' ', outfp);
+		fprintf(outfp, "%s (%s)", p, t);
 		print_attr(n);
 	}
 	if (n->eqn)
@@ -289,35 +292,35 @@ print_man(const struct roff_node *n, int indent)
 static void
 print_attr(const struct roff_node *n)
 {
-	putchar(' ');
+	putc(' ', outfp);
 	if (n->flags & NODE_DELIMO)
-		putchar('(');
+		putc('(', outfp);
 	if (n->flags & NODE_LINE)
-		putchar('*');
-	printf("%d:%d", n->line, n->pos + 1);
+		putc('*', outfp);
+	fprintf(outfp, "%d:%d", n->line, n->pos + 1);
 	if (n->flags & NODE_DELIMC)
-		putchar(')');
+		putc(')', outfp);
 	if (n->flags & NODE_EOS)
-		putchar('.');
+		putc('.', outfp);
 	if (n->flags & NODE_ID) {
-		printf(" ID");
+		fprintf(outfp, " ID");
 		if (n->flags & NODE_HREF)
-			printf("=HREF");
+			fprintf(outfp, "=HREF");
 	} else if (n->flags & NODE_HREF)
-		printf(" HREF");
+		fprintf(outfp, " HREF");
 	else if (n->tag != NULL)
-		printf(" STRAYTAG");
+		fprintf(outfp, " STRAYTAG");
 	if (n->tag != NULL)
-		printf("=%s", n->tag);
+		fprintf(outfp, "=%s", n->tag);
 	if (n->flags & NODE_BROKEN)
-		printf(" BROKEN");
+		fprintf(outfp, " BROKEN");
 	if (n->flags & NODE_NOFILL)
-		printf(" NOFILL");
+		fprintf(outfp, " NOFILL");
 	if (n->flags & NODE_NOSRC)
-		printf(" NOSRC");
+		fprintf(outfp, " NOSRC");
 	if (n->flags & NODE_NOPRT)
-		printf(" NOPRT");
-	putchar('\n');
+		fprintf(outfp, " NOPRT");
+	putc('\n', outfp);
 }
 
 static void
@@ -334,7 +337,7 @@ print_box(const struct eqn_box *ep, int indent)
 	if (NULL == ep)
 		return;
 	for (i = 0; i < indent; i++)
-		putchar(' ');
+		putc(' ', outfp);
 
 	t = NULL;
 	switch (ep->type) {
@@ -355,28 +358,28 @@ print_box(const struct eqn_box *ep, int indent)
 		break;
 	}
 
-	fputs(t, stdout);
+	fputs(t, outfp);
 	if (ep->pos)
-		printf(" pos=%s", posnames[ep->pos]);
+		fprintf(outfp, " pos=%s", posnames[ep->pos]);
 	if (ep->left)
-		printf(" left=\"%s\"", ep->left);
+		fprintf(outfp, " left=\"%s\"", ep->left);
 	if (ep->right)
-		printf(" right=\"%s\"", ep->right);
+		fprintf(outfp, " right=\"%s\"", ep->right);
 	if (ep->top)
-		printf(" top=\"%s\"", ep->top);
+		fprintf(outfp, " top=\"%s\"", ep->top);
 	if (ep->bottom)
-		printf(" bottom=\"%s\"", ep->bottom);
+		fprintf(outfp, " bottom=\"%s\"", ep->bottom);
 	if (ep->text)
-		printf(" text=\"%s\"", ep->text);
+		fprintf(outfp, " text=\"%s\"", ep->text);
 	if (ep->font)
-		printf(" font=%d", ep->font);
+		fprintf(outfp, " font=%d", ep->font);
 	if (ep->size != EQN_DEFSIZE)
-		printf(" size=%d", ep->size);
+		fprintf(outfp, " size=%d", ep->size);
 	if (ep->expectargs != UINT_MAX && ep->expectargs != ep->args)
-		printf(" badargs=%zu(%zu)", ep->args, ep->expectargs);
+		fprintf(outfp, " badargs=%zu(%zu)", ep->args, ep->expectargs);
 	else if (ep->args)
-		printf(" args=%zu", ep->args);
-	putchar('\n');
+		fprintf(outfp, " args=%zu", ep->args);
+	putc('\n', outfp);
 
 	print_box(ep->first, indent + 4);
 	print_box(ep->next, indent);
@@ -387,34 +390,34 @@ print_cellt(enum tbl_cellt pos)
 {
 	switch(pos) {
 	case TBL_CELL_LEFT:
-		putchar('L');
+		putc('L', outfp);
 		break;
 	case TBL_CELL_LONG:
-		putchar('a');
+		putc('a', outfp);
 		break;
 	case TBL_CELL_CENTRE:
-		putchar('c');
+		putc('c', outfp);
 		break;
 	case TBL_CELL_RIGHT:
-		putchar('r');
+		putc('r', outfp);
 		break;
 	case TBL_CELL_NUMBER:
-		putchar('n');
+		putc('n', outfp);
 		break;
 	case TBL_CELL_SPAN:
-		putchar('s');
+		putc('s', outfp);
 		break;
 	case TBL_CELL_DOWN:
-		putchar('^');
+		putc('^', outfp);
 		break;
 	case TBL_CELL_HORIZ:
-		putchar('-');
+		putc('-', outfp);
 		break;
 	case TBL_CELL_DHORIZ:
-		putchar('=');
+		putc('=', outfp);
 		break;
 	case TBL_CELL_MAX:
-		putchar('#');
+		putc('#', outfp);
 		break;
 	}
 }
@@ -428,113 +431,113 @@ print_span(const struct tbl_span *sp, int indent)
 
 	if (sp->prev == NULL) {
 		for (i = 0; i < indent; i++)
-			putchar(' ');
-		printf("%d", sp->opts->cols);
+			putc(' ', outfp);
+		fprintf(outfp, "%d", sp->opts->cols);
 		if (sp->opts->opts & TBL_OPT_CENTRE)
-			fputs(" center", stdout);
+			fputs(" center", outfp);
 		if (sp->opts->opts & TBL_OPT_EXPAND)
-			fputs(" expand", stdout);
+			fputs(" expand", outfp);
 		if (sp->opts->opts & TBL_OPT_ALLBOX)
-			fputs(" allbox", stdout);
+			fputs(" allbox", outfp);
 		if (sp->opts->opts & TBL_OPT_BOX)
-			fputs(" box", stdout);
+			fputs(" box", outfp);
 		if (sp->opts->opts & TBL_OPT_DBOX)
-			fputs(" doublebox", stdout);
+			fputs(" doublebox", outfp);
 		if (sp->opts->opts & TBL_OPT_NOKEEP)
-			fputs(" nokeep", stdout);
+			fputs(" nokeep", outfp);
 		if (sp->opts->opts & TBL_OPT_NOSPACE)
-			fputs(" nospaces", stdout);
+			fputs(" nospaces", outfp);
 		if (sp->opts->opts & TBL_OPT_NOWARN)
-			fputs(" nowarn", stdout);
-		printf(" (tbl options) %d:1\n", sp->line);
+			fputs(" nowarn", outfp);
+		fprintf(outfp, " (tbl options) %d:1\n", sp->line);
 	}
 
 	for (i = 0; i < indent; i++)
-		putchar(' ');
+		putc(' ', outfp);
 
 	switch (sp->pos) {
 	case TBL_SPAN_HORIZ:
-		putchar('-');
-		putchar(' ');
+		putc('-', outfp);
+		putc(' ', outfp);
 		break;
 	case TBL_SPAN_DHORIZ:
-		putchar('=');
-		putchar(' ');
+		putc('=', outfp);
+		putc(' ', outfp);
 		break;
 	default:
 		for (cp = sp->layout->first; cp != NULL; cp = cp->next)
 			print_cellt(cp->pos);
-		putchar(' ');
+		putc(' ', outfp);
 		for (dp = sp->first; dp; dp = dp->next) {
 			if ((cp = dp->layout) == NULL)
-				putchar('*');
+				putc('*', outfp);
 			else {
-				printf("%d", cp->col);
+				fprintf(outfp, "%d", cp->col);
 				print_cellt(dp->layout->pos);
 				switch (cp->font) {
 				case ESCAPE_FONTROMAN:
 					break;
 				case ESCAPE_FONTBOLD:
-					putchar('b');
+					putc('b', outfp);
 					break;
 				case ESCAPE_FONTITALIC:
-					putchar('i');
+					putc('i', outfp);
 					break;
 				case ESCAPE_FONTBI:
-					fputs("bi", stdout);
+					fputs("bi", outfp);
 					break;
 				case ESCAPE_FONTCR:
-					putchar('c');
+					putc('c', outfp);
 					break;
 				case ESCAPE_FONTCB:
-					fputs("cb", stdout);
+					fputs("cb", outfp);
 					break;
 				case ESCAPE_FONTCI:
-					fputs("ci", stdout);
+					fputs("ci", outfp);
 					break;
 				default:
 					abort();
 				}
 				if (cp->flags & TBL_CELL_TALIGN)
-					putchar('t');
+					putc('t', outfp);
 				if (cp->flags & TBL_CELL_UP)
-					putchar('u');
+					putc('u', outfp);
 				if (cp->flags & TBL_CELL_BALIGN)
-					putchar('d');
+					putc('d', outfp);
 				if (cp->flags & TBL_CELL_WIGN)
-					putchar('z');
+					putc('z', outfp);
 				if (cp->flags & TBL_CELL_EQUAL)
-					putchar('e');
+					putc('e', outfp);
 				if (cp->flags & TBL_CELL_WMAX)
-					putchar('x');
+					putc('x', outfp);
 			}
 			switch (dp->pos) {
 			case TBL_DATA_NHORIZ:
-				putchar('\\');
+				putc('\\', outfp);
 				/* FALLTHROUGH */
 			case TBL_DATA_HORIZ:
-				putchar('_');
+				putc('_', outfp);
 				break;
 			case TBL_DATA_NDHORIZ:
-				putchar('\\');
+				putc('\\', outfp);
 				/* FALLTHROUGH */
 			case TBL_DATA_DHORIZ:
-				putchar('=');
+				putc('=', outfp);
 				break;
 			default:
-				putchar(dp->block ? '{' : '[');
+				putc(dp->block ? '{' : '[', outfp);
 				if (dp->string != NULL)
-					fputs(dp->string, stdout);
-				putchar(dp->block ? '}' : ']');
+					fputs(dp->string, outfp);
+				putc(dp->block ? '}' : ']', outfp);
 				break;
 			}
 			if (dp->hspans)
-				printf(">%d", dp->hspans);
+				fprintf(outfp, ">%d", dp->hspans);
 			if (dp->vspans)
-				printf("v%d", dp->vspans);
-			putchar(' ');
+				fprintf(outfp, "v%d", dp->vspans);
+			putc(' ', outfp);
 		}
 		break;
 	}
-	printf("(tbl) %d:1\n", sp->line);
+	fprintf(outfp, "(tbl) %d:1\n", sp->line);
 }